@@ -0,0 +1,316 @@
+// Microbenchmarks of the controller hot paths. Built by env:native_bench (host,
+// nanoseconds) and env:esp32dev_bench (board, CPU cycles). Every benchmark prints
+// one JSON object per line, so runs of two firmware versions can be diffed.
+#include <Arduino.h>
+#include <algorithm>
+#include <string.h>
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/frame.h"
+#include "bluetooth/internal.h"
+#include "log/log.h"
+#include "proximity/filter.h"
+#include "config.h"
+
+// The onWrite cases include the engine and window commands, without their
+// features those would only time the rejection
+static_assert(hasFeature(SUPPORTED_FEATURES, Feature::DoorsLock | Feature::TrunkOpen | Feature::Engine | Feature::Windows),
+              "Build the benchmarks with -D VEHICLE_FEATURES=0x0F");
+
+#ifdef ESP_PLATFORM
+static const char *PLATFORM = "esp32";
+static const char *TIMER_UNIT = "cycles";
+static inline uint32_t timerNow() { return ESP.getCycleCount(); }
+#else
+#include <chrono>
+#include "host.h"
+static const char *PLATFORM = "host";
+static const char *TIMER_UNIT = "ns";
+static inline uint32_t timerNow()
+{
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+#endif
+
+namespace
+{
+    const size_t MAX_SAMPLES = 256;
+    uint32_t samples[MAX_SAMPLES];
+
+    void report(const char *name, size_t iterations)
+    {
+        std::sort(samples, samples + iterations);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+            sum += samples[i];
+
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "{\"bench\":\"%s\",\"platform\":\"%s\",\"protocol\":\"%s\",\"unit\":\"%s\","
+                 "\"n\":%u,\"min\":%u,\"median\":%u,\"mean\":%u,\"max\":%u}",
+                 name, PLATFORM, PROTOCOL_VERSION.c_str(), TIMER_UNIT,
+                 (unsigned)iterations, (unsigned)samples[0], (unsigned)samples[iterations / 2],
+                 (unsigned)(sum / iterations), (unsigned)samples[iterations - 1]);
+#ifdef ESP_PLATFORM
+        Serial.println(line);
+#else
+        puts(line);
+#endif
+    }
+
+    // Drops what the shims recorded, so long runs don't grow host memory
+    void resetSideEffects()
+    {
+#ifndef ESP_PLATFORM
+        host::clearNotifications();
+#endif
+    }
+
+    /// @brief Times fn(i) for every iteration, setup(i) runs untimed before it
+    template <typename Setup, typename Fn>
+    void bench(const char *name, size_t iterations, Setup setup, Fn fn)
+    {
+        iterations = std::min(iterations, MAX_SAMPLES);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            setup(i);
+            uint32_t start = timerNow();
+            fn(i);
+            samples[i] = timerNow() - start;
+        }
+        resetSideEffects();
+        report(name, iterations);
+    }
+
+    template <typename Fn>
+    void bench(const char *name, size_t iterations, Fn fn)
+    {
+        bench(name, iterations, [](size_t) {}, fn);
+    }
+
+    // Same frame layout as the app: HMAC(counter | command (| data if signsPayload()))
+    // + command (+ length + data)
+    size_t buildFrame(uint8_t *frame, uint32_t frameCounter, ClientCommand command, const uint8_t *data, uint8_t dataLength)
+    {
+        uint8_t commandByte = static_cast<uint8_t>(command);
+        if (signsPayload(command))
+            generateHMAC(frameCounter, commandByte, frame, data, dataLength);
+        else
+            generateHMAC(frameCounter, commandByte, frame);
+        frame[32] = commandByte;
+        if (dataLength == 0)
+            return 33;
+        frame[33] = dataLength;
+        memcpy(frame + 34, data, dataLength);
+        return 34 + dataLength;
+    }
+
+    void benchHMAC()
+    {
+        uint8_t hmac[32];
+        const uint8_t command = static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS);
+
+        bench("verifyHMAC/in_sync", 200,
+              [&](size_t) { generateHMAC(counter, command, hmac); },
+              [&](size_t) { verifyHMAC(counter, command, hmac); });
+
+        // What an invalid (or too far ahead) tag costs: every counter of the window fails
+        memset(hmac, 0, sizeof(hmac));
+        bench("verifyHMAC/window_miss", 20, [&](size_t)
+              {
+                  for (uint32_t i = 0; i < COUNTER_WINDOW; i++)
+                      verifyHMAC(counter + i, command, hmac);
+              });
+    }
+
+    void benchOnWrite()
+    {
+        struct Case
+        {
+            ClientCommand command;
+            uint8_t data[8];
+            uint8_t dataLength;
+        };
+        static const Case cases[] = {
+            {ClientCommand::GET_VERSION, {}, 0},
+            {ClientCommand::GET_DATA, {}, 0},
+            {ClientCommand::LOCK_DOORS, {}, 0},
+            {ClientCommand::UNLOCK_DOORS, {}, 0},
+            {ClientCommand::OPEN_TRUNK, {}, 0},
+            {ClientCommand::START_ENGINE, {}, 0},
+            {ClientCommand::STOP_ENGINE, {}, 0},
+            {ClientCommand::PROXIMITY_KEY_ON, {}, 0},
+            {ClientCommand::PROXIMITY_KEY_OFF, {}, 0},
+            {ClientCommand::PROXIMITY_COOLDOWN, {0x00, 0x00, 0x80, 0x3F}, 4},                         // 1.0f
+            {ClientCommand::RSSI_TRIGGER, {0x00, 0x00, 0x70, 0xC2, 0x00, 0x00, 0x80, 0x40}, 8}, // -60.0f, 4.0f
+            {ClientCommand::GET_RSSI, {}, 0},
+            {ClientCommand::GET_FEATURES, {}, 0},
+            {ClientCommand::OPEN_WINDOWS, {}, 0},
+            {ClientCommand::CLOSE_WINDOWS, {}, 0},
+        };
+
+        uint8_t frame[64];
+        char name[48];
+        for (const Case &c : cases)
+        {
+            snprintf(name, sizeof(name), "onWrite/%s", toString(c.command));
+            bench(name, 50,
+                  [&](size_t)
+                  {
+                      size_t length = buildFrame(frame, counter, c.command, c.data, c.dataLength);
+                      pCharacteristic->setValue(frame, length);
+                  },
+                  [&](size_t) { pCommandCallbacks->onWrite(pCharacteristic); });
+        }
+
+        // Full path of a rejected frame (whole counter window checked, INVALID_HMAC sent)
+        bench("onWrite/invalid_hmac", 10,
+              [&](size_t)
+              {
+                  size_t length = buildFrame(frame, counter, ClientCommand::UNLOCK_DOORS, nullptr, 0);
+                  frame[0] ^= 0xFF;
+                  pCharacteristic->setValue(frame, length);
+              },
+              [&](size_t) { pCommandCallbacks->onWrite(pCharacteristic); });
+    }
+
+    // Frame layout checks alone, without the HMAC (malformed ones should cost
+    // the same as a valid one)
+    void benchFrame()
+    {
+        uint8_t buffer[64];
+        const uint8_t data[] = {0x00, 0x00, 0x70, 0xC2, 0x00, 0x00, 0x80, 0x40}; // -60.0f, 4.0f
+        size_t length = buildFrame(buffer, counter, ClientCommand::RSSI_TRIGGER, data, sizeof(data));
+        frame::FrameView view;
+        volatile float sink = 0;
+
+        bench("frame/parse_valid", 200, [&](size_t)
+              {
+                  if (frame::FrameView::parse(buffer, length, view) == frame::FrameError::None)
+                      sink = view.payload().f32(0) + view.payload().f32(4);
+              });
+        bench("frame/parse_too_short", 200, [&](size_t) { sink = static_cast<float>(frame::FrameView::parse(buffer, 20, view)); });
+        bench("frame/parse_length_mismatch", 200, [&](size_t) { sink = static_cast<float>(frame::FrameView::parse(buffer, 38, view)); });
+        (void)sink;
+    }
+
+    void benchSendToClient()
+    {
+        bench("sendToClient/no_data", 200, [](size_t) { sendToClient(Esp32Response::LOCKED); });
+        bench("sendToClient/float", 200, [](size_t) { sendToClientFloat(Esp32Response::RSSI, -60.5f); });
+    }
+
+    void benchGapCallback()
+    {
+        esp_ble_gap_cb_param_t param = {};
+        param.read_rssi_cmpl.status = ESP_BT_STATUS_SUCCESS;
+
+        // Filter only (proximity key off)
+        autoLocking = false;
+        bench("gapCallback/smoothing", 200,
+              [&](size_t i) { param.read_rssi_cmpl.rssi = -60 - (i % 7); },
+              [&](size_t) { gapCallback(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, &param); });
+
+        // Threshold logic while the phone stays between release and trigger
+        autoLocking = true;
+        triggerRssiStrength = -60;
+        releaseRssiStrength = -83;
+        proximityCooldown = 0;
+        proximityZones.configure({-60, -83, 0, 0, 0}); // No dwell time, so every crossing acts
+        proximityZones.reset(false);
+        bench("gapCallback/threshold_hold", 200,
+              [&](size_t i) { param.read_rssi_cmpl.rssi = -70 - (i % 3); },
+              [&](size_t) { gapCallback(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, &param); });
+
+        // Phone walking in and out, includes the proximity lock/unlock actions
+        bench("gapCallback/threshold_cross", 200,
+              [&](size_t i) { param.read_rssi_cmpl.rssi = (i / 10) % 2 ? -100 : -40; },
+              [&](size_t) { gapCallback(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, &param); });
+
+        autoLocking = false;
+        triggerRssiStrength = 0;
+        releaseRssiStrength = 0;
+        proximityCooldown = 1;
+    }
+
+    void benchRssiFilters()
+    {
+        const proximity::FilterConfig configs[] = {
+            {proximity::FilterType::MovingAverage, proximity::MAX_FILTER_WINDOW, 0},
+            {proximity::FilterType::Exponential, 0.3f, 0},
+            {proximity::FilterType::Median, proximity::MAX_FILTER_WINDOW, 0},
+            {proximity::FilterType::Kalman, 0.5f, 16},
+        };
+        const char *names[] = {"rssiFilter/sma_16", "rssiFilter/ema", "rssiFilter/median_16", "rssiFilter/kalman"};
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            proximity::configureFilter(configs[i]);
+            bench(names[i], 200, [](size_t n) { proximity::activeFilter().update(-60.0f - (n * 7 % 13)); });
+        }
+        proximity::configureFilter({proximity::FilterType::MovingAverage, 5, 0});
+    }
+
+    void benchCounter()
+    {
+        bench("writeCounter", 50, [](size_t) { writeCounter(counter); });
+        bench("readCounter", 50, [](size_t) { readCounter(); });
+    }
+
+    void benchScrambleName()
+    {
+        bench("scrambleName", 200, [](size_t) { scrambleName(DEVICE_NAME); });
+    }
+
+    void benchLog()
+    {
+        // Called directly so the numbers don't depend on LOG_LEVEL
+        bench("log/no_args", 200, [](size_t) { logging::log(logging::LogId::CONNECTED, LOG_LEVEL_INFO); });
+        bench("log/command", 200, [](size_t i)
+              { logging::log(logging::LogId::COMMAND_RECEIVED, LOG_LEVEL_DEBUG, ClientCommand::LOCK_DOORS, 0x02, i); });
+    }
+}
+
+void runBenchmarks()
+{
+    // The onWrite benchmarks advance the rolling code counter, put the stored
+    // one back afterwards so the paired phone is not locked out by them.
+    uint32_t savedCounter = counter;
+
+    benchHMAC();
+    benchFrame();
+    benchOnWrite();
+    benchSendToClient();
+    benchGapCallback();
+    benchRssiFilters();
+    benchCounter();
+    benchScrambleName();
+    benchLog();
+
+    counter = savedCounter;
+    writeCounter(counter);
+}
+
+#ifdef ESP_PLATFORM
+void setup()
+{
+    Serial.begin(115200);
+    setupBluetooth();
+    delay(1000);
+    runBenchmarks();
+}
+
+void loop()
+{
+    delay(1000);
+}
+#else
+int main()
+{
+    host::setSerialOutput(nullptr);
+    setupBluetooth();
+    runBenchmarks();
+    return 0;
+}
+#endif
@@ -0,0 +1,156 @@
+// Host runner for the controller core (env:native). Reads one action per line
+// from stdin, drives the shimmed BLE stack and prints every notification the
+// controller sends as "<time> <uuid> <hex>" on stdout (Serial goes to stderr).
+//
+//   connect | disconnect
+//   send <counter> <command hex> [payload hex]   authenticated frame like the app
+//   request <id> <counter> <command hex> [payload hex]
+//                                                same with a request ID (0-255)
+//   raw <frame hex>                              unauthenticated raw write
+//   read <uuid>                                  read a characteristic, printed as
+//                                                "<time> <uuid> read <hex>"
+//   subscribe <uuid> <0|1>                       turn its notifications on or off
+//   rssi <dBm>                                   deliver an RSSI reading
+//   report <locked|engine|windows> <0|1>         a state change made past the
+//                                                controller (reportLocked() etc.)
+//   tick <ms>                                    advance the clock, run bluetoothLoop()
+//
+// Left out of `pio test -e native`, the tests in test/ have their own main().
+#ifndef PIO_UNIT_TESTING
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "host.h"
+#include "bluetooth/bluetooth.h"
+
+namespace
+{
+    std::vector<uint8_t> parseHex(const std::string &hex)
+    {
+        std::vector<uint8_t> bytes;
+        for (size_t i = 0; i + 1 < hex.length(); i += 2)
+            bytes.push_back(static_cast<uint8_t>(strtoul(hex.substr(i, 2).c_str(), nullptr, 16)));
+        return bytes;
+    }
+
+    void printHex(const std::vector<uint8_t> &bytes)
+    {
+        for (uint8_t byte : bytes)
+            printf("%02x", byte);
+        printf("\n");
+    }
+
+    void printNotifications()
+    {
+        for (const host::Notification &notification : host::notifications())
+        {
+            printf("%lu %s ", notification.atMillis, notification.characteristicUuid.c_str());
+            printHex(notification.value);
+        }
+        host::clearNotifications();
+        fflush(stdout);
+    }
+}
+
+int main()
+{
+    setupBluetooth();
+
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream in(line);
+        std::string action;
+        in >> action;
+
+        if (action == "connect")
+        {
+            host::connect();
+        }
+        else if (action == "disconnect")
+        {
+            host::disconnect();
+        }
+        else if (action == "send")
+        {
+            uint32_t counter = 0;
+            std::string command, payload;
+            in >> counter >> command >> payload;
+            std::vector<uint8_t> data = parseHex(payload);
+            host::write(host::buildFrame(counter, static_cast<uint8_t>(strtoul(command.c_str(), nullptr, 16)),
+                                         data.data(), static_cast<uint8_t>(data.size())));
+        }
+        else if (action == "request")
+        {
+            int requestId = 0;
+            uint32_t counter = 0;
+            std::string command, payload;
+            in >> requestId >> counter >> command >> payload;
+            std::vector<uint8_t> data = parseHex(payload);
+            host::write(host::buildFrame(counter, static_cast<uint8_t>(strtoul(command.c_str(), nullptr, 16)),
+                                         data.data(), static_cast<uint8_t>(data.size()), requestId));
+        }
+        else if (action == "raw")
+        {
+            std::string frame;
+            in >> frame;
+            host::write(parseHex(frame));
+        }
+        else if (action == "read")
+        {
+            std::string uuid;
+            in >> uuid;
+            std::vector<uint8_t> value = host::read(uuid.c_str());
+            printNotifications(); // Whatever was notified before the read
+            printf("%lu %s read ", millis(), uuid.c_str());
+            printHex(value);
+        }
+        else if (action == "subscribe")
+        {
+            std::string uuid;
+            int enabled = 0;
+            in >> uuid >> enabled;
+            if (!host::subscribe(uuid.c_str(), enabled != 0))
+                fprintf(stderr, "No BLE2902 on %s\n", uuid.c_str());
+        }
+        else if (action == "report")
+        {
+            std::string what;
+            int value = 0;
+            in >> what >> value;
+            if (what == "locked")
+                reportLocked(value != 0);
+            else if (what == "engine")
+                reportEngine(value != 0);
+            else if (what == "windows")
+                reportWindows(value != 0);
+            else
+                fprintf(stderr, "Unknown state: %s\n", what.c_str());
+        }
+        else if (action == "rssi")
+        {
+            int rssi = 0;
+            in >> rssi;
+            host::deliverRssi(static_cast<int8_t>(rssi));
+        }
+        else if (action == "tick")
+        {
+            unsigned long ms = 0;
+            in >> ms;
+            host::advanceMillis(ms);
+            bluetoothLoop();
+        }
+        else if (!action.empty() && action[0] != '#')
+        {
+            fprintf(stderr, "Unknown action: %s\n", action.c_str());
+        }
+
+        printNotifications();
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,111 @@
+// Host (Linux) stand-in for the parts of the Arduino core the controller uses.
+// Only built by the native environments in platformio.ini, never for the ESP32.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+/// @brief Minimal Arduino String, enough for the debug output of the firmware
+class String
+{
+public:
+    String() = default;
+    String(const char *str) : value(str ? str : "") {}
+    String(const std::string &str) : value(str) {}
+    String(char c) : value(1, c) {}
+    String(unsigned char value, unsigned char base = 10);
+    String(int value, unsigned char base = 10);
+    String(unsigned int value, unsigned char base = 10);
+    String(long value, unsigned char base = 10);
+    String(unsigned long value, unsigned char base = 10);
+    String(float value, unsigned int decimalPlaces = 2);
+    String(double value, unsigned int decimalPlaces = 2);
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+    void trim();
+
+    String &operator+=(const String &rhs)
+    {
+        value += rhs.value;
+        return *this;
+    }
+
+    bool operator==(const String &rhs) const { return value == rhs.value; }
+    bool operator==(const char *rhs) const { return value == rhs; }
+    bool operator!=(const String &rhs) const { return value != rhs.value; }
+    bool operator!=(const char *rhs) const { return value != rhs; }
+
+private:
+    std::string value;
+};
+
+String operator+(const String &lhs, const String &rhs);
+
+/// @brief Serial port on the host: output goes to stderr (or nowhere), input
+/// comes from lines queued with host::serialInput()
+class HardwareSerial
+{
+public:
+    void begin(unsigned long /* baud */) {}
+    int available();
+    String readStringUntil(char terminator);
+
+    size_t print(const String &str);
+    size_t print(const char *str);
+    size_t print(char c);
+    size_t print(int value, int base = 10);
+    size_t print(unsigned int value, int base = 10);
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(double value, int digits = 2);
+
+    size_t write(const uint8_t *buffer, size_t size);
+    int availableForWrite() { return 4096; }
+
+    size_t println();
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+/// @brief Heap figures of the host "chip", set with host::setHeap()
+class EspClass
+{
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+/// @brief Fixed on the host, so runs are reproducible
+uint32_t esp_random();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
@@ -0,0 +1,14 @@
+// Host stand-in for the Client Characteristic Configuration descriptor
+#pragma once
+
+#include "BLEServer.h"
+
+class BLE2902 : public BLEDescriptor
+{
+public:
+    bool getNotifications() { return notifications; }
+    void setNotifications(bool flag) { notifications = flag; }
+
+private:
+    bool notifications = false;
+};
@@ -0,0 +1,77 @@
+// Host stand-in for BLEDevice / BLEAdvertising / BLEScan
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "BLEServer.h"
+
+class BLEAdvertising
+{
+public:
+    void addServiceUUID(const char * /* uuid */) {}
+    void setScanResponse(bool /* scanResponse */) {}
+    void setMinPreferred(uint16_t /* interval */) {}
+    void setMaxPreferred(uint16_t /* interval */) {}
+    void start();
+    void stop() {}
+};
+
+class BLEScanResults
+{
+};
+
+class BLEAdvertisedDevice
+{
+public:
+    BLEAdvertisedDevice(const std::string &manufacturerData, int rssi) : manufacturerData(manufacturerData), rssi(rssi) {}
+
+    bool haveManufacturerData() { return !manufacturerData.empty(); }
+    std::string getManufacturerData() { return manufacturerData; }
+    int getRSSI() { return rssi; }
+
+private:
+    std::string manufacturerData;
+    int rssi;
+};
+
+class BLEAdvertisedDeviceCallbacks
+{
+public:
+    virtual ~BLEAdvertisedDeviceCallbacks() = default;
+    virtual void onResult(BLEAdvertisedDevice advertisedDevice) = 0;
+};
+
+/// @brief Scan whose listening windows follow the virtual clock (see host::advertise())
+class BLEScan
+{
+public:
+    void setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks *pAdvertisedDeviceCallbacks, bool /* wantDuplicates */ = false)
+    {
+        callbacks = pAdvertisedDeviceCallbacks;
+    }
+    void setActiveScan(bool /* active */) {}
+    void setInterval(uint16_t intervalMSecs) { interval = intervalMSecs; }
+    void setWindow(uint16_t windowMSecs) { window = windowMSecs; }
+    bool start(uint32_t duration, void (*scanCompleteCB)(BLEScanResults), bool is_continue = false);
+    void stop();
+    void clearResults() {}
+
+    BLEAdvertisedDeviceCallbacks *callbacks = nullptr;
+    void (*completeCallback)(BLEScanResults) = nullptr;
+    uint16_t interval = 100;
+    uint16_t window = 100;
+    uint32_t durationMillis = 0;
+    unsigned long startMillis = 0;
+    bool running = false;
+};
+
+class BLEDevice
+{
+public:
+    static void init(const std::string &deviceName);
+    static BLEServer *createServer();
+    static BLEAdvertising *getAdvertising();
+    static BLEScan *getScan();
+    static void startAdvertising();
+    static void setMTU(uint16_t mtu);
+};
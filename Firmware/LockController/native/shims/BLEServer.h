@@ -0,0 +1,106 @@
+// Host stand-in for the ESP32 BLE server classes. Values written and notified
+// are kept in memory so the host harness (host.h) can drive and inspect them.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "esp_gap_ble_api.h"
+
+class BLEServer;
+class BLEService;
+class BLECharacteristic;
+
+class BLEDescriptor
+{
+public:
+    virtual ~BLEDescriptor() = default;
+};
+
+class BLECharacteristicCallbacks
+{
+public:
+    virtual ~BLECharacteristicCallbacks() = default;
+    virtual void onRead(BLECharacteristic * /* pCharacteristic */) {}
+    virtual void onWrite(BLECharacteristic * /* pCharacteristic */) {}
+    virtual void onNotify(BLECharacteristic * /* pCharacteristic */) {}
+};
+
+class BLECharacteristic
+{
+public:
+    static const uint32_t PROPERTY_READ = 1 << 0;
+    static const uint32_t PROPERTY_WRITE = 1 << 1;
+    static const uint32_t PROPERTY_NOTIFY = 1 << 2;
+    static const uint32_t PROPERTY_BROADCAST = 1 << 3;
+    static const uint32_t PROPERTY_INDICATE = 1 << 4;
+    static const uint32_t PROPERTY_WRITE_NR = 1 << 5;
+
+    BLECharacteristic(const char *uuid, uint32_t properties) : uuid(uuid), properties(properties) {}
+
+    void setCallbacks(BLECharacteristicCallbacks *pCallbacks) { callbacks = pCallbacks; }
+    BLECharacteristicCallbacks *getCallbacks() { return callbacks; }
+    void addDescriptor(BLEDescriptor *pDescriptor) { descriptors.push_back(pDescriptor); }
+
+    void setValue(const uint8_t *data, size_t size) { value.assign(reinterpret_cast<const char *>(data), size); }
+    void setValue(const std::string &newValue) { value = newValue; }
+    std::string getValue() { return value; }
+    uint8_t *getData() { return reinterpret_cast<uint8_t *>(&value[0]); }
+    size_t getLength() { return value.length(); }
+
+    /// @brief Records the current value as a notification (see host::notifications())
+    /// unless the client turned notifications off in its BLE2902, like the ESP32 stack
+    void notify(bool is_notification = true);
+
+    const std::string &getUUIDString() const { return uuid; }
+    uint32_t getProperties() const { return properties; }
+    const std::vector<BLEDescriptor *> &getDescriptors() const { return descriptors; }
+
+private:
+    std::string uuid;
+    uint32_t properties;
+    std::string value;
+    BLECharacteristicCallbacks *callbacks = nullptr;
+    std::vector<BLEDescriptor *> descriptors;
+};
+
+class BLEService
+{
+public:
+    explicit BLEService(const char *uuid) : uuid(uuid) {}
+
+    BLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties);
+    void start() {}
+
+    const std::vector<BLECharacteristic *> &getCharacteristics() const { return characteristics; }
+
+private:
+    std::string uuid;
+    std::vector<BLECharacteristic *> characteristics;
+};
+
+class BLEServerCallbacks
+{
+public:
+    virtual ~BLEServerCallbacks() = default;
+    virtual void onConnect(BLEServer * /* pServer */) {}
+    virtual void onConnect(BLEServer * /* pServer */, esp_ble_gatts_cb_param_t * /* param */) {}
+    virtual void onDisconnect(BLEServer * /* pServer */) {}
+};
+
+class BLEServer
+{
+public:
+    BLEService *createService(const char *uuid);
+    void setCallbacks(BLEServerCallbacks *pCallbacks) { callbacks = pCallbacks; }
+    BLEServerCallbacks *getCallbacks() { return callbacks; }
+    void startAdvertising();
+    void updateConnParams(esp_bd_addr_t remote_bda, uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout);
+
+    const std::vector<BLEService *> &getServices() const { return services; }
+
+private:
+    BLEServerCallbacks *callbacks = nullptr;
+    std::vector<BLEService *> services;
+};
@@ -0,0 +1,4 @@
+// Host stand-in for BLEUtils.h (nothing of it is used by the controller)
+#pragma once
+
+#include "BLEDevice.h"
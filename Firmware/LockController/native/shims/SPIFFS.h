@@ -0,0 +1,41 @@
+// Host stand-in for SPIFFS. Files live in memory for the lifetime of the
+// process (see host::resetFlash() / host::flashWrites()).
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+class File
+{
+public:
+    File() = default;
+    File(const std::string &path, bool write);
+
+    explicit operator bool() const { return open; }
+
+    size_t print(unsigned long value);
+    size_t write(const uint8_t *buf, size_t size);
+    size_t read(uint8_t *buf, size_t size);
+    long parseInt();
+    size_t size() const;
+    void close();
+
+private:
+    std::string path;
+    std::string buffer;
+    size_t position = 0;
+    bool writing = false;
+    bool open = false;
+};
+
+class SPIFFSFS
+{
+public:
+    bool begin(bool formatOnFail = false);
+    File open(const char *path, const char *mode = "r");
+    bool exists(const char *path);
+    bool remove(const char *path);
+};
+
+extern SPIFFSFS SPIFFS;
@@ -0,0 +1,45 @@
+// Host stand-in for the ESP-IDF GAP API (only what the controller uses)
+#pragma once
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef uint8_t esp_bd_addr_t[6];
+
+typedef enum
+{
+    ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT = 20,
+} esp_gap_ble_cb_event_t;
+
+typedef enum
+{
+    ESP_BT_STATUS_SUCCESS = 0,
+    ESP_BT_STATUS_FAIL,
+} esp_bt_status_t;
+
+typedef union
+{
+    struct ble_read_rssi_cmpl_evt_param
+    {
+        esp_bt_status_t status;
+        int8_t rssi;
+        esp_bd_addr_t remote_addr;
+    } read_rssi_cmpl;
+} esp_ble_gap_cb_param_t;
+
+typedef union
+{
+    struct gatts_connect_evt_param
+    {
+        uint16_t conn_id;
+        esp_bd_addr_t remote_bda;
+    } connect;
+} esp_ble_gatts_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr);
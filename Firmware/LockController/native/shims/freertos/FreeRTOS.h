@@ -0,0 +1,19 @@
+// Host stand-in for FreeRTOS (only what the controller uses)
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t UBaseType_t;
+typedef void *TaskHandle_t;
+
+// Critical sections: the host runs everything on one thread
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFF
@@ -0,0 +1,11 @@
+// Host stand-in for the FreeRTOS task API. Task handles are the task names,
+// high-water marks come from host::setStackHighWaterMark().
+#pragma once
+
+#include "FreeRTOS.h"
+
+TaskHandle_t xTaskGetHandle(const char *name);
+/// @brief Everything runs on one thread on the host
+TaskHandle_t xTaskGetCurrentTaskHandle();
+/// @brief nullptr is the calling task ("loopTask")
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
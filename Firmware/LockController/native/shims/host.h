@@ -0,0 +1,92 @@
+// Host harness for the native build: drives the shimmed BLE stack, clock,
+// flash and pins so onWrite() and gapCallback() can be exercised without a board.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace host
+{
+    /// @brief A notification sent by the controller
+    struct Notification
+    {
+        std::string characteristicUuid;
+        std::vector<uint8_t> value;
+        unsigned long atMillis;
+    };
+
+    /// @brief Sets the virtual clock returned by millis()
+    void setMillis(unsigned long ms);
+    /// @brief Advances the virtual clock (delay() does the same)
+    void advanceMillis(unsigned long ms);
+
+    /// @brief Where Serial output goes, nullptr to discard it (default: stderr)
+    void setSerialOutput(FILE *output);
+    /// @brief Queues a line that Serial.readStringUntil() will return
+    void serialInput(const std::string &line);
+
+    /// @brief Sets the level digitalRead() returns for a pin (default: HIGH)
+    void setPin(uint8_t pin, int level);
+    /// @brief Last level written to a pin with digitalWrite()
+    int pinLevel(uint8_t pin);
+    /// @brief Number of digitalWrite() calls for a pin
+    uint32_t pinWrites(uint8_t pin);
+
+    /// @brief Sets what ESP.getFreeHeap() / getMinFreeHeap() / getMaxAllocHeap() return
+    void setHeap(uint32_t freeHeap, uint32_t minFreeHeap, uint32_t largestFreeBlock);
+    /// @brief Sets what uxTaskGetStackHighWaterMark() returns for a task
+    /// ("loopTask" for the calling task), unknown tasks have no handle
+    void setStackHighWaterMark(const char *taskName, uint32_t bytes);
+
+    /// @brief Simulates a phone connecting to the server
+    void connect(const uint8_t address[6] = nullptr);
+    /// @brief Simulates the phone disconnecting
+    void disconnect();
+
+    /// @brief Writes a value to a characteristic and runs its onWrite callback.
+    /// Without a UUID the first writable characteristic is used.
+    void write(const uint8_t *data, size_t length, const char *characteristicUuid = nullptr);
+    void write(const std::vector<uint8_t> &data, const char *characteristicUuid = nullptr);
+
+    /// @brief Reads a characteristic (runs its onRead callback first)
+    std::vector<uint8_t> read(const char *characteristicUuid);
+    /// @brief Turns notifications of a characteristic on or off in its BLE2902,
+    /// false if it has none. Without a UUID the first writable characteristic
+    /// is used, connect() turns its notifications on.
+    bool subscribe(const char *characteristicUuid, bool enabled);
+
+    /// @brief Builds an authenticated client frame the same way the app does:
+    /// HMAC-SHA256(counter | command (| data if signsPayload())) + command (+ length + data
+    /// (+ request ID if it isn't negative))
+    std::vector<uint8_t> buildFrame(uint32_t counter, uint8_t command,
+                                    const uint8_t *data = nullptr, uint8_t dataLength = 0, int requestId = -1);
+
+    /// @brief True if esp_ble_gap_read_rssi() was called since the last deliverRssi()
+    bool rssiRequested();
+    /// @brief Number of esp_ble_gap_read_rssi() calls
+    uint32_t rssiRequests();
+    /// @brief Delivers an RSSI reading to the registered GAP callback
+    void deliverRssi(int8_t rssi);
+
+    const std::vector<Notification> &notifications();
+    void clearNotifications();
+
+    /// @brief Erases all files of the in-memory SPIFFS
+    void resetFlash();
+    /// @brief Number of files opened for writing on SPIFFS
+    uint32_t flashWrites();
+
+    /// @brief Number of times advertising was (re)started
+    uint32_t advertisingStarts();
+
+    /// @brief True while a scan runs and is in its listening window
+    bool scanListening();
+    /// @brief Number of scans started
+    uint32_t scanStarts();
+    /// @brief A phone advertising manufacturer data: delivered to the scan
+    /// callbacks if the scan is listening right now (returns whether it was)
+    bool advertise(const std::vector<uint8_t> &manufacturerData, int8_t rssi);
+}
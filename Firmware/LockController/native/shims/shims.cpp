@@ -0,0 +1,576 @@
+// Implementation of the host shims and the host harness (host.h)
+#include <stdarg.h>
+#include <deque>
+#include <map>
+#include <Arduino.h>
+#include <BLE2902.h>
+#include <BLEDevice.h>
+#include <SPIFFS.h>
+#include <esp_gap_ble_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <mbedtls/md.h>
+#include <mbedtls/sha256.h>
+#include <config.h>
+#include "bluetooth/commands.h"
+#include "host.h"
+
+namespace
+{
+    unsigned long nowMillis = 0;
+    FILE *serialOutput = stderr;
+    std::deque<std::string> serialLines;
+
+    std::map<uint8_t, int> pinLevels;
+    std::map<uint8_t, int> pinInputs;
+    std::map<uint8_t, uint32_t> pinWriteCounts;
+
+    uint32_t heapFree = 200000;
+    uint32_t heapMinFree = 180000;
+    uint32_t heapLargestBlock = 110000;
+    std::map<std::string, uint32_t> stackHighWaterMarks = {
+        {"loopTask", 5000}, {"BTC_TASK", 2000}, {"BTU_TASK", 2500}};
+
+    BLEServer *server = nullptr;
+    BLEAdvertising advertising;
+    uint32_t advertisingStartCount = 0;
+    BLEScan scan;
+    uint32_t scanStartCount = 0;
+
+    esp_gap_ble_cb_t gapCallback = nullptr;
+    esp_bd_addr_t connectedAddress = {0};
+    bool rssiPending = false;
+    uint32_t rssiRequestCount = 0;
+
+    std::vector<host::Notification> sentNotifications;
+
+    std::map<std::string, std::string> files;
+    uint32_t fileWriteCount = 0;
+
+    std::string toString(long value, unsigned char base)
+    {
+        char buf[34];
+        if (base == 16)
+            snprintf(buf, sizeof(buf), "%lx", value);
+        else
+            snprintf(buf, sizeof(buf), "%ld", value);
+        return buf;
+    }
+
+    std::string toString(unsigned long value, unsigned char base)
+    {
+        char buf[34];
+        if (base == 16)
+            snprintf(buf, sizeof(buf), "%lx", value);
+        else
+            snprintf(buf, sizeof(buf), "%lu", value);
+        return buf;
+    }
+
+    std::string toString(double value, unsigned int decimalPlaces)
+    {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+        return buf;
+    }
+
+    size_t writeSerial(const char *str, size_t length)
+    {
+        if (serialOutput)
+            fwrite(str, 1, length, serialOutput);
+        return length;
+    }
+
+    BLECharacteristic *findCharacteristic(const char *uuid)
+    {
+        if (server == nullptr)
+            return nullptr;
+
+        for (BLEService *service : server->getServices())
+        {
+            for (BLECharacteristic *characteristic : service->getCharacteristics())
+            {
+                if (uuid == nullptr)
+                {
+                    if (characteristic->getProperties() &
+                        (BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR))
+                        return characteristic;
+                }
+                else if (characteristic->getUUIDString() == uuid)
+                {
+                    return characteristic;
+                }
+            }
+        }
+        return nullptr;
+    }
+}
+
+// Arduino core
+
+String::String(unsigned char value, unsigned char base) : value(toString((unsigned long)value, base)) {}
+String::String(int value, unsigned char base) : value(toString((long)value, base)) {}
+String::String(unsigned int value, unsigned char base) : value(toString((unsigned long)value, base)) {}
+String::String(long value, unsigned char base) : value(toString(value, base)) {}
+String::String(unsigned long value, unsigned char base) : value(toString(value, base)) {}
+String::String(float value, unsigned int decimalPlaces) : value(toString((double)value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : value(toString(value, decimalPlaces)) {}
+
+void String::trim()
+{
+    size_t start = value.find_first_not_of(" \t\r\n");
+    size_t end = value.find_last_not_of(" \t\r\n");
+    value = start == std::string::npos ? "" : value.substr(start, end - start + 1);
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+HardwareSerial Serial;
+
+int HardwareSerial::available()
+{
+    return serialLines.empty() ? 0 : serialLines.front().length() + 1;
+}
+
+String HardwareSerial::readStringUntil(char /* terminator */)
+{
+    if (serialLines.empty())
+        return String();
+    std::string line = serialLines.front();
+    serialLines.pop_front();
+    return String(line);
+}
+
+size_t HardwareSerial::print(const String &str) { return writeSerial(str.c_str(), str.length()); }
+size_t HardwareSerial::print(const char *str) { return writeSerial(str, strlen(str)); }
+size_t HardwareSerial::print(char c) { return writeSerial(&c, 1); }
+size_t HardwareSerial::print(int value, int base) { return print(String(value, base)); }
+size_t HardwareSerial::print(unsigned int value, int base) { return print(String(value, base)); }
+size_t HardwareSerial::print(long value, int base) { return print(String(value, base)); }
+size_t HardwareSerial::print(unsigned long value, int base) { return print(String(value, base)); }
+size_t HardwareSerial::print(double value, int digits) { return print(String(value, digits)); }
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) { return writeSerial(reinterpret_cast<const char *>(buffer), size); }
+size_t HardwareSerial::println() { return writeSerial("\r\n", 2); }
+
+size_t HardwareSerial::printf(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (length < 0)
+        return 0;
+    return writeSerial(buf, length < (int)sizeof(buf) ? length : sizeof(buf) - 1);
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getHeapSize() { return 320000; }
+uint32_t EspClass::getFreeHeap() { return heapFree; }
+uint32_t EspClass::getMinFreeHeap() { return heapMinFree; }
+uint32_t EspClass::getMaxAllocHeap() { return heapLargestBlock; }
+
+unsigned long millis() { return nowMillis; }
+unsigned long micros() { return nowMillis * 1000; }
+void delay(unsigned long ms) { nowMillis += ms; }
+
+uint32_t esp_random() { return 0x2A5E0000; }
+
+void pinMode(uint8_t /* pin */, uint8_t /* mode */) {}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    pinLevels[pin] = val;
+    pinWriteCounts[pin]++;
+}
+
+int digitalRead(uint8_t pin)
+{
+    auto it = pinInputs.find(pin);
+    return it == pinInputs.end() ? HIGH : it->second;
+}
+
+// FreeRTOS
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    auto it = stackHighWaterMarks.find(name);
+    return it == stackHighWaterMarks.end() ? nullptr : const_cast<std::string *>(&it->first);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return xTaskGetHandle("loopTask");
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    const std::string *name = task ? static_cast<const std::string *>(task) : nullptr;
+    auto it = stackHighWaterMarks.find(name ? *name : "loopTask");
+    return it == stackHighWaterMarks.end() ? 0 : it->second;
+}
+
+// A mutex is a flag: taking it twice would wait forever on the board, here it aborts
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new bool(false);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t /* ticksToWait */)
+{
+    bool &taken = *static_cast<bool *>(semaphore);
+    if (taken)
+    {
+        fprintf(stderr, "xSemaphoreTake: mutex already taken (deadlock on the board)\n");
+        abort();
+    }
+    taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    *static_cast<bool *>(semaphore) = false;
+    return pdTRUE;
+}
+
+// BLE
+
+void BLECharacteristic::notify(bool /* is_notification */)
+{
+    for (BLEDescriptor *descriptor : descriptors)
+    {
+        BLE2902 *cccd = dynamic_cast<BLE2902 *>(descriptor);
+        if (cccd != nullptr && !cccd->getNotifications())
+            return;
+    }
+    sentNotifications.push_back({uuid, std::vector<uint8_t>(value.begin(), value.end()), nowMillis});
+}
+
+BLECharacteristic *BLEService::createCharacteristic(const char *uuid, uint32_t properties)
+{
+    characteristics.push_back(new BLECharacteristic(uuid, properties));
+    return characteristics.back();
+}
+
+BLEService *BLEServer::createService(const char *uuid)
+{
+    services.push_back(new BLEService(uuid));
+    return services.back();
+}
+
+void BLEServer::startAdvertising() { advertising.start(); }
+
+void BLEServer::updateConnParams(esp_bd_addr_t /* remote_bda */, uint16_t /* minInterval */, uint16_t /* maxInterval */, uint16_t /* latency */, uint16_t /* timeout */) {}
+
+void BLEAdvertising::start() { advertisingStartCount++; }
+
+bool BLEScan::start(uint32_t duration, void (*scanCompleteCB)(BLEScanResults), bool /* is_continue */)
+{
+    completeCallback = scanCompleteCB;
+    durationMillis = duration * 1000;
+    startMillis = nowMillis;
+    running = true;
+    scanStartCount++;
+    return true;
+}
+
+void BLEScan::stop() { running = false; }
+
+void BLEDevice::init(const std::string & /* deviceName */) {}
+
+BLEServer *BLEDevice::createServer()
+{
+    server = new BLEServer();
+    return server;
+}
+
+BLEAdvertising *BLEDevice::getAdvertising() { return &advertising; }
+BLEScan *BLEDevice::getScan() { return &scan; }
+void BLEDevice::startAdvertising() { advertising.start(); }
+void BLEDevice::setMTU(uint16_t /* mtu */) {}
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback)
+{
+    gapCallback = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t /* remote_addr */)
+{
+    rssiPending = true;
+    rssiRequestCount++;
+    return ESP_OK;
+}
+
+// SPIFFS
+
+SPIFFSFS SPIFFS;
+
+File::File(const std::string &path, bool write) : path(path), writing(write), open(true)
+{
+    if (!write)
+    {
+        auto it = files.find(path);
+        if (it == files.end())
+            open = false;
+        else
+            buffer = it->second;
+    }
+}
+
+size_t File::print(unsigned long value)
+{
+    std::string str = toString(value, 10);
+    return write(reinterpret_cast<const uint8_t *>(str.data()), str.length());
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+    if (!open || !writing)
+        return 0;
+    buffer.append(reinterpret_cast<const char *>(buf), size);
+    return size;
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+    if (!open || writing)
+        return 0;
+    size_t n = buffer.length() - position < size ? buffer.length() - position : size;
+    memcpy(buf, buffer.data() + position, n);
+    position += n;
+    return n;
+}
+
+long File::parseInt()
+{
+    if (!open || writing)
+        return 0;
+    while (position < buffer.length() && !isdigit((unsigned char)buffer[position]) && buffer[position] != '-')
+        position++;
+    char *end = nullptr;
+    long value = strtol(buffer.c_str() + position, &end, 10);
+    position = end - buffer.c_str();
+    return value;
+}
+
+size_t File::size() const { return buffer.length(); }
+
+void File::close()
+{
+    if (open && writing)
+        files[path] = buffer;
+    open = false;
+}
+
+bool SPIFFSFS::begin(bool /* formatOnFail */) { return true; }
+
+File SPIFFSFS::open(const char *path, const char *mode)
+{
+    bool write = mode[0] == 'w';
+    if (write)
+        fileWriteCount++;
+    return File(path, write);
+}
+
+bool SPIFFSFS::exists(const char *path) { return files.count(path) != 0; }
+bool SPIFFSFS::remove(const char *path) { return files.erase(path) != 0; }
+
+// Host harness
+
+namespace host
+{
+    void setMillis(unsigned long ms) { nowMillis = ms; }
+    void advanceMillis(unsigned long ms) { nowMillis += ms; }
+
+    void setSerialOutput(FILE *output) { serialOutput = output; }
+    void serialInput(const std::string &line) { serialLines.push_back(line); }
+
+    void setPin(uint8_t pin, int level) { pinInputs[pin] = level; }
+
+    int pinLevel(uint8_t pin)
+    {
+        auto it = pinLevels.find(pin);
+        return it == pinLevels.end() ? LOW : it->second;
+    }
+
+    uint32_t pinWrites(uint8_t pin)
+    {
+        auto it = pinWriteCounts.find(pin);
+        return it == pinWriteCounts.end() ? 0 : it->second;
+    }
+
+    void setHeap(uint32_t freeHeap, uint32_t minFreeHeap, uint32_t largestFreeBlock)
+    {
+        heapFree = freeHeap;
+        heapMinFree = minFreeHeap;
+        heapLargestBlock = largestFreeBlock;
+    }
+
+    void setStackHighWaterMark(const char *taskName, uint32_t bytes)
+    {
+        stackHighWaterMarks[taskName] = bytes;
+    }
+
+    void connect(const uint8_t address[6])
+    {
+        static const uint8_t defaultAddress[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+        memcpy(connectedAddress, address ? address : defaultAddress, sizeof(esp_bd_addr_t));
+
+        if (server == nullptr || server->getCallbacks() == nullptr)
+            return;
+
+        esp_ble_gatts_cb_param_t param = {};
+        memcpy(param.connect.remote_bda, connectedAddress, sizeof(esp_bd_addr_t));
+        // The app turns notifications of the command characteristic on first
+        subscribe(nullptr, true);
+        server->getCallbacks()->onConnect(server, &param);
+    }
+
+    void disconnect()
+    {
+        if (server == nullptr || server->getCallbacks() == nullptr)
+            return;
+        server->getCallbacks()->onDisconnect(server);
+    }
+
+    void write(const uint8_t *data, size_t length, const char *characteristicUuid)
+    {
+        BLECharacteristic *characteristic = findCharacteristic(characteristicUuid);
+        if (characteristic == nullptr)
+            return;
+
+        characteristic->setValue(data, length);
+        if (characteristic->getCallbacks())
+            characteristic->getCallbacks()->onWrite(characteristic);
+    }
+
+    void write(const std::vector<uint8_t> &data, const char *characteristicUuid)
+    {
+        write(data.data(), data.size(), characteristicUuid);
+    }
+
+    std::vector<uint8_t> read(const char *characteristicUuid)
+    {
+        BLECharacteristic *characteristic = findCharacteristic(characteristicUuid);
+        if (characteristic == nullptr)
+            return std::vector<uint8_t>();
+
+        if (characteristic->getCallbacks())
+            characteristic->getCallbacks()->onRead(characteristic);
+        const uint8_t *data = characteristic->getData();
+        return std::vector<uint8_t>(data, data + characteristic->getLength());
+    }
+
+    bool subscribe(const char *characteristicUuid, bool enabled)
+    {
+        BLECharacteristic *characteristic = findCharacteristic(characteristicUuid);
+        if (characteristic == nullptr)
+            return false;
+
+        for (BLEDescriptor *descriptor : characteristic->getDescriptors())
+        {
+            BLE2902 *cccd = dynamic_cast<BLE2902 *>(descriptor);
+            if (cccd != nullptr)
+            {
+                cccd->setNotifications(enabled);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<uint8_t> buildFrame(uint32_t counter, uint8_t command, const uint8_t *data, uint8_t dataLength, int requestId)
+    {
+        uint8_t key[32];
+        mbedtls_sha256((const unsigned char *)PASSWORD, strlen(PASSWORD), key, 0);
+
+        std::vector<uint8_t> frame(32);
+        mbedtls_md_context_t ctx;
+        mbedtls_md_init(&ctx);
+        mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+        mbedtls_md_hmac_starts(&ctx, key, sizeof(key));
+        mbedtls_md_hmac_update(&ctx, (const uint8_t *)&counter, sizeof(counter));
+        mbedtls_md_hmac_update(&ctx, &command, 1);
+        if (signsPayload(static_cast<ClientCommand>(command)) && data != nullptr)
+            mbedtls_md_hmac_update(&ctx, data, dataLength);
+        mbedtls_md_hmac_finish(&ctx, frame.data());
+        mbedtls_md_free(&ctx);
+
+        frame.push_back(command);
+        if ((data != nullptr && dataLength > 0) || requestId >= 0)
+        {
+            frame.push_back(dataLength);
+            if (dataLength > 0)
+                frame.insert(frame.end(), data, data + dataLength);
+        }
+        if (requestId >= 0)
+            frame.push_back(static_cast<uint8_t>(requestId));
+        return frame;
+    }
+
+    bool rssiRequested() { return rssiPending; }
+    uint32_t rssiRequests() { return rssiRequestCount; }
+
+    void deliverRssi(int8_t rssi)
+    {
+        rssiPending = false;
+        if (gapCallback == nullptr)
+            return;
+
+        esp_ble_gap_cb_param_t param = {};
+        param.read_rssi_cmpl.status = ESP_BT_STATUS_SUCCESS;
+        param.read_rssi_cmpl.rssi = rssi;
+        memcpy(param.read_rssi_cmpl.remote_addr, connectedAddress, sizeof(esp_bd_addr_t));
+        gapCallback(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, &param);
+    }
+
+    const std::vector<Notification> &notifications() { return sentNotifications; }
+    void clearNotifications() { sentNotifications.clear(); }
+
+    void resetFlash()
+    {
+        files.clear();
+        fileWriteCount = 0;
+    }
+
+    uint32_t flashWrites() { return fileWriteCount; }
+
+    uint32_t advertisingStarts() { return advertisingStartCount; }
+
+    bool scanListening()
+    {
+        if (!scan.running)
+            return false;
+
+        unsigned long elapsed = nowMillis - scan.startMillis;
+        if (scan.durationMillis != 0 && elapsed >= scan.durationMillis)
+        {
+            scan.running = false;
+            if (scan.completeCallback)
+                scan.completeCallback(BLEScanResults());
+            return false;
+        }
+        return scan.interval == 0 || elapsed % scan.interval < scan.window;
+    }
+
+    uint32_t scanStarts() { return scanStartCount; }
+
+    bool advertise(const std::vector<uint8_t> &manufacturerData, int8_t rssi)
+    {
+        if (!scanListening() || scan.callbacks == nullptr)
+            return false;
+
+        std::string data(manufacturerData.begin(), manufacturerData.end());
+        scan.callbacks->onResult(BLEAdvertisedDevice(data, rssi));
+        return true;
+    }
+}
@@ -3,33 +3,62 @@
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include "bluetooth.h"
 #include "esp_gap_ble_api.h"
 #include "commands.h"
+#include "frame.h"
+#include "internal.h"
+#include "presence.h"
+#include "state.h"
+#include "stats.h"
+#include "stream.h"
+#include "tlv.h"
+#include "timers.h"
+#include "vehicle.h"
+#include "telemetry/memory.h"
+#include "telemetry/trace.h"
+#include "log/log.h"
+#include "proximity/filter.h"
+#include "proximity/sampling.h"
+#include "proximity/trend.h"
+#include "proximity/calibration.h"
+#include "proximity/fusion.h"
 #include <mbedtls/sha256.h>
 #include <mbedtls/md.h>
 #include <SPIFFS.h>
 #include <config.h>
 
 #define BLE_MTU_SIZE 64
-// BLE service and characteristic UUIDs
+// Response data that fits into one notification (ATT header + code + length byte)
+#define MAX_RESPONSE_DATA_LENGTH (BLE_MTU_SIZE - 3 - 2)
+// BLE service and characteristic UUIDs: commands and their answers, the
+// vehicle state (read/notify), reports and RSSI streams (notify)
 #define SERVICE_UUID "0000ffe0-0000-1000-8000-00805f9b34fb"
 #define CHARACTERISTIC_UUID "0000ffe1-0000-1000-8000-00805f9b34fb"
-
-#define RSSI_SAMPLES 5 // Number of samples for smoothing
+#define STATE_CHARACTERISTIC_UUID "0000ffe2-0000-1000-8000-00805f9b34fb"
+#define STREAM_CHARACTERISTIC_UUID "0000ffe3-0000-1000-8000-00805f9b34fb"
 
 const std::string PROTOCOL_VERSION = "V4";
+// Commands a client may have waiting for their answer (GET_LIMITS). Commands
+// are handled in the order they arrive, this keeps the writes queued in the
+// BLE stack and the answers queued for the link small.
+const uint8_t COMMAND_CREDITS = 4;
 
 BLEServer *pServer = NULL;
 BLECharacteristic *pCharacteristic = NULL;
+BLECharacteristicCallbacks *pCommandCallbacks = NULL;
+BLECharacteristic *pStateCharacteristic = NULL;
+BLECharacteristic *pStreamCharacteristic = NULL;
+BLE2902 *pStateCccd = NULL;
+BLE2902 *pStreamCccd = NULL;
 esp_bd_addr_t peerAddress;
 
 uint8_t sharedSecret[32];
 uint32_t counter = 0;
 
-// How many counters ahead of the stored one are still accepted.
-static const uint32_t COUNTER_WINDOW = 64;
-
 void (*onConnected)() = nullptr;
 void (*onDisconnected)() = nullptr;
 void (*onLocked)(bool proximity) = nullptr;
@@ -39,6 +68,7 @@ void (*onEngineStarted)() = nullptr;
 void (*onEngineStopped)() = nullptr;
 void (*onWindowsOpened)() = nullptr;
 void (*onWindowsClosed)() = nullptr;
+void (*onApproaching)() = nullptr;
 
 bool isLocked = true;
 // Engine and window state are only kept in RAM, so they reset to their safe
@@ -46,7 +76,17 @@ bool isLocked = true;
 bool engineOn = false;
 bool windowsOpen = false;
 bool deviceConnected = false;
+// The client sent a command with a valid HMAC on this connection, so it may
+// read and subscribe to the state characteristic
+bool authenticated = false;
 bool autoLocking = false;
+// Versions of the state bits above (STATE_SINCE)
+state::Journal stateJournal;
+// Decides which requests change the state bits above, see transition()
+vehicle::Machine vehicleState;
+// Commands the controller runs later by itself, also guarded by vehicleMux
+timers::Table timerTable;
+portMUX_TYPE vehicleMux = portMUX_INITIALIZER_UNLOCKED;
 
 bool oldDeviceConnected = false;
 
@@ -64,42 +104,114 @@ float triggerRssiStrength = 0;
 float releaseRssiStrength = 0;
 float lastRssiStrength = 0;
 int rssiDeadZone = 4;
-int rssiBuffer[RSSI_SAMPLES] = {0};
-int rssiIndex = 0;
-bool bufferFilled = false;
 unsigned long previousRssiMillis = 0;
-const long rssiInterval = 500;
+unsigned long rssiInterval = RSSI_INTERVAL_MIN; // Adapted to the phone's position by gapCallback
+proximity::SamplingPlanner rssiSampling;
+proximity::TrendEstimator proximityTrend;
+proximity::Calibration rangeCalibration;
+proximity::RssiFusion rssiFusion; // With the RSSI the phone measures (PHONE_RSSI)
+bool rangeCalibrated = false; // Trigger/release RSSI come from CALIBRATE, not RSSI_TRIGGER
+const float maxCalibrationSeconds = 120;
+bool approachArmed = false; // Fast connection interval requested for an expected unlock
+bool approachAnnounced = false; // onApproaching was called for the current approach
+// Presence scan (PRESENCE_SCAN): wanted after a disconnect with the proximity
+// key on, its readings run through their own zone state machine
+bool presenceWanted = false;
+bool presenceSeen = false;
+unsigned long lastPresenceMillis = 0;
+unsigned long presenceApproachMillis = 0; // When presenceZones entered Approaching
+proximity::ZoneTracker presenceZones;
 bool sendRssi = false;
+// RSSI_STREAM subscription, 0 while there is none. Only touched from the BLE
+// task (commands, GAP callback, connection events)
+uint16_t rssiStreamInterval = 0;
+unsigned long rssiStreamUntil = 0;
+stream::RssiBatch rssiBatch;
 float proximityCooldown = 1; // in min
-unsigned long previousProximityMillis = 0;
-
-void sendToClient(Esp32Response responseCode, const uint8_t *data = nullptr, size_t dataLen = 0)
+proximity::ZoneTracker proximityZones;
+
+// Report of a GET_STATS/GET_MEMORY command, streamed one record per
+// notification from bluetoothLoop so the BLE task is never blocked by it
+Esp32Response reportResponse;
+size_t (*nextReportRecord)(uint8_t *out, size_t maxLength) = nullptr;
+unsigned long previousReportMillis = 0;
+const long reportInterval = 20;
+int16_t reportRequestId = frame::NO_REQUEST_ID;
+
+// Request ID of the command being handled (the byte after its data), echoed
+// after the data of every answer to it. Only notifications sent by the task
+// handling it carry it, not the ones other tasks send meanwhile. GET_RSSI and
+// reports keep it for their later answers, commands that aren't answered at
+// all get COMMAND_DONE.
+int16_t requestId = frame::NO_REQUEST_ID;
+TaskHandle_t requestTask = nullptr;
+bool requestAnswered = false;
+int16_t rssiRequestId = frame::NO_REQUEST_ID;
+
+// Held around setValue() and notify() of a characteristic: the BTC task answers
+// commands and reads while the loop task notifies timers, report*(), reports and
+// memory alerts. A mutex rather than a critical section, notify() may block
+SemaphoreHandle_t notifyMutex = nullptr;
+
+void notifyResponse(BLECharacteristic *characteristic, Esp32Response responseCode, const uint8_t *data, size_t dataLen,
+                    int16_t answering)
 {
-    if (dataLen > 12)
+    // The request ID takes the last byte
+    size_t maxLength = answering != frame::NO_REQUEST_ID ? MAX_RESPONSE_DATA_LENGTH - 1 : MAX_RESPONSE_DATA_LENGTH;
+    if (dataLen > maxLength)
     {
-        Serial.println("Warning: data truncated to 12 bytes.");
-        dataLen = 12;
+        LOG_WARN(RESPONSE_TRUNCATED, maxLength);
+        dataLen = maxLength;
     }
 
-    size_t totalBufferSize = 1 + (dataLen > 0 ? 1 + dataLen : 0);
+    size_t totalBufferSize = 1 + (dataLen > 0 || answering != frame::NO_REQUEST_ID ? 1 + dataLen : 0);
+    if (answering != frame::NO_REQUEST_ID)
+        totalBufferSize++;
     std::vector<uint8_t> responseBuffer(totalBufferSize);
 
     responseBuffer[0] = static_cast<uint8_t>(responseCode);
 
-    if (DEBUG_MODE)
-        Serial.printf("Sent ESP32 Response: 0x%02X\n", static_cast<uint8_t>(responseCode));
-
-    if (dataLen > 0)
+    if (totalBufferSize > 1)
     {
         responseBuffer[1] = static_cast<uint8_t>(dataLen);
-        memcpy(responseBuffer.data() + 2, data, dataLen);
-
-        if (DEBUG_MODE)
-            Serial.printf(", Data Length: %zu\n", dataLen);
+        if (dataLen > 0)
+            memcpy(responseBuffer.data() + 2, data, dataLen);
     }
+    if (answering != frame::NO_REQUEST_ID)
+        responseBuffer[totalBufferSize - 1] = static_cast<uint8_t>(answering);
+
+    LOG_DEBUG(RESPONSE_SENT, responseCode, dataLen);
+
+    xSemaphoreTake(notifyMutex, portMAX_DELAY);
+    characteristic->setValue(responseBuffer.data(), totalBufferSize);
+    characteristic->notify();
+    xSemaphoreGive(notifyMutex);
 
-    pCharacteristic->setValue(responseBuffer.data(), totalBufferSize);
-    pCharacteristic->notify();
+    stats::mark(stats::Stage::ResponseNotified);
+}
+
+void sendResponse(Esp32Response responseCode, const uint8_t *data, size_t dataLen, int16_t answering)
+{
+    notifyResponse(pCharacteristic, responseCode, data, dataLen, answering);
+}
+
+// Reports and RSSI batches go to the stream characteristic if the client
+// subscribed to it, to the command characteristic otherwise (older apps)
+void sendStream(Esp32Response responseCode, const uint8_t *data, size_t dataLen, int16_t answering)
+{
+    bool subscribed = pStreamCccd != NULL && pStreamCccd->getNotifications();
+    notifyResponse(subscribed ? pStreamCharacteristic : pCharacteristic, responseCode, data, dataLen, answering);
+}
+
+void sendToClient(Esp32Response responseCode, const uint8_t *data, size_t dataLen)
+{
+    int16_t answering = frame::NO_REQUEST_ID;
+    if (requestId != frame::NO_REQUEST_ID && xTaskGetCurrentTaskHandle() == requestTask)
+    {
+        answering = requestId;
+        requestAnswered = true;
+    }
+    sendResponse(responseCode, data, dataLen, answering);
 }
 
 void sendToClientFloat(Esp32Response responseCode, float value)
@@ -119,264 +231,1307 @@ void sendToClientString(Esp32Response responseCode, const std::string &str)
 
 namespace
 {
-    void lock(bool proximity = false, bool ignoreCooldown = false)
+    void encodeState(uint8_t *out)
     {
-        if (proximity &&
-            previousProximityMillis != 0 &&
-            proximityCooldown != 0 &&
-            !ignoreCooldown &&
-            ((millis() - previousProximityMillis) < (proximityCooldown * 60000)))
-        {
+        out[0] = stateJournal.bits();
+        out[1] = state::supportedBits(SUPPORTED_FEATURES);
+        state::encodeVersion(stateJournal.version(), out + 2);
+    }
+
+    // Pushes the latest change of the state bits to an authenticated client
+    // that subscribed to the state characteristic
+    void notifyStateDelta()
+    {
+        if (!deviceConnected || !authenticated || pStateCccd == NULL || !pStateCccd->getNotifications())
             return;
+
+        uint8_t data[state::DELTA_LENGTH];
+        state::encodeDelta(stateJournal.latest(), data);
+        notifyResponse(pStateCharacteristic, Esp32Response::STATE_DELTA, data, sizeof(data), frame::NO_REQUEST_ID);
+    }
+
+    // State bits of the vehicle and the pending timers, only under vehicleMux
+    uint8_t stateBits()
+    {
+        return vehicleState.bits() | (timerTable.pending(timers::Kind::Relock) ? state::RelockPending : 0) |
+               (timerTable.pending(timers::Kind::Shutoff) ? state::ShutoffPending : 0) |
+               (timerTable.pending(timers::Kind::Scheduled) ? state::Scheduled : 0);
+    }
+
+    // Writes the time left of the timers to flash
+    void saveTimers()
+    {
+        uint8_t data[timers::MAX_TIMERS * timers::ENTRY_LENGTH];
+        portENTER_CRITICAL(&vehicleMux);
+        size_t length = timerTable.encode(millis(), data);
+        portEXIT_CRITICAL(&vehicleMux);
+        writeTimers(data, length);
+    }
+
+    // The timers changed: records their state bits and saves them
+    void timersChanged()
+    {
+        portENTER_CRITICAL(&vehicleMux);
+        bool changed = stateJournal.record(stateBits());
+        portEXIT_CRITICAL(&vehicleMux);
+        if (changed)
+            notifyStateDelta();
+        saveTimers();
+    }
+
+    // Runs a request through the vehicle state machine. Deciding and taking the
+    // new state is one critical section, commands (BLE task), the proximity key
+    // (GAP callback, loop), timers and report*() don't interleave; the caller
+    // actuates after it, and only if told to
+    vehicle::Decision transition(vehicle::Device device, bool on, vehicle::Source source)
+    {
+        portENTER_CRITICAL(&vehicleMux);
+        vehicle::Decision decision = vehicleState.request(device, on, source, millis());
+        // Anything else changing the lock or engine makes its timer pointless
+        bool cancelled = false;
+        if (decision.accepted() && source != vehicle::Source::Timer)
+        {
+            if (device == vehicle::Device::Doors)
+                cancelled = timerTable.cancel(timers::Kind::Relock);
+            else if (device == vehicle::Device::Engine)
+                cancelled = timerTable.cancel(timers::Kind::Shutoff);
+        }
+        bool changed = decision.accepted() && stateJournal.record(stateBits());
+        isLocked = vehicleState.isOn(vehicle::Device::Doors);
+        engineOn = vehicleState.isOn(vehicle::Device::Engine);
+        windowsOpen = vehicleState.isOn(vehicle::Device::Windows);
+        portEXIT_CRITICAL(&vehicleMux);
+
+        if (!decision.accepted())
+        {
+            LOG_DEBUG(ACTION_DROPPED, device, on, decision.outcome);
+            return decision;
         }
+        LOG_DEBUG(TRANSITION, decision.sequence, device, on);
+        if (changed)
+            notifyStateDelta();
+        if (cancelled)
+            saveTimers();
+        return decision;
+    }
+
+    // The answer to a command that didn't actuate: the state it asked for
+    void sendDeviceState(vehicle::Device device)
+    {
+        if (!deviceConnected)
+            return;
+        if (device == vehicle::Device::Doors)
+            sendToClient(isLocked ? Esp32Response::LOCKED : Esp32Response::UNLOCKED);
+        else if (device == vehicle::Device::Engine)
+            sendToClient(engineOn ? Esp32Response::ENGINE_STARTED : Esp32Response::ENGINE_STOPPED);
+        else
+            sendToClient(windowsOpen ? Esp32Response::WINDOWS_OPENED : Esp32Response::WINDOWS_CLOSED);
+    }
+
+    // True if the relay should pulse, answers a command that shouldn't
+    bool actuates(vehicle::Device device, bool on, vehicle::Source source)
+    {
+        if (transition(device, on, source).outcome == vehicle::Outcome::Actuate)
+            return true;
+        if (source == vehicle::Source::Command)
+            sendDeviceState(device);
+        return false;
+    }
+
+    void lock(vehicle::Source source = vehicle::Source::Command)
+    {
+        if (!actuates(vehicle::Device::Doors, true, source))
+            return;
 
+        bool proximity = source == vehicle::Source::Proximity || source == vehicle::Source::AutoLock;
         if (proximity)
-            previousProximityMillis = millis();
+        {
+            stats::countProximityAction();
+            telemetry::traceEvent(telemetry::TraceEvent::Lock);
+        }
 
         if (deviceConnected)
         {
             sendToClient(proximity ? Esp32Response::PROXIMITY_LOCKED : Esp32Response::LOCKED);
         }
 
-        isLocked = true;
-
         if (onLocked)
             onLocked(proximity);
+        stats::mark(stats::Stage::CallbackInvoked);
 
-        if (DEBUG_MODE)
-            Serial.println("Locked (proximity:" + String(proximity) + ")");
+        LOG_INFO(LOCKED, proximity);
     }
 
-    void unlock(bool proximity = false, bool ignoreCooldown = false)
+    void unlock(vehicle::Source source = vehicle::Source::Command)
     {
-
-        if (proximity &&
-            previousProximityMillis != 0 &&
-            proximityCooldown != 0 &&
-            !ignoreCooldown &&
-            ((millis() - previousProximityMillis) < (proximityCooldown * 60000)))
-        {
+        if (!actuates(vehicle::Device::Doors, false, source))
             return;
-        }
 
+        bool proximity = source == vehicle::Source::Proximity || source == vehicle::Source::AutoLock;
         if (proximity)
-            previousProximityMillis = millis();
+        {
+            stats::countProximityAction();
+            telemetry::traceEvent(telemetry::TraceEvent::Unlock);
+        }
 
         if (deviceConnected)
         {
             sendToClient(proximity ? Esp32Response::PROXIMITY_UNLOCKED : Esp32Response::UNLOCKED);
         }
 
-        isLocked = false;
-
         if (onUnlocked)
             onUnlocked(proximity);
+        stats::mark(stats::Stage::CallbackInvoked);
 
-        if (DEBUG_MODE)
-            Serial.println("Unlocked (proximity:" + String(proximity) + ")");
+        LOG_INFO(UNLOCKED, proximity);
     }
 
     void openTrunk()
     {
         if (onTrunkOpened)
             onTrunkOpened();
+        stats::mark(stats::Stage::CallbackInvoked);
     }
 
-    void startEngine()
+    void startEngine(vehicle::Source source = vehicle::Source::Command)
     {
+        if (!actuates(vehicle::Device::Engine, true, source))
+            return;
+
         if (deviceConnected)
             sendToClient(Esp32Response::ENGINE_STARTED);
 
-        engineOn = true;
-
         if (onEngineStarted)
             onEngineStarted();
+        stats::mark(stats::Stage::CallbackInvoked);
 
-        if (DEBUG_MODE)
-            Serial.println("Engine started");
+        LOG_INFO(ENGINE_STARTED);
     }
 
-    void stopEngine()
+    void stopEngine(vehicle::Source source = vehicle::Source::Command)
     {
+        if (!actuates(vehicle::Device::Engine, false, source))
+            return;
+
         if (deviceConnected)
             sendToClient(Esp32Response::ENGINE_STOPPED);
 
-        engineOn = false;
-
         if (onEngineStopped)
             onEngineStopped();
+        stats::mark(stats::Stage::CallbackInvoked);
 
-        if (DEBUG_MODE)
-            Serial.println("Engine stopped");
+        LOG_INFO(ENGINE_STOPPED);
     }
 
-    void openWindows()
+    void openWindows(vehicle::Source source = vehicle::Source::Command)
     {
+        if (!actuates(vehicle::Device::Windows, true, source))
+            return;
+
         if (deviceConnected)
             sendToClient(Esp32Response::WINDOWS_OPENED);
 
-        windowsOpen = true;
-
         if (onWindowsOpened)
             onWindowsOpened();
+        stats::mark(stats::Stage::CallbackInvoked);
 
-        if (DEBUG_MODE)
-            Serial.println("Windows opened");
+        LOG_INFO(WINDOWS_OPENED);
     }
 
-    void closeWindows()
+    void closeWindows(vehicle::Source source = vehicle::Source::Command)
     {
+        if (!actuates(vehicle::Device::Windows, false, source))
+            return;
+
         if (deviceConnected)
             sendToClient(Esp32Response::WINDOWS_CLOSED);
 
-        windowsOpen = false;
-
         if (onWindowsClosed)
             onWindowsClosed();
+        stats::mark(stats::Stage::CallbackInvoked);
+
+        LOG_INFO(WINDOWS_CLOSED);
+    }
+
+    // Commands a timer may run: changing the vehicle state, and supported
+    bool schedulable(uint8_t command)
+    {
+        switch (static_cast<ClientCommand>(command))
+        {
+        case ClientCommand::LOCK_DOORS:
+        case ClientCommand::UNLOCK_DOORS:
+        case ClientCommand::START_ENGINE:
+        case ClientCommand::STOP_ENGINE:
+        case ClientCommand::OPEN_WINDOWS:
+        case ClientCommand::CLOSE_WINDOWS:
+            return hasFeature(SUPPORTED_FEATURES, commandInfo(static_cast<ClientCommand>(command))->feature);
+        default:
+            return false;
+        }
+    }
+
+    // Adds a timer and reports it (state bits, flash), false if the table is full
+    bool setTimer(ClientCommand command, timers::Kind kind, uint32_t seconds)
+    {
+        portENTER_CRITICAL(&vehicleMux);
+        bool added = timerTable.add(static_cast<uint8_t>(command), kind, seconds * 1000, millis());
+        portEXIT_CRITICAL(&vehicleMux);
+        if (!added)
+        {
+            LOG_WARN(TIMER_REJECTED, command, seconds);
+            return false;
+        }
+
+        LOG_INFO(TIMER_SET, command, seconds, kind);
+        timersChanged();
+        return true;
+    }
+
+    // Answers `command` with COMMAND_REJECTED, it set no timer and changed nothing
+    void rejectTimer(ClientCommand command, uint8_t timerCommand, uint32_t seconds)
+    {
+        LOG_WARN(TIMER_REJECTED, timerCommand, seconds);
+        uint8_t rejected = static_cast<uint8_t>(command);
+        sendToClient(Esp32Response::COMMAND_REJECTED, &rejected, sizeof(rejected));
+    }
+
+    // True if a timer of the kind can be set, otherwise rejects `command`: a
+    // timed command doesn't actuate without its timer
+    bool timerAvailable(ClientCommand command, timers::Kind kind, uint32_t seconds)
+    {
+        portENTER_CRITICAL(&vehicleMux);
+        bool room = timerTable.hasRoom(kind);
+        portEXIT_CRITICAL(&vehicleMux);
+        if (room)
+            return true;
+
+        rejectTimer(command, static_cast<uint8_t>(command), seconds);
+        return false;
+    }
+
+    // A Scheduled timer of the command is in the table and can run (setupBluetooth)
+    bool restoredSchedule(ClientCommand command)
+    {
+        return schedulable(static_cast<uint8_t>(command)) && timerTable.scheduled(static_cast<uint8_t>(command));
+    }
+
+    void runTimer(const timers::Timer &timer)
+    {
+        if (!schedulable(timer.command))
+            return; // Saved by a firmware with other features
+
+        LOG_INFO(TIMER_RAN, timer.command, timer.kind);
+        switch (static_cast<ClientCommand>(timer.command))
+        {
+        case ClientCommand::LOCK_DOORS:
+            lock(vehicle::Source::Timer);
+            break;
+        case ClientCommand::UNLOCK_DOORS:
+            unlock(vehicle::Source::Timer);
+            break;
+        case ClientCommand::START_ENGINE:
+            startEngine(vehicle::Source::Timer);
+            break;
+        case ClientCommand::STOP_ENGINE:
+            stopEngine(vehicle::Source::Timer);
+            break;
+        case ClientCommand::OPEN_WINDOWS:
+            openWindows(vehicle::Source::Timer);
+            break;
+        case ClientCommand::CLOSE_WINDOWS:
+            closeWindows(vehicle::Source::Timer);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Runs the timers that are due
+    void runTimers()
+    {
+        timers::Timer due;
+        bool ran = false;
+        for (;;)
+        {
+            portENTER_CRITICAL(&vehicleMux);
+            bool taken = timerTable.takeDue(millis(), due);
+            portEXIT_CRITICAL(&vehicleMux);
+            if (!taken)
+                break;
+            runTimer(due);
+            ran = true;
+        }
+
+        if (ran)
+            timersChanged();
+    }
+
+    void sendSchedule()
+    {
+        uint8_t data[timers::MAX_TIMERS * timers::ENTRY_LENGTH];
+        portENTER_CRITICAL(&vehicleMux);
+        size_t length = timerTable.encode(millis(), data);
+        portEXIT_CRITICAL(&vehicleMux);
+        sendToClient(Esp32Response::SCHEDULE, data, length);
+    }
+
+    // The presence scan saw the phone shortly before it connected
+    bool presenceFresh()
+    {
+        return presenceSeen && millis() - lastPresenceMillis <= presence::PRESENCE_FRESH_MILLIS;
+    }
+
+    // Starts the proximity key over from the current lock state, or carries on
+    // with what the presence scan saw right before the connection
+    void resetProximity()
+    {
+        proximity::Zone seen = presenceZones.zone();
+        if (presenceFresh() && isLocked && (seen == proximity::Zone::Approaching || seen == proximity::Zone::Near))
+        {
+            // The unlock dwell counts from the approach in the advertisements,
+            // the unlock itself needs a reading through the connection
+            proximityZones.enter(proximity::Zone::Approaching, presenceApproachMillis);
+        }
+        else
+        {
+            proximityZones.reset(!isLocked);
+        }
+
+        if (!presenceFresh())
+        {
+            proximityTrend.reset();
+            approachAnnounced = false;
+        }
+        rssiSampling.reset();
+        rssiInterval = RSSI_INTERVAL_MIN;
+        approachArmed = false;
+    }
+
+    void enableProxKey()
+    {
+        autoLocking = true;
+        resetProximity();
+    }
+
+    void disableProxKey()
+    {
+        autoLocking = false;
+    }
+
+    // Request ID for an answer that is sent later (frame::NO_REQUEST_ID without one)
+    int16_t deferAnswer()
+    {
+        requestAnswered = true;
+        return requestId;
+    }
+
+    // sendReport() offers a record one byte less than a notification (request ID)
+    static_assert(stats::MAX_RECORD_LENGTH <= MAX_RESPONSE_DATA_LENGTH - 1, "STATS records fit a notification");
+    static_assert(telemetry::MEMORY_RECORD_LENGTH <= MAX_RESPONSE_DATA_LENGTH - 1, "MEMORY records fit a notification");
+
+    void startReport(Esp32Response responseCode, size_t (*nextRecord)(uint8_t *out, size_t maxLength))
+    {
+        reportRequestId = deferAnswer();
+        reportResponse = responseCode;
+        nextReportRecord = nextRecord;
+    }
+
+    void sendRssiBatch()
+    {
+        uint8_t data[stream::RSSI_SAMPLES_HEADER_LENGTH + stream::RSSI_BATCH_CAPACITY];
+        size_t length = rssiBatch.encode(data);
+        sendStream(Esp32Response::RSSI_SAMPLES, data, length, frame::NO_REQUEST_ID);
+        rssiBatch.clear();
+    }
+
+    void stopRssiStream()
+    {
+        if (rssiStreamInterval == 0)
+            return;
+
+        if (deviceConnected)
+        {
+            if (!rssiBatch.empty())
+                sendRssiBatch();
+            sendStream(Esp32Response::RSSI_SAMPLES, nullptr, 0, frame::NO_REQUEST_ID); // The end
+        }
+        rssiStreamInterval = 0;
+        rssiBatch.clear();
+        LOG_INFO(RSSI_STREAM_STOPPED);
+    }
+
+    void streamRssi(float rssi)
+    {
+        unsigned long currentMillis = millis();
+        if (static_cast<long>(currentMillis - rssiStreamUntil) >= 0)
+        {
+            stopRssiStream();
+            return;
+        }
+
+        int8_t sample = static_cast<int8_t>(rssi < -128 ? -128 : (rssi > 127 ? 127 : lroundf(rssi)));
+        if (rssiBatch.add(sample, currentMillis) == stream::BatchResult::Late)
+        {
+            sendRssiBatch();
+            rssiBatch.add(sample, currentMillis);
+        }
+        long batchMillis = static_cast<long>(currentMillis - rssiBatch.firstMillis()); // Negative while empty
+        if (!rssiBatch.empty() && (rssiBatch.full() || batchMillis >= static_cast<long>(stream::RSSI_STREAM_BATCH_MILLIS)))
+            sendRssiBatch();
+    }
+
+    void notifyMemoryAlert(const telemetry::MemorySample &sample)
+    {
+        if (!deviceConnected)
+            return;
+
+        uint8_t record[telemetry::MEMORY_RECORD_LENGTH];
+        size_t length = telemetry::encodeMemorySample(sample, record);
+        sendToClient(Esp32Response::MEMORY_ALERT, record, length);
+    }
+
+    void sendFilterConfig()
+    {
+        uint8_t data[proximity::FILTER_CONFIG_LENGTH];
+        size_t length = proximity::encodeFilterConfig(proximity::filterConfig(), data);
+        sendToClient(Esp32Response::RSSI_FILTER, data, length);
+    }
+
+    // The dead zone is the distance in (rough) meters the phone has to move
+    // away from the trigger point before the release RSSI is reached
+    float calculateReleaseRssi(float triggerRssiStrength, float deadZone, float pathLossExponent = 3.0)
+    {
+        float deltaRssi = -10 * pathLossExponent * log10((deadZone + 1) / 1);
+        return triggerRssiStrength + deltaRssi;
+    }
+
+    // Requests the fast connection interval (and lets main.cpp get the actuator
+    // ready) while the trend says the phone reaches the trigger RSSI soon
+    void updateApproach(proximity::Zone zone)
+    {
+        bool approaching = false;
+        if (isLocked && zone == proximity::Zone::Approaching)
+        {
+            approaching = true;
+        }
+        else if (isLocked && zone == proximity::Zone::Far)
+        {
+            int32_t millisToTrigger = proximityTrend.millisUntil(triggerRssiStrength, proximity::PREARM_MIN_R_SQUARED);
+            approaching = millisToTrigger >= 0 && millisToTrigger <= PROXIMITY_PREARM_HORIZON;
+        }
+
+        if (approaching && !approachArmed)
+        {
+            approachArmed = true;
+            connParamsPending = false;
+            // 0x18*1.25ms=30ms .. 0x28*1.25ms=50ms, no latency, timeout 400*10ms=4s
+            pServer->updateConnParams(peerAddress, 0x18, 0x28, 0, 400);
+            LOG_INFO(APPROACH_ARMED, proximityTrend.slope(), proximityTrend.rSquared());
+
+            if (onApproaching && !approachAnnounced)
+                onApproaching();
+            approachAnnounced = true;
+        }
+        else if (!approaching && approachArmed)
+        {
+            // Back to the low-power parameters (sent from bluetoothLoop)
+            approachArmed = false;
+            approachAnnounced = false;
+            connParamUpdateAt = millis();
+            connParamsPending = true;
+            LOG_DEBUG(APPROACH_DISARMED);
+        }
+    }
+
+    void configureProximityZones()
+    {
+        uint32_t cooldown = proximityCooldown * 60000;
+        proximity::ZoneConfig config;
+        config.trigger = triggerRssiStrength;
+        config.release = releaseRssiStrength;
+        config.unlockDwell = PROXIMITY_UNLOCK_DWELL;
+        config.lockDwell = PROXIMITY_LOCK_DWELL;
+        config.minActionInterval = cooldown > PROXIMITY_MIN_ACTION_INTERVAL ? cooldown : PROXIMITY_MIN_ACTION_INTERVAL;
+        proximityZones.configure(config);
+
+        // Its actions only show where the phone is, they are never carried out
+        config.minActionInterval = 0;
+        presenceZones.configure(config);
+    }
+
+    void setRssiTrigger(float trigger, int deadZone)
+    {
+        rssiDeadZone = deadZone;
+        if (rangeCalibrated)
+        {
+            // The app sends its slider values on every connect
+            LOG_INFO(RSSI_TRIGGER_CALIBRATED, triggerRssiStrength, releaseRssiStrength);
+            return;
+        }
+
+        triggerRssiStrength = trigger;
+        releaseRssiStrength = calculateReleaseRssi(triggerRssiStrength, rssiDeadZone);
+        configureProximityZones();
+
+        LOG_INFO(RSSI_TRIGGER_SET, triggerRssiStrength, releaseRssiStrength);
+    }
+
+    void setProximityCooldown(float minutes)
+    {
+        proximityCooldown = minutes;
+        configureProximityZones();
+        LOG_INFO(PROXIMITY_COOLDOWN_SET, proximityCooldown);
+    }
+
+    void sendSettings()
+    {
+        uint8_t data[MAX_RESPONSE_DATA_LENGTH];
+        tlv::Writer writer(data, sizeof(data));
+        writer.putF32(tlv::Setting::TriggerRssi, triggerRssiStrength);
+        writer.putF32(tlv::Setting::ReleaseRssi, releaseRssiStrength);
+        writer.putU8(tlv::Setting::DeadZone, static_cast<uint8_t>(rssiDeadZone));
+        writer.putF32(tlv::Setting::Cooldown, proximityCooldown);
+        writer.putU8(tlv::Setting::ProximityKey, autoLocking ? 1 : 0);
+
+        uint8_t filter[proximity::FILTER_CONFIG_LENGTH];
+        size_t filterLength = proximity::encodeFilterConfig(proximity::filterConfig(), filter);
+        writer.putBytes(tlv::Setting::RssiFilter, filter, filterLength);
+
+        sendToClient(Esp32Response::SETTINGS, data, writer.length());
+    }
+
+    void clearCalibration()
+    {
+        rangeCalibration.cancel();
+        if (rangeCalibrated)
+        {
+            // Until the app sends RSSI_TRIGGER again (it does on every connect)
+            rangeCalibrated = false;
+            triggerRssiStrength = 0;
+            releaseRssiStrength = 0;
+            writeCalibration(NAN, NAN);
+        }
+        LOG_INFO(CALIBRATION_CLEARED);
+        sendToClient(Esp32Response::CALIBRATION);
+    }
+
+    void finishCalibration()
+    {
+        proximity::CalibrationResult result;
+        if (!rangeCalibration.finish(result))
+        {
+            LOG_WARN(CALIBRATION_FAILED, result.readings);
+            if (deviceConnected)
+                sendToClient(Esp32Response::CALIBRATION);
+            return;
+        }
+
+        rangeCalibrated = true;
+        triggerRssiStrength = result.trigger;
+        releaseRssiStrength = result.release;
+        configureProximityZones();
+        writeCalibration(result.trigger, result.release);
+        LOG_INFO(CALIBRATION_DONE, result.readings, result.trigger, result.release);
+
+        if (deviceConnected)
+        {
+            uint8_t data[proximity::CALIBRATION_RESULT_LENGTH];
+            size_t length = proximity::encodeCalibrationResult(result, data);
+            sendToClient(Esp32Response::CALIBRATION, data, length);
+        }
+    }
+}
+
+void reportLocked(bool locked)
+{
+    if (!transition(vehicle::Device::Doors, locked, vehicle::Source::Report).accepted())
+        return;
+
+    if (deviceConnected)
+        sendToClient(locked ? Esp32Response::LOCKED : Esp32Response::UNLOCKED);
+    if (locked)
+        LOG_INFO(LOCKED, false);
+    else
+        LOG_INFO(UNLOCKED, false);
+}
+
+void reportEngine(bool on)
+{
+    if (!transition(vehicle::Device::Engine, on, vehicle::Source::Report).accepted())
+        return;
+
+    if (deviceConnected)
+        sendToClient(on ? Esp32Response::ENGINE_STARTED : Esp32Response::ENGINE_STOPPED);
+    if (on)
+        LOG_INFO(ENGINE_STARTED);
+    else
+        LOG_INFO(ENGINE_STOPPED);
+}
+
+void reportWindows(bool open)
+{
+    if (!transition(vehicle::Device::Windows, open, vehicle::Source::Report).accepted())
+        return;
+
+    if (deviceConnected)
+        sendToClient(open ? Esp32Response::WINDOWS_OPENED : Esp32Response::WINDOWS_CLOSED);
+    if (open)
+        LOG_INFO(WINDOWS_OPENED);
+    else
+        LOG_INFO(WINDOWS_CLOSED);
+}
+
+void reportDoorOpened()
+{
+    portENTER_CRITICAL(&vehicleMux);
+    bool cancelled = timerTable.cancel(timers::Kind::Relock);
+    portEXIT_CRITICAL(&vehicleMux);
+    if (cancelled)
+        timersChanged();
+}
+
+// Answers reads of the state characteristic with STATE, or with an empty value
+// before the client authenticated
+class StateCallbacks : public BLECharacteristicCallbacks
+{
+    void onRead(BLECharacteristic *pCharacteristic)
+    {
+        xSemaphoreTake(notifyMutex, portMAX_DELAY);
+        if (!authenticated)
+        {
+            pCharacteristic->setValue(std::string());
+        }
+        else
+        {
+            uint8_t data[1 + 1 + state::STATE_LENGTH] = {static_cast<uint8_t>(Esp32Response::STATE), state::STATE_LENGTH};
+            encodeState(data + 2);
+            pCharacteristic->setValue(data, sizeof(data));
+        }
+        xSemaphoreGive(notifyMutex);
+    }
+};
+
+class MyServerCallbacks : public BLEServerCallbacks
+{
+    void onConnect(BLEServer * /* pServer */, esp_ble_gatts_cb_param_t *param)
+    {
+        LOG_INFO(CONNECTED);
+        memcpy(peerAddress, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+        deviceConnected = true;
+        authenticated = false;
+        stats::countConnection();
+        telemetry::traceEvent(telemetry::TraceEvent::Connected);
+        if (!presenceFresh())
+            proximity::activeFilter().reset(); // Readings of the last connection are stale
+        rssiFusion.reset();
+        resetProximity();
+
+        // Request low-power connection parameters, but delayed (see bluetoothLoop).
+        connParamUpdateAt = millis() + 5000;
+        connParamsPending = true;
+
+        if (onConnected)
+            onConnected();
+    };
+
+    void onDisconnect(BLEServer * /* pServer */)
+    {
+        LOG_INFO(DISCONNECTED);
+        deviceConnected = false;
+        authenticated = false;
+        // The stack keeps a CCCD across connections, the next client subscribes itself
+        pStateCccd->setNotifications(false);
+        pStreamCccd->setNotifications(false);
+        telemetry::traceEvent(telemetry::TraceEvent::Disconnected);
+        // Cancel any pending conn-param update so it can't fire against a new peer.
+        connParamsPending = false;
+        rangeCalibration.cancel();
+        stopRssiStream();
+        if (autoLocking) // Only true if disconnected before auto locking
+        {
+            // Possible edge case when proximity key is set to connection range and it connects, unlocks, but then looses connection.
+            // Locking right away here, without dwell time or cooldown, to avoid the car being unlocked for too long
+            lock(vehicle::Source::AutoLock);
+        }
+        // Watch for the phone coming back (PRESENCE_SCAN)
+        presenceWanted = autoLocking;
+        presenceSeen = false;
+        autoLocking = false;
+
+        if (onDisconnected)
+            onDisconnected();
+    }
+};
+
+void writeCounter(uint32_t count)
+{
+    File file = SPIFFS.open("/counter", "w"); // Using SPIFFS to avoid wearing flash sinc it has way more sectores
+    file.print(count);
+    file.close();
+}
+
+uint32_t readCounter()
+{
+    File file = SPIFFS.open("/counter", "r");
+    uint32_t count = file.parseInt();
+    file.close();
+    return count;
+}
+
+void writeCalibration(float trigger, float release)
+{
+    if (isnan(trigger))
+    {
+        SPIFFS.remove("/calibration");
+        return;
+    }
+
+    const float values[] = {trigger, release};
+    File file = SPIFFS.open("/calibration", "w");
+    file.write(reinterpret_cast<const uint8_t *>(values), sizeof(values));
+    file.close();
+}
+
+bool readCalibration(float &trigger, float &release)
+{
+    if (!SPIFFS.exists("/calibration"))
+        return false;
+
+    float values[2];
+    File file = SPIFFS.open("/calibration", "r");
+    size_t length = file.read(reinterpret_cast<uint8_t *>(values), sizeof(values));
+    file.close();
+    if (length != sizeof(values))
+        return false;
+
+    trigger = values[0];
+    release = values[1];
+    return true;
+}
+
+void writeTimers(const uint8_t *data, size_t length)
+{
+    if (length == 0)
+    {
+        if (SPIFFS.exists("/timers"))
+            SPIFFS.remove("/timers");
+        return;
+    }
+
+    File file = SPIFFS.open("/timers", "w");
+    file.write(data, length);
+    file.close();
+}
+
+size_t readTimers(uint8_t *data, size_t capacity)
+{
+    if (!SPIFFS.exists("/timers"))
+        return 0;
+
+    File file = SPIFFS.open("/timers", "r");
+    size_t length = file.read(data, capacity);
+    file.close();
+    return length;
+}
+
+// Generate HMAC-SHA256 for a counter and 1-byte command (and its data, if signed)
+void generateHMAC(uint32_t counter, uint8_t command, uint8_t *hmac, const uint8_t *data, size_t length)
+{
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1); // 1 = HMAC
+    mbedtls_md_hmac_starts(&ctx, sharedSecret, 32);
+    mbedtls_md_hmac_update(&ctx, (const uint8_t *)&counter, sizeof(counter));
+    mbedtls_md_hmac_update(&ctx, &command, 1);
+    if (data != nullptr && length > 0)
+        mbedtls_md_hmac_update(&ctx, data, length);
+    mbedtls_md_hmac_finish(&ctx, hmac);
+    mbedtls_md_free(&ctx);
+}
+
+// Verify HMAC-SHA256 for a counter and 1-byte command (and its data, if signed)
+bool verifyHMAC(uint32_t counter, uint8_t command, const uint8_t *received_hmac, const uint8_t *data, size_t length)
+{
+    uint8_t expected_hmac[32];
+    generateHMAC(counter, command, expected_hmac, data, length);
+    return memcmp(received_hmac, expected_hmac, 32) == 0;
+}
+
+namespace
+{
+    // Also the status of COMMAND_DONE
+    enum class CommandCheck : uint8_t
+    {
+        Runs,
+        Unknown,        // Also commands of features the vehicle doesn't support
+        InvalidPayload,
+    };
+
+    CommandCheck checkCommand(uint8_t commandByte, uint8_t length);
+    void runCommand(uint8_t commandByte, const frame::Payload &payload);
+
+    // Command handlers (see schema.h), only called with additional data of a
+    // length the schema allows for the command. The payload points into the
+    // characteristic value, so it has to be read before anything is sent
+    void handleGetVersion(const frame::Payload & /* payload */)
+    {
+        sendToClientString(Esp32Response::VERSION, PROTOCOL_VERSION.c_str());
+    }
+
+    void handleGetData(const frame::Payload & /* payload */)
+    {
+        // One notification per state the vehicle actually supports, with a
+        // small gap so they don't get sent faster than the client can be
+        // notified. States for unsupported features are not reported at all,
+        // so the app doesn't show a state for a button it never renders.
+        sendToClient(isLocked ? Esp32Response::LOCKED : Esp32Response::UNLOCKED);
+        if (hasFeature(SUPPORTED_FEATURES, Feature::Engine))
+        {
+            delay(20);
+            sendToClient(engineOn ? Esp32Response::ENGINE_STARTED : Esp32Response::ENGINE_STOPPED);
+        }
+        if (hasFeature(SUPPORTED_FEATURES, Feature::Windows))
+        {
+            delay(20);
+            sendToClient(windowsOpen ? Esp32Response::WINDOWS_OPENED : Esp32Response::WINDOWS_CLOSED);
+        }
+    }
+
+    void handleLockDoors(const frame::Payload & /* payload */)
+    {
+        lock();
+    }
+
+    void handleUnlockDoors(const frame::Payload & /* payload */)
+    {
+        unlock();
+    }
+
+    void handleOpenTrunk(const frame::Payload & /* payload */)
+    {
+        openTrunk();
+    }
+
+    void handleStartEngine(const frame::Payload & /* payload */)
+    {
+        startEngine();
+    }
+
+    void handleStopEngine(const frame::Payload & /* payload */)
+    {
+        stopEngine();
+    }
+
+    void handleProximityKeyOn(const frame::Payload & /* payload */)
+    {
+        enableProxKey();
+    }
+
+    void handleProximityKeyOff(const frame::Payload & /* payload */)
+    {
+        disableProxKey();
+    }
+
+    void handleProximityCooldown(const frame::Payload &payload)
+    {
+        setProximityCooldown(payload.f32(0));
+    }
+
+    void handleRssiTrigger(const frame::Payload &payload)
+    {
+        setRssiTrigger(payload.f32(0), payload.f32(4));
+    }
+
+    void handleGetRssi(const frame::Payload & /* payload */)
+    {
+        sendRssi = true;
+        rssiRequestId = deferAnswer();
+    }
+
+    void handleGetFeatures(const frame::Payload & /* payload */)
+    {
+        uint32_t featuresValue = static_cast<uint32_t>(SUPPORTED_FEATURES);
+        sendToClient(Esp32Response::FEATURES, reinterpret_cast<const uint8_t *>(&featuresValue), sizeof(featuresValue));
+    }
+
+    void handleStateSince(const frame::Payload &payload)
+    {
+        uint8_t data[state::DELTA_LENGTH];
+        state::encodeDelta(stateJournal.since(payload.u32(0), state::supportedBits(SUPPORTED_FEATURES)), data);
+        sendToClient(Esp32Response::STATE_DELTA, data, sizeof(data));
+    }
+
+    void handleUnlockFor(const frame::Payload &payload)
+    {
+        uint16_t seconds = payload.u16(0);
+        if (seconds == 0)
+        {
+            portENTER_CRITICAL(&vehicleMux);
+            bool cancelled = timerTable.cancel(timers::Kind::Relock);
+            portEXIT_CRITICAL(&vehicleMux);
+            if (cancelled)
+                timersChanged();
+            sendDeviceState(vehicle::Device::Doors);
+            return;
+        }
+
+        if (!timerAvailable(ClientCommand::UNLOCK_FOR, timers::Kind::Relock, seconds))
+            return;
+        unlock();
+        setTimer(ClientCommand::LOCK_DOORS, timers::Kind::Relock, seconds);
+    }
+
+    void handleStartEngineFor(const frame::Payload &payload)
+    {
+        uint16_t seconds = payload.u16(0);
+        if (seconds == 0 || seconds > ENGINE_MAX_RUNTIME)
+            seconds = ENGINE_MAX_RUNTIME;
+
+        if (!timerAvailable(ClientCommand::START_ENGINE_FOR, timers::Kind::Shutoff, seconds))
+            return;
+        startEngine();
+        setTimer(ClientCommand::STOP_ENGINE, timers::Kind::Shutoff, seconds);
+    }
+
+    void handleSchedule(const frame::Payload &payload)
+    {
+        if (!payload.empty())
+        {
+            uint8_t command = payload.u8(0);
+            uint32_t seconds = payload.u32(1);
+            // The app tells a refused schedule from a set one by the answer
+            if (!schedulable(command) || seconds > timers::MAX_DELAY_SECONDS)
+            {
+                rejectTimer(ClientCommand::SCHEDULE, command, seconds);
+                return;
+            }
+            if (seconds == 0)
+            {
+                portENTER_CRITICAL(&vehicleMux);
+                bool cancelled = timerTable.cancelScheduled(command);
+                portEXIT_CRITICAL(&vehicleMux);
+                if (cancelled)
+                    timersChanged();
+            }
+            else if (!timerAvailable(ClientCommand::SCHEDULE, timers::Kind::Scheduled, seconds) ||
+                     !setTimer(static_cast<ClientCommand>(command), timers::Kind::Scheduled, seconds))
+            {
+                return;
+            }
+        }
+        sendSchedule();
+    }
+
+    void handleGetLimits(const frame::Payload & /* payload */)
+    {
+        const uint8_t limits[] = {COMMAND_CREDITS, frame::MAX_PAYLOAD_LENGTH, MAX_RESPONSE_DATA_LENGTH};
+        sendToClient(Esp32Response::LIMITS, limits, sizeof(limits));
+    }
+
+    void handleOpenWindows(const frame::Payload & /* payload */)
+    {
+        openWindows();
+    }
+
+    void handleCloseWindows(const frame::Payload & /* payload */)
+    {
+        closeWindows();
+    }
+
+    void handleGetStats(const frame::Payload & /* payload */)
+    {
+        stats::startReport();
+        startReport(Esp32Response::STATS, stats::nextRecord);
+    }
+
+    void handleGetMemory(const frame::Payload & /* payload */)
+    {
+        // Sampled by the first record on the loop task, not here on the BTC task
+        telemetry::startMemoryReport();
+        startReport(Esp32Response::MEMORY, telemetry::nextMemoryRecord);
+    }
 
-        if (DEBUG_MODE)
-            Serial.println("Windows closed");
+    void handleRssiFilter(const frame::Payload &payload)
+    {
+        // Without data the active filter is only reported
+        proximity::FilterConfig config;
+        if (!payload.empty())
+        {
+            if (!proximity::decodeFilterConfig(payload.data(), payload.length(), config))
+            {
+                LOG_WARN(MISSING_DATA, ClientCommand::RSSI_FILTER);
+            }
+            else if (proximity::configureFilter(config))
+            {
+                LOG_INFO(RSSI_FILTER_SET, config.type, config.first, config.second);
+            }
+            else
+            {
+                LOG_WARN(RSSI_FILTER_INVALID, config.type, config.first, config.second);
+            }
+        }
+        sendFilterConfig();
     }
 
-    void enableProxKey()
+    void handleCalibrate(const frame::Payload &payload)
     {
-        autoLocking = true;
+        float seconds = payload.f32(0);
+        if (!(seconds > 0))
+        {
+            clearCalibration();
+            return;
+        }
+        if (seconds > maxCalibrationSeconds)
+            seconds = maxCalibrationSeconds;
+
+        rangeCalibration.start(seconds * 1000, millis());
+        LOG_INFO(CALIBRATION_STARTED, seconds);
     }
 
-    void disableProxKey()
+    void handleGetTrace(const frame::Payload & /* payload */)
     {
-        autoLocking = false;
+        telemetry::startTraceReport();
+        startReport(Esp32Response::TRACE, telemetry::nextTraceRecord);
     }
 
-    float calculateReleaseRssi(int triggerRssiStrength, float pathLossExponent = 3.0, float reduction = 5.0)
+    void handlePhoneRssi(const frame::Payload &payload)
     {
-        float deltaRssi = -10 * pathLossExponent * log10((reduction + 1) / 1);
-        return triggerRssiStrength + deltaRssi;
+        proximity::PhoneSample samples[proximity::MAX_PHONE_SAMPLES];
+        size_t count = proximity::decodePhoneSamples(payload.data(), payload.length(), millis(), samples);
+        for (size_t i = 0; i < count; i++)
+        {
+            telemetry::traceEvent(telemetry::TraceEvent::PhoneRssi, samples[i].rssi);
+            rssiFusion.addPhone(samples[i].rssi, samples[i].millis);
+        }
+        LOG_DEBUG(PHONE_RSSI_RECEIVED, count, rssiFusion.phoneWeight(), rssiFusion.offset());
     }
-}
 
-class MyServerCallbacks : public BLEServerCallbacks
-{
-    void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+    void handleRssiStream(const frame::Payload &payload)
     {
-        if (DEBUG_MODE)
-            Serial.println("Connected");
-        memcpy(peerAddress, param->connect.remote_bda, sizeof(esp_bd_addr_t));
-        deviceConnected = true;
+        uint16_t interval = payload.u16(0);
+        if (interval == 0)
+        {
+            stopRssiStream();
+            return;
+        }
+        if (interval < RSSI_INTERVAL_MIN)
+            interval = RSSI_INTERVAL_MIN;
+        if (interval > stream::RSSI_STREAM_MAX_INTERVAL)
+            interval = stream::RSSI_STREAM_MAX_INTERVAL;
 
-        // Request low-power connection parameters, but delayed (see bluetoothLoop).
-        connParamUpdateAt = millis() + 5000;
-        connParamsPending = true;
+        uint16_t seconds = payload.u16(2);
+        if (seconds == 0 || seconds > stream::RSSI_STREAM_MAX_SECONDS)
+            seconds = stream::RSSI_STREAM_MAX_SECONDS;
 
-        if (onConnected)
-            onConnected();
-    };
+        // A new subscription replaces the running one (renewing it)
+        if (rssiStreamInterval != interval)
+        {
+            if (!rssiBatch.empty())
+                sendRssiBatch();
+            rssiBatch.start(interval);
+        }
+        rssiStreamInterval = interval;
+        rssiStreamUntil = millis() + seconds * 1000UL;
+        LOG_INFO(RSSI_STREAM_STARTED, interval, seconds);
+    }
 
-    void onDisconnect(BLEServer *pServer)
+    void handleSettings(const frame::Payload &payload)
     {
-        if (DEBUG_MODE)
-            Serial.println("Disconnected");
-        deviceConnected = false;
-        // Cancel any pending conn-param update so it can't fire against a new peer.
-        connParamsPending = false;
-        if (autoLocking && !isLocked) // Only true if disconnected before auto locking
+        // Without data the settings are only reported
+        tlv::Reader reader(payload.data(), payload.length());
+        if (!payload.empty() && !reader.valid())
         {
-            // Possible edge case when proximity key is set to connection range and it connects, unlocks, but then looses connection
-            // so it would auto lock, but now it would take the cooldown time to unlock again
-            lock(true, true); // Ignoring cooldown here to avoid car being unlocked for too long
+            LOG_WARN(SETTINGS_INVALID, reader.version());
+            sendSettings();
+            return;
         }
-        autoLocking = false;
 
-        if (onDisconnected)
-            onDisconnected();
+        // Trigger and dead zone are set together, and both before the proximity
+        // key is turned on (like the separate commands the app sends)
+        float trigger = triggerRssiStrength;
+        int deadZone = rssiDeadZone;
+        bool triggerChanged = false;
+        int proximityKey = -1;
+        uint8_t applied = 0;
+        uint8_t skipped = 0;
+        tlv::Field field;
+        while (reader.next(field))
+        {
+            const frame::Payload &value = field.value;
+            bool used = true;
+            switch (static_cast<tlv::Setting>(field.tag))
+            {
+            case tlv::Setting::TriggerRssi:
+                if ((used = value.length() == 4))
+                {
+                    trigger = value.f32(0);
+                    triggerChanged = true;
+                }
+                break;
+            case tlv::Setting::DeadZone:
+                if ((used = value.length() == 1))
+                {
+                    deadZone = value.u8(0);
+                    triggerChanged = true;
+                }
+                break;
+            case tlv::Setting::Cooldown:
+                if ((used = value.length() == 4))
+                    setProximityCooldown(value.f32(0));
+                break;
+            case tlv::Setting::ProximityKey:
+                if ((used = value.length() == 1))
+                    proximityKey = value.u8(0) != 0 ? 1 : 0;
+                break;
+            case tlv::Setting::RssiFilter:
+            {
+                proximity::FilterConfig config;
+                if ((used = value.length() == proximity::FILTER_CONFIG_LENGTH &&
+                            proximity::decodeFilterConfig(value.data(), value.length(), config) &&
+                            proximity::configureFilter(config)))
+                    LOG_INFO(RSSI_FILTER_SET, config.type, config.first, config.second);
+                break;
+            }
+            default:
+                // Newer setting, or one that is only reported
+                used = false;
+                break;
+            }
+            if (used)
+                applied++;
+            else
+                skipped++;
+        }
+        if (triggerChanged)
+            setRssiTrigger(trigger, deadZone);
+        if (proximityKey == 1)
+            enableProxKey();
+        else if (proximityKey == 0)
+            disableProxKey();
+
+        LOG_INFO(SETTINGS_APPLIED, applied, skipped + (reader.truncated() ? 1 : 0));
+        sendSettings();
     }
-};
 
-void writeCounter(uint32_t count)
-{
-    File file = SPIFFS.open("/counter", "w"); // Using SPIFFS to avoid wearing flash sinc it has way more sectores
-    file.print(count);
-    file.close();
-}
+    // Status byte of BATCH_RESULT
+    enum class BatchStatus : uint8_t
+    {
+        Done,
+        Malformed,
+        Unsupported,
+        InvalidPayload,
+        Nested,
+    };
 
-uint32_t readCounter()
-{
-    File file = SPIFFS.open("/counter", "r");
-    uint32_t count = file.parseInt();
-    file.close();
-    return count;
-}
+    void sendBatchResult(BatchStatus status, uint8_t index)
+    {
+        const uint8_t data[] = {static_cast<uint8_t>(status), index};
+        sendToClient(Esp32Response::BATCH_RESULT, data, sizeof(data));
+    }
 
-// Generate HMAC-SHA256 for a counter and 1-byte command
-void generateHMAC(uint32_t counter, uint8_t command, uint8_t *hmac)
-{
-    mbedtls_md_context_t ctx;
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1); // 1 = HMAC
-    mbedtls_md_hmac_starts(&ctx, sharedSecret, 32);
-    mbedtls_md_hmac_update(&ctx, (const uint8_t *)&counter, sizeof(counter));
-    mbedtls_md_hmac_update(&ctx, &command, 1);
-    mbedtls_md_hmac_finish(&ctx, hmac);
-    mbedtls_md_free(&ctx);
-}
+    void handleBatch(const frame::Payload &payload)
+    {
+        // The answers of the commands overwrite the characteristic value the
+        // payload points into
+        uint8_t data[frame::MAX_PAYLOAD_LENGTH];
+        memcpy(data, payload.data(), payload.length());
+
+        // All commands are checked before the first one runs
+        tlv::Reader reader(data, payload.length());
+        tlv::Field field;
+        uint8_t count = 0;
+        BatchStatus status = reader.valid() ? BatchStatus::Done : BatchStatus::Malformed;
+        while (status == BatchStatus::Done && reader.next(field))
+        {
+            if (field.tag == static_cast<uint8_t>(ClientCommand::BATCH))
+            {
+                status = BatchStatus::Nested;
+                break;
+            }
+            switch (checkCommand(field.tag, field.value.length()))
+            {
+            case CommandCheck::Runs:
+                count++;
+                break;
+            case CommandCheck::Unknown:
+                status = BatchStatus::Unsupported;
+                break;
+            case CommandCheck::InvalidPayload:
+                status = BatchStatus::InvalidPayload;
+                break;
+            }
+        }
+        if (status == BatchStatus::Done && (reader.truncated() || count == 0))
+            status = BatchStatus::Malformed;
+        if (status != BatchStatus::Done)
+        {
+            LOG_WARN(BATCH_REJECTED, count, status);
+            sendBatchResult(status, count);
+            return;
+        }
 
-// Verify HMAC-SHA256 for a counter and 1-byte command
-bool verifyHMAC(uint32_t counter, uint8_t command, const uint8_t *received_hmac)
-{
-    uint8_t expected_hmac[32];
-    generateHMAC(counter, command, expected_hmac);
-    return memcmp(received_hmac, expected_hmac, 32) == 0;
-}
+        tlv::Reader commands(data, payload.length());
+        for (uint8_t i = 0; i < count && commands.next(field); i++)
+        {
+            // Answers are spaced like the messages of GET_DATA
+            if (i > 0)
+                delay(20);
+            runCommand(field.tag, field.value);
+        }
+        LOG_INFO(BATCH_DONE, count);
+        delay(20);
+        sendBatchResult(BatchStatus::Done, count);
+    }
 
-float parseFloat(const uint8_t *data)
-{
-    if (data == nullptr)
-        return 0.0f;
-    float value;
-    memcpy(&value, data, sizeof(float));
-    return value;
-}
+    typedef void (*CommandHandler)(const frame::Payload &payload);
 
-int32_t parseInt32(const uint8_t *data)
-{
-    if (data == nullptr)
-        return 0;
-    int32_t value;
-    memcpy(&value, data, sizeof(int32_t));
-    return value;
-}
+    // Indexed by the command byte, like COMMANDS in commands.h. Commands needing
+    // a feature that isn't in `features` have no handler, so nothing references
+    // their handler, and whatever only it reaches (callbacks, responses, state)
+    // is left out of the firmware.
+    template <Feature features>
+    struct CommandHandlers
+    {
+        static constexpr CommandHandler table[] = {
+#define COMMAND(name, id, min, max, step, feature, response, handler, doc) \
+    hasFeature(features, Feature::feature) ? handler : nullptr,
+#include "schema.h"
+#undef COMMAND
+        };
+        static_assert(sizeof(table) / sizeof(table[0]) == COMMAND_COUNT, "One handler per command");
+    };
 
-int16_t parseInt16(const uint8_t *data)
-{
-    if (data == nullptr)
-        return 0;
-    int16_t value;
-    memcpy(&value, data, sizeof(int16_t));
-    return value;
-}
+    template <Feature features>
+    constexpr CommandHandler CommandHandlers<features>::table[];
 
-uint8_t parseUint8(const uint8_t *data)
-{
-    if (data == nullptr)
-        return 0;
-    return data[0];
-}
+    typedef CommandHandlers<SUPPORTED_FEATURES> Dispatch;
 
-std::string parseString(const uint8_t *data, uint8_t length)
-{
-    if (data == nullptr || length == 0)
-        return "";
-    return std::string(reinterpret_cast<const char *>(data), length);
-}
+    // Whether a command can run with additional data of `length`, logs why not
+    CommandCheck checkCommand(uint8_t commandByte, uint8_t length)
+    {
+        ClientCommand command = static_cast<ClientCommand>(commandByte);
+        const CommandInfo *info = commandInfo(command);
+        if (info == nullptr)
+        {
+            LOG_WARN(UNKNOWN_COMMAND, commandByte);
+            return CommandCheck::Unknown;
+        }
+        if (Dispatch::table[commandByte] == nullptr)
+        {
+            LOG_WARN(COMMAND_UNSUPPORTED, command);
+            return CommandCheck::Unknown;
+        }
+        if (!validPayloadLength(*info, length))
+        {
+            LOG_WARN(INVALID_PAYLOAD, command, length);
+            return CommandCheck::InvalidPayload;
+        }
+        return CommandCheck::Runs;
+    }
 
-// Parse multiple floats (e.g., GPS coordinates)
-void parseFloats(const uint8_t *data, float *output, size_t count)
-{
-    if (data == nullptr || output == nullptr)
-        return;
-    for (size_t i = 0; i < count; i++)
+    void runCommand(uint8_t commandByte, const frame::Payload &payload)
     {
-        memcpy(&output[i], data + (i * sizeof(float)), sizeof(float));
+        Dispatch::table[commandByte](payload);
     }
 }
 
@@ -384,48 +1539,34 @@ class MyCallbacks : public BLECharacteristicCallbacks
 {
     void onWrite(BLECharacteristic *pCharacteristic)
     {
-        std::string value = pCharacteristic->getValue();
-        size_t length = value.length();
-
-        if (length == 0)
+        uint32_t receivedAt = micros();
+        // Read in place, getValue() would copy the frame into a new string
+        size_t length = pCharacteristic->getLength();
+        frame::FrameView view;
+        switch (frame::FrameView::parse(pCharacteristic->getData(), length, view))
         {
-            if (DEBUG_MODE)
-                Serial.println("Received empty value.");
+        case frame::FrameError::None:
+            break;
+        case frame::FrameError::Empty:
+            LOG_DEBUG(EMPTY_VALUE);
             return;
-        }
-
-        if (length < 33)
-        { // Minimum for HMAC + Command
-            Serial.println("Received malformed client command: too short.");
+        case frame::FrameError::TooShort:
+            LOG_WARN(FRAME_TOO_SHORT, length);
+            stats::countInvalidHmac();
             sendToClient(Esp32Response::INVALID_HMAC);
             return;
+        case frame::FrameError::LengthMismatch:
+            LOG_WARN(FRAME_LENGTH_MISMATCH, pCharacteristic->getData()[frame::HEADER_LENGTH]);
+            return;
         }
 
-        uint8_t receivedHmac[32];
-        memcpy(receivedHmac, value.data(), 32);
-
-        uint8_t commandByte[1];
-        memcpy(commandByte, value.data() + 32, 1);
-        ClientCommand command = static_cast<ClientCommand>(commandByte[0]);
-
-        uint8_t additionalLength = 0;
-        const uint8_t *additionalDataPtr = nullptr;
-
-        if (length > 33)
-        {
-            additionalLength = value.data()[33];
-
-            // Verify we have enough data
-            if (length >= 34 + additionalLength)
-            {
-                additionalDataPtr = reinterpret_cast<const uint8_t *>(value.data() + 34);
-            }
-            else
-            {
-                Serial.println("Malformed data: advertised length exceeds actual data.");
-                return;
-            }
-        }
+        uint8_t commandByte = view.command();
+        ClientCommand command = static_cast<ClientCommand>(commandByte);
+        const frame::Payload &payload = view.payload();
+        const frame::Payload signedData = signsPayload(command) ? payload : frame::Payload();
+        requestId = view.requestId();
+        requestTask = xTaskGetCurrentTaskHandle();
+        requestAnswered = false;
 
         // Verify HMAC with a window of counters to handle small desyncs. The
         // client can skip counters (a BLE write that fails locally may or may
@@ -435,129 +1576,43 @@ class MyCallbacks : public BLECharacteristicCallbacks
         bool valid = false;
         for (uint32_t i = 0; i < COUNTER_WINDOW; i++)
         {
-            if (verifyHMAC(counter + i, commandByte[0], receivedHmac))
+            if (verifyHMAC(counter + i, commandByte, view.hmac(), signedData.data(), signedData.length()))
             {
                 valid = true;
                 counter = counter + i + 1;
+                stats::commandVerified(commandByte, receivedAt);
                 writeCounter(counter);
+                stats::mark(stats::Stage::CounterPersisted);
                 break;
             }
         }
 
         if (!valid)
         {
-            if (DEBUG_MODE)
-                Serial.println("Received invalid HMAC. Tested counters: " + String(counter) + "-" + String(counter + COUNTER_WINDOW - 1));
+            LOG_WARN(INVALID_HMAC, counter, counter + COUNTER_WINDOW - 1);
+            stats::countInvalidHmac();
             sendToClient(Esp32Response::INVALID_HMAC);
+            requestId = frame::NO_REQUEST_ID;
             return;
         }
 
-        if (DEBUG_MODE)
-            Serial.printf("Received command: %s (0x%02X) with %d bytes of data\n",
-                          toString(command),
-                          static_cast<uint8_t>(command),
-                          additionalLength);
-
-        switch (command)
-        {
-        case ClientCommand::GET_VERSION:
-            sendToClientString(Esp32Response::VERSION, PROTOCOL_VERSION.c_str());
-            break;
-        case ClientCommand::GET_DATA:
-            // One notification per state the vehicle actually supports, with a
-            // small gap so they don't get sent faster than the client can be
-            // notified. States for unsupported features are not reported at all,
-            // so the app doesn't show a state for a button it never renders.
-            sendToClient(isLocked ? Esp32Response::LOCKED : Esp32Response::UNLOCKED);
-            if ((SUPPORTED_FEATURES & Feature::Engine) != Feature::None)
-            {
-                delay(20);
-                sendToClient(engineOn ? Esp32Response::ENGINE_STARTED : Esp32Response::ENGINE_STOPPED);
-            }
-            if ((SUPPORTED_FEATURES & Feature::Windows) != Feature::None)
-            {
-                delay(20);
-                sendToClient(windowsOpen ? Esp32Response::WINDOWS_OPENED : Esp32Response::WINDOWS_CLOSED);
-            }
-            break;
-        case ClientCommand::LOCK_DOORS:
-            lock();
-            break;
-        case ClientCommand::UNLOCK_DOORS:
-            unlock();
-            break;
-        case ClientCommand::OPEN_TRUNK:
-            openTrunk();
-            break;
-        case ClientCommand::START_ENGINE:
-            startEngine();
-            break;
-        case ClientCommand::STOP_ENGINE:
-            stopEngine();
-            break;
-        case ClientCommand::OPEN_WINDOWS:
-            openWindows();
-            break;
-        case ClientCommand::CLOSE_WINDOWS:
-            closeWindows();
-            break;
-        case ClientCommand::PROXIMITY_KEY_ON:
-            enableProxKey();
-            break;
-        case ClientCommand::PROXIMITY_KEY_OFF:
-            disableProxKey();
-            break;
-        case ClientCommand::RSSI_TRIGGER:
-        {
-            if (additionalLength == 0)
-            {
-                if (DEBUG_MODE)
-                    Serial.println("No RSSI trigger data");
-                return;
-            }
-
-            float additionalDataFloats[2];
-            parseFloats(additionalDataPtr, additionalDataFloats, 2);
-
-            triggerRssiStrength = additionalDataFloats[0];
-            rssiDeadZone = additionalDataFloats[1];
-
-            releaseRssiStrength = calculateReleaseRssi(triggerRssiStrength);
+        authenticated = true;
+        LOG_DEBUG(COMMAND_RECEIVED, command, command, payload.length());
 
-            if (DEBUG_MODE)
-            {
-                Serial.println("Trigger RSSI set: " + String(triggerRssiStrength));
-                Serial.println("Release RSSI set: " + String(releaseRssiStrength));
-            }
-        }
-        break;
-        case ClientCommand::GET_RSSI:
-            sendRssi = true;
-            break;
-        case ClientCommand::PROXIMITY_COOLDOWN:
-        {
-            if (additionalLength == 0)
-            {
-                if (DEBUG_MODE)
-                    Serial.println("No RSSI trigger data");
-                return;
-            }
+        CommandCheck check = checkCommand(commandByte, payload.length());
+        if (check == CommandCheck::Runs)
+            runCommand(commandByte, payload);
 
-            proximityCooldown = parseFloat(additionalDataPtr);
-            if (DEBUG_MODE)
-                Serial.println("Proximity cooldown set: " + String(proximityCooldown));
-        }
-        break;
-        case ClientCommand::GET_FEATURES:
+        // A client waiting for the request ID learns that the command is done
+        // (or why it didn't run) even if it isn't answered
+        if (requestId != frame::NO_REQUEST_ID && !requestAnswered)
         {
-            uint32_t featuresValue = static_cast<uint32_t>(SUPPORTED_FEATURES);
-            sendToClient(Esp32Response::FEATURES, reinterpret_cast<const uint8_t *>(&featuresValue), sizeof(featuresValue));
+            const uint8_t status = static_cast<uint8_t>(check);
+            sendToClient(Esp32Response::COMMAND_DONE, &status, sizeof(status));
         }
-        break;
+        requestId = frame::NO_REQUEST_ID;
 
-        default:
-            break;
-        }
+        stats::commandCompleted();
     }
 };
 
@@ -567,46 +1622,97 @@ void gapCallback(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
     if (event == ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT)
     {
         int rawRSSI = param->read_rssi_cmpl.rssi;
-
-        rssiBuffer[rssiIndex] = rawRSSI;
-        rssiIndex = (rssiIndex + 1) % RSSI_SAMPLES;
-
-        if (rssiIndex == 0)
-            bufferFilled = true;
-
-        int sum = 0;
-        int count = bufferFilled ? RSSI_SAMPLES : rssiIndex;
-        for (int i = 0; i < count; i++)
-        {
-            sum += rssiBuffer[i];
-        }
-        float avgRSSI = (float)sum / count;
+        telemetry::traceRssi(rawRSSI);
+        float avgRSSI = proximity::activeFilter().update(rawRSSI);
+        rangeCalibration.add(rawRSSI); // Ignored unless calibrating
 
         if (sendRssi)
         {
-            sendToClientFloat(Esp32Response::RSSI, avgRSSI);
+            sendResponse(Esp32Response::RSSI, reinterpret_cast<const uint8_t *>(&avgRSSI), sizeof(avgRSSI), rssiRequestId);
             sendRssi = false;
+            rssiRequestId = frame::NO_REQUEST_ID;
         }
+        if (rssiStreamInterval != 0)
+            streamRssi(avgRSSI);
 
         if (!autoLocking || triggerRssiStrength == 0)
         {
             return;
         }
 
-        if (avgRSSI < releaseRssiStrength)
-        {
-            if (!isLocked)
-            {
-                lock(true);
-            }
-        }
-        else if (avgRSSI > triggerRssiStrength)
+        unsigned long currentMillis = millis();
+        avgRSSI = rssiFusion.fuse(rawRSSI, avgRSSI, currentMillis); // The filtered reading without fresh phone samples
+        proximityTrend.add(avgRSSI, currentMillis);
+
+        proximity::Zone zone = proximityZones.zone();
+        float decisionRssi = proximity::anticipatedRssi(proximityTrend, avgRSSI, zone, PROXIMITY_PREDICT_AHEAD);
+        proximity::Action action = proximityZones.update(decisionRssi, currentMillis);
+        if (proximityZones.zone() != zone)
         {
-            if (isLocked)
-            {
-                unlock(true);
-            }
+            zone = proximityZones.zone();
+            LOG_DEBUG(PROXIMITY_ZONE, zone, avgRSSI);
+            telemetry::traceEvent(telemetry::TraceEvent::Zone, static_cast<int8_t>(zone));
         }
+        updateApproach(zone);
+
+        // Poll faster close to the threshold that decides next
+        bool near = zone == proximity::Zone::Near || zone == proximity::Zone::Leaving;
+        bool deciding = approachArmed || zone == proximity::Zone::Approaching || zone == proximity::Zone::Leaving;
+        rssiInterval = rssiSampling.update(avgRSSI, currentMillis, near ? releaseRssiStrength : triggerRssiStrength, deciding);
+
+        // Only on zone changes, so a lock or unlock from the app holds while
+        // the phone stays where it is (and right after it, see vehicle.h)
+        if (action == proximity::Action::Lock)
+            lock(vehicle::Source::Proximity);
+        else if (action == proximity::Action::Unlock)
+            unlock(vehicle::Source::Proximity);
+    }
+}
+
+void presenceReading(int rssi)
+{
+    if (deviceConnected || !presenceWanted || triggerRssiStrength == 0)
+        return;
+
+    unsigned long currentMillis = millis();
+    telemetry::traceEvent(telemetry::TraceEvent::Presence, rssi);
+    if (!presenceFresh())
+    {
+        // First advertisement of this approach
+        proximity::activeFilter().reset();
+        proximityTrend.reset();
+        presenceZones.reset(!isLocked);
+        approachAnnounced = false;
+    }
+    presenceSeen = true;
+    lastPresenceMillis = currentMillis;
+
+    float avgRSSI = proximity::activeFilter().update(rssi);
+    proximityTrend.add(avgRSSI, currentMillis);
+
+    proximity::Zone zone = presenceZones.zone();
+    presenceZones.update(proximity::anticipatedRssi(proximityTrend, avgRSSI, zone, PROXIMITY_PREDICT_AHEAD), currentMillis);
+    if (presenceZones.zone() != zone)
+    {
+        zone = presenceZones.zone();
+        if (zone == proximity::Zone::Approaching)
+            presenceApproachMillis = currentMillis;
+        LOG_DEBUG(PRESENCE_ZONE, zone, avgRSSI);
+    }
+
+    // Nothing to speed up without a connection, but the actuator can get ready
+    bool approaching = zone == proximity::Zone::Approaching || zone == proximity::Zone::Near;
+    if (!approaching && zone == proximity::Zone::Far)
+    {
+        int32_t millisToTrigger = proximityTrend.millisUntil(triggerRssiStrength, proximity::PREARM_MIN_R_SQUARED);
+        approaching = millisToTrigger >= 0 && millisToTrigger <= PROXIMITY_PREARM_HORIZON;
+    }
+    if (isLocked && approaching && !approachAnnounced)
+    {
+        approachAnnounced = true;
+        LOG_INFO(PRESENCE_APPROACH, avgRSSI);
+        if (onApproaching)
+            onApproaching();
     }
 }
 
@@ -630,15 +1736,48 @@ std::string scrambleName(const std::string &name)
 
 void setupBluetooth()
 {
+    notifyMutex = xSemaphoreCreateMutex();
+
     if (SPIFFS.begin(true))
     {
         counter = readCounter();
+        rangeCalibrated = readCalibration(triggerRssiStrength, releaseRssiStrength);
     }
     else if (DEBUG_MODE)
     {
         Serial.println("SPIFFS Mount Failed");
     }
 
+    // Timers that were pending before the reboot: there is no telling how late
+    // they are now, so the ones that would open up the vehicle are dropped and
+    // the ones that secure it run with the first loop
+    uint8_t savedTimers[timers::MAX_TIMERS * timers::ENTRY_LENGTH];
+    timerTable.decode(savedTimers, readTimers(savedTimers, sizeof(savedTimers)), millis());
+    size_t savedCount = timerTable.count();
+    timerTable.cancelScheduled(static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS));
+    timerTable.cancelScheduled(static_cast<uint8_t>(ClientCommand::START_ENGINE));
+    timerTable.cancelScheduled(static_cast<uint8_t>(ClientCommand::OPEN_WINDOWS));
+    timerTable.expire(millis());
+    if (savedCount > 0)
+        LOG_INFO(TIMERS_RESTORED, timerTable.count(), savedCount - timerTable.count());
+    if (timerTable.count() != savedCount)
+        saveTimers();
+    // A pending relock or shutoff means the doors were unlocked or the engine
+    // ran. The state before the reboot is unknown, the boot default (locked,
+    // engine off, windows closed) would make every restored timer redundant;
+    // taking the opposite state makes them actuate when they run
+    if (timerTable.pending(timers::Kind::Relock) || restoredSchedule(ClientCommand::LOCK_DOORS))
+        isLocked = false;
+    if (timerTable.pending(timers::Kind::Shutoff) || restoredSchedule(ClientCommand::STOP_ENGINE))
+        engineOn = true;
+    if (restoredSchedule(ClientCommand::CLOSE_WINDOWS))
+        windowsOpen = true;
+
+    vehicleState.configure({VEHICLE_REPEAT_WINDOW, VEHICLE_MERGE_WINDOW});
+    vehicleState.reset(state::pack(isLocked, engineOn, windowsOpen));
+    // A random start, so versions a client saw before a reboot are unknown
+    stateJournal.reset(stateBits(), esp_random() & 0x7FFFFFFF);
+
     pinMode(bootButtonPin, INPUT_PULLUP);
 
     // Generate 32-byte HMAC key
@@ -673,9 +1812,24 @@ void setupBluetooth()
             BLECharacteristic::PROPERTY_WRITE |
             BLECharacteristic::PROPERTY_NOTIFY);
 
-    pCharacteristic->setCallbacks(new MyCallbacks());
+    pCommandCallbacks = new MyCallbacks();
+    pCharacteristic->setCallbacks(pCommandCallbacks);
     pCharacteristic->addDescriptor(new BLE2902());
 
+    pStateCharacteristic = pService->createCharacteristic(
+        STATE_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_READ |
+            BLECharacteristic::PROPERTY_NOTIFY);
+    pStateCharacteristic->setCallbacks(new StateCallbacks());
+    pStateCccd = new BLE2902();
+    pStateCharacteristic->addDescriptor(pStateCccd);
+
+    pStreamCharacteristic = pService->createCharacteristic(
+        STREAM_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_NOTIFY);
+    pStreamCccd = new BLE2902();
+    pStreamCharacteristic->addDescriptor(pStreamCccd);
+
     // Start the service
     pService->start();
 
@@ -689,15 +1843,27 @@ void setupBluetooth()
 
     // Register the GAP callback to receive RSSI results
     esp_ble_gap_register_callback(gapCallback);
+    rssiSampling.configure(RSSI_INTERVAL_MIN, RSSI_INTERVAL_MAX);
+    configureProximityZones();
+    if (PRESENCE_SCAN)
+        presence::setupPresence();
+
+    telemetry::onMemoryAlert = notifyMemoryAlert;
 }
 
 void readRssi()
 {
-    if (deviceConnected && (autoLocking || sendRssi))
+    bool streaming = rssiStreamInterval != 0;
+    if (deviceConnected && (autoLocking || sendRssi || streaming || rangeCalibration.active()))
     {
         unsigned long currentMillis = millis();
+        // GET_RSSI is answered with the next reading, so don't wait long for
+        // it, and calibrating takes as many readings as possible
+        unsigned long interval = sendRssi || rangeCalibration.active() ? RSSI_INTERVAL_MIN : rssiInterval;
+        if (streaming && (!autoLocking || rssiStreamInterval < interval))
+            interval = rssiStreamInterval;
 
-        if (currentMillis - previousRssiMillis >= rssiInterval)
+        if (currentMillis - previousRssiMillis >= interval)
         {
             previousRssiMillis = currentMillis;
 
@@ -706,21 +1872,45 @@ void readRssi()
     }
 }
 
+void sendReport()
+{
+    if (nextReportRecord == nullptr)
+        return;
+
+    if (!deviceConnected)
+    {
+        nextReportRecord = nullptr;
+        return;
+    }
+
+    unsigned long currentMillis = millis();
+    if (currentMillis - previousReportMillis < reportInterval)
+        return;
+    previousReportMillis = currentMillis;
+
+    uint8_t record[MAX_RESPONSE_DATA_LENGTH];
+    size_t length = nextReportRecord(record, reportRequestId != frame::NO_REQUEST_ID ? sizeof(record) - 1 : sizeof(record));
+    if (length == 0)
+    {
+        nextReportRecord = nullptr;
+        return;
+    }
+    sendStream(reportResponse, record, length, reportRequestId);
+}
+
 void readBootButton()
 {
     if (digitalRead(bootButtonPin) == LOW)
     {
         if (!isBootButtonPressed)
         {
-            if (DEBUG_MODE)
-                Serial.println("BOOT Pressed. hold for 5 seconds to reset rolling code counter");
+            LOG_INFO(BOOT_BUTTON_PRESSED);
             bootButtonPressStart = millis();
             isBootButtonPressed = true;
         }
         else if (millis() - bootButtonPressStart >= 3000)
         {
-            if (DEBUG_MODE)
-                Serial.println("Resseting rolling code counter");
+            LOG_WARN(COUNTER_RESET);
 
             counter = 0;
             writeCounter(counter);
@@ -736,15 +1926,24 @@ void readBootButton()
 void bluetoothLoop()
 {
     readRssi();
+    if (rangeCalibration.due(millis()))
+        finishCalibration();
     readBootButton();
+    sendReport();
+    runTimers();
+    telemetry::memoryLoop();
+    if (PRESENCE_SCAN)
+        presence::presenceLoop(!deviceConnected && presenceWanted);
+
+    if (DEBUG_MODE)
+        logging::printPending();
 
     if (deviceConnected && connParamsPending && millis() >= connParamUpdateAt)
     {
         connParamsPending = false;
         // 0xA0*1.25ms=200ms .. 0xC8*1.25ms=250ms, latency 1, timeout 600*10ms=6s
         pServer->updateConnParams(peerAddress, 0xA0, 0xC8, 1, 600);
-        if (DEBUG_MODE)
-            Serial.println("Requested low-power connection parameters");
+        LOG_DEBUG(CONN_PARAMS_REQUESTED);
     }
 
     if (!deviceConnected && oldDeviceConnected)
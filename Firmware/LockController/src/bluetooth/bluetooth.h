@@ -20,6 +20,8 @@ extern void (*onEngineStopped)();
 extern void (*onWindowsOpened)();
 /// @brief Called when the windows get closed from the app
 extern void (*onWindowsClosed)();
+/// @brief Called when the proximity key expects to unlock soon (e.g. to wake up the actuator)
+extern void (*onApproaching)();
 
 /// @brief Version of the bluetooth protocol
 extern const std::string PROTOCOL_VERSION;
@@ -35,6 +37,18 @@ extern bool engineOn;
 /// @brief Are the windows open (as far as the controller knows, resets on reboot)
 extern bool windowsOpen;
 
+/// @brief Reports a lock state change the controller didn't make itself (e.g.
+/// over serial or from a door sensor), so the app learns about it. Doesn't call
+/// onLocked / onUnlocked, nothing happens if the state is unchanged.
+void reportLocked(bool locked);
+/// @brief Like reportLocked() for the engine
+void reportEngine(bool on);
+/// @brief Like reportLocked() for the windows
+void reportWindows(bool open);
+/// @brief Reports that a door was opened (e.g. from a door sensor), which
+/// cancels the relock of UNLOCK_FOR
+void reportDoorOpened();
+
 /// @brief Sets up bluetooth
 void setupBluetooth();
 /// @brief Loop need for bluetooth to work
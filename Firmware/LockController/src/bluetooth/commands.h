@@ -2,69 +2,93 @@
 #define COMMAND_CODES_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include "types/features.h"
 
-// clang-format off
-// Protocol Version: V4
+// Protocol Version: V4. Commands and responses are listed in schema.h, the
+// enums and tables below are generated from it.
 
 /// @brief Commands sent by the client/app to the ESP32
 enum class ClientCommand : uint8_t
 {
-    GET_VERSION        = 0x00,
-    GET_DATA           = 0x01,
-    LOCK_DOORS         = 0x02,
-    UNLOCK_DOORS       = 0x03,
-    OPEN_TRUNK         = 0x04,
-    START_ENGINE       = 0x05,
-    STOP_ENGINE        = 0x06,
-    PROXIMITY_KEY_ON   = 0x07,
-    PROXIMITY_KEY_OFF  = 0x08,
-    PROXIMITY_COOLDOWN = 0x09,   // includes proximity cooldown float in min
-    RSSI_TRIGGER       = 0x0A,   // includes Rssi float, Rssi dead zone float
-    GET_RSSI           = 0x0B,
-    GET_FEATURES       = 0x0C,
-    OPEN_WINDOWS       = 0x0D,
-    CLOSE_WINDOWS      = 0x0E
+#define COMMAND(name, id, min, max, step, feature, response, handler, doc) name = id,
+#include "schema.h"
+#undef COMMAND
 };
 
-const char* toString(ClientCommand cmd)
+/// @brief ESP32-to-Client Commands
+enum class Esp32Response : uint8_t
 {
-    switch (cmd)
-    {
-        case ClientCommand::GET_VERSION:  return "GET_VERSION";
-        case ClientCommand::GET_DATA:     return "GET_DATA";
-        case ClientCommand::LOCK_DOORS:   return "LOCK_DOORS";
-        case ClientCommand::UNLOCK_DOORS: return "UNLOCK_DOORS";
-        case ClientCommand::OPEN_TRUNK:   return "OPEN_TRUNK";
-        case ClientCommand::START_ENGINE: return "START_ENGINE";
-        case ClientCommand::STOP_ENGINE:  return "STOP_ENGINE";
-        case ClientCommand::PROXIMITY_KEY_ON:   return "PROXIMITY_KEY_ON";
-        case ClientCommand::PROXIMITY_KEY_OFF:  return "PROXIMITY_KEY_OFF";
-        case ClientCommand::PROXIMITY_COOLDOWN: return "PROXIMITY_COOLDOWN";
-        case ClientCommand::RSSI_TRIGGER:       return "RSSI_TRIGGER";
-        case ClientCommand::GET_RSSI:           return "GET_RSSI";
-        case ClientCommand::GET_FEATURES:       return "GET_FEATURES";
-        case ClientCommand::OPEN_WINDOWS:       return "OPEN_WINDOWS";
-        case ClientCommand::CLOSE_WINDOWS:      return "CLOSE_WINDOWS";
-        default: return "UNKNOWN_COMMAND";
-    }
+#define RESPONSE(name, id, doc) name = id,
+#include "schema.h"
+#undef RESPONSE
+};
+
+/// @brief What the schema says about a command, indexed by its byte
+struct CommandInfo
+{
+    uint8_t id;
+    const char *name;
+    uint8_t minLength;
+    uint8_t maxLength;
+    uint8_t lengthStep;
+    Feature feature;
+};
+
+static constexpr CommandInfo COMMANDS[] = {
+#define COMMAND(name, id, min, max, step, feature, response, handler, doc) {id, #name, min, max, step, Feature::feature},
+#include "schema.h"
+#undef COMMAND
+};
+
+/// @brief Number of commands, every byte below is one
+static constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+constexpr bool commandIdsInOrder(size_t index = 0)
+{
+    return index >= COMMAND_COUNT || (COMMANDS[index].id == index && commandIdsInOrder(index + 1));
 }
+static_assert(commandIdsInOrder(), "Commands in schema.h must be in ID order without gaps");
 
+inline const CommandInfo *commandInfo(ClientCommand cmd)
+{
+    uint8_t index = static_cast<uint8_t>(cmd);
+    return index < COMMAND_COUNT ? &COMMANDS[index] : nullptr;
+}
 
-/// @brief ESP32-to-Client Commands
-enum class Esp32Response : uint8_t
+inline const char *toString(ClientCommand cmd)
 {
-    INVALID_HMAC       = 0x00,
-    VERSION            = 0x01,  // includes protocol version
-    LOCKED             = 0x02,
-    PROXIMITY_LOCKED   = 0x03,
-    UNLOCKED           = 0x04,
-    PROXIMITY_UNLOCKED = 0x05,
-    RSSI               = 0x06,   // includes Rssi float
-    FEATURES           = 0x07,   // includes supported features
-    ENGINE_STARTED     = 0x08,
-    ENGINE_STOPPED     = 0x09,
-    WINDOWS_OPENED     = 0x0A,
-    WINDOWS_CLOSED     = 0x0B,
-};
+    const CommandInfo *info = commandInfo(cmd);
+    return info != nullptr ? info->name : "UNKNOWN_COMMAND";
+}
+
+/// @brief True if the additional data of a command has a length its payload layout allows
+inline bool validPayloadLength(const CommandInfo &info, size_t length)
+{
+    if (length < info.minLength || length > info.maxLength)
+        return false;
+    if (info.lengthStep == 0)
+        return length == info.minLength || length == info.maxLength;
+    return (length - info.minLength) % info.lengthStep == 0;
+}
+
+/// @brief True if the HMAC of the command also covers its additional data:
+/// where the data decides what runs (BATCH, SCHEDULE), for how long the
+/// vehicle stays open or running (UNLOCK_FOR, START_ENGINE_FOR) or when the
+/// proximity key unlocks it (SETTINGS)
+inline bool signsPayload(ClientCommand cmd)
+{
+    switch (cmd)
+    {
+    case ClientCommand::SETTINGS:
+    case ClientCommand::BATCH:
+    case ClientCommand::UNLOCK_FOR:
+    case ClientCommand::START_ENGINE_FOR:
+    case ClientCommand::SCHEDULE:
+        return true;
+    default:
+        return false;
+    }
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,23 @@
+#include "frame.h"
+
+namespace frame
+{
+    FrameError FrameView::parse(const uint8_t *data, size_t length, FrameView &view)
+    {
+        if (data == nullptr || length == 0)
+            return FrameError::Empty;
+        if (length < HEADER_LENGTH)
+            return FrameError::TooShort;
+
+        // A frame without the length byte has no additional data
+        uint8_t additionalLength = length > HEADER_LENGTH ? data[HEADER_LENGTH] : 0;
+        if (length > HEADER_LENGTH && length < PAYLOAD_OFFSET + additionalLength)
+            return FrameError::LengthMismatch;
+
+        view.bytes = data;
+        view.additional = Payload(data + PAYLOAD_OFFSET, additionalLength);
+        size_t end = PAYLOAD_OFFSET + additionalLength;
+        view.request = length > end ? data[end] : NO_REQUEST_ID;
+        return FrameError::None;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef BLUETOOTH_FRAME_H
+#define BLUETOOTH_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Reads command frames in place, without copying them out of the BLE stack's
+// buffer:
+//
+//   32 byte HMAC | command | [length | additional data... | [request ID]]
+//
+// A client that wants to match answers to its commands adds a request ID after
+// the additional data (with a length byte of 0 if there is none). It isn't
+// covered by the HMAC, it only tells answers apart.
+//
+// FrameView::parse only checks the layout (the HMAC is verified by the caller)
+// and takes the same few steps for any input, so a malformed frame is rejected
+// as fast as a valid one is accepted. The views point into the characteristic
+// value, so they are only valid until it is written again (sendToClient):
+// handlers read their payload before they respond.
+namespace frame
+{
+    static const size_t HMAC_LENGTH = 32;
+    /// @brief HMAC + command byte, the shortest valid frame
+    static const size_t HEADER_LENGTH = HMAC_LENGTH + 1;
+    /// @brief Offset of the additional data (after its length byte)
+    static const size_t PAYLOAD_OFFSET = HEADER_LENGTH + 1;
+    /// @brief Longest additional data that fits into one write (64 byte MTU,
+    /// 3 byte ATT header), one less with a request ID
+    static const size_t MAX_PAYLOAD_LENGTH = 64 - 3 - PAYLOAD_OFFSET;
+    /// @brief No request ID was sent
+    static const int16_t NO_REQUEST_ID = -1;
+
+    enum class FrameError : uint8_t
+    {
+        None,
+        Empty,
+        TooShort,       // Less than the HMAC and command byte
+        LengthMismatch, // The length byte promises more data than was written
+    };
+
+    /// @brief Additional data of a command with bounds-checked little-endian
+    /// accessors. Reading past the end gives 0, like a missing payload does.
+    class Payload
+    {
+    public:
+        Payload() : bytes(nullptr), size(0) {}
+        Payload(const uint8_t *data, uint8_t length) : bytes(length != 0 ? data : nullptr), size(length) {}
+
+        const uint8_t *data() const { return bytes; }
+        uint8_t length() const { return size; }
+        bool empty() const { return size == 0; }
+        /// @brief True if `count` bytes can be read at `offset`
+        bool has(size_t offset, size_t count) const { return offset + count <= size; }
+
+        uint8_t u8(size_t offset) const { return has(offset, 1) ? bytes[offset] : 0; }
+        int8_t i8(size_t offset) const { return static_cast<int8_t>(u8(offset)); }
+        uint16_t u16(size_t offset) const
+        {
+            return has(offset, 2) ? static_cast<uint16_t>(bytes[offset] | bytes[offset + 1] << 8) : 0;
+        }
+        int16_t i16(size_t offset) const { return static_cast<int16_t>(u16(offset)); }
+        uint32_t u32(size_t offset) const
+        {
+            if (!has(offset, 4))
+                return 0;
+            return static_cast<uint32_t>(bytes[offset]) | static_cast<uint32_t>(bytes[offset + 1]) << 8 |
+                   static_cast<uint32_t>(bytes[offset + 2]) << 16 | static_cast<uint32_t>(bytes[offset + 3]) << 24;
+        }
+        int32_t i32(size_t offset) const { return static_cast<int32_t>(u32(offset)); }
+        float f32(size_t offset) const
+        {
+            uint32_t word = u32(offset);
+            float value;
+            memcpy(&value, &word, sizeof(value));
+            return value;
+        }
+
+    private:
+        const uint8_t *bytes;
+        uint8_t size;
+    };
+
+    class FrameView
+    {
+    public:
+        /// @brief Checks the layout of `length` bytes at `data` and points
+        /// `view` at their fields, `view` is only set if it returns None.
+        /// The byte after the additional data is the request ID, the rest is ignored.
+        static FrameError parse(const uint8_t *data, size_t length, FrameView &view);
+
+        /// @brief The 32 byte HMAC over counter and command
+        const uint8_t *hmac() const { return bytes; }
+        /// @brief The command byte (tag), not necessarily a known command
+        uint8_t command() const { return bytes[HMAC_LENGTH]; }
+        const Payload &payload() const { return additional; }
+        /// @brief The request ID (0-255) or NO_REQUEST_ID
+        int16_t requestId() const { return request; }
+
+    private:
+        const uint8_t *bytes = nullptr;
+        Payload additional;
+        int16_t request = NO_REQUEST_ID;
+    };
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef BLUETOOTH_INTERNAL_H
+#define BLUETOOTH_INTERNAL_H
+
+// Internals of bluetooth.cpp, only meant for the benchmarks and host tools
+// (not part of the API main.cpp uses, that is bluetooth.h)
+
+#include <stdint.h>
+#include <string>
+#include <BLEServer.h>
+#include "esp_gap_ble_api.h"
+#include "commands.h"
+#include "proximity/zones.h"
+
+// How many counters ahead of the stored one are still accepted.
+static const uint32_t COUNTER_WINDOW = 64;
+
+extern BLEServer *pServer;
+extern BLECharacteristic *pCharacteristic;
+/// @brief Callbacks handling writes to pCharacteristic (the command handler)
+extern BLECharacteristicCallbacks *pCommandCallbacks;
+
+extern uint8_t sharedSecret[32];
+extern uint32_t counter;
+
+extern float triggerRssiStrength;
+extern float releaseRssiStrength;
+extern int rssiDeadZone;
+extern bool sendRssi;
+extern float proximityCooldown;
+/// @brief Zone state machine of the proximity key, configured from the globals above
+extern proximity::ZoneTracker proximityZones;
+
+void sendToClient(Esp32Response responseCode, const uint8_t *data = nullptr, size_t dataLen = 0);
+void sendToClientFloat(Esp32Response responseCode, float value);
+
+void writeCounter(uint32_t count);
+uint32_t readCounter();
+/// @brief Persists calibrated trigger/release RSSI (NAN removes them)
+void writeCalibration(float trigger, float release);
+/// @brief Reads calibrated trigger/release RSSI, false if there are none
+bool readCalibration(float &trigger, float &release);
+/// @brief Persists the encoded timers (timers.h), none removes them
+void writeTimers(const uint8_t *data, size_t length);
+/// @brief Reads the encoded timers into data, their length (0 if there are none)
+size_t readTimers(uint8_t *data, size_t capacity);
+
+/// @brief HMAC-SHA256(counter | command | data), data only for commands that signsPayload()
+void generateHMAC(uint32_t counter, uint8_t command, uint8_t *hmac, const uint8_t *data = nullptr, size_t length = 0);
+bool verifyHMAC(uint32_t counter, uint8_t command, const uint8_t *received_hmac, const uint8_t *data = nullptr, size_t length = 0);
+
+void gapCallback(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+/// @brief RSSI of an advertisement with a valid presence token (see presence.h)
+void presenceReading(int rssi);
+
+std::string scrambleName(const std::string &name);
+
+#endif
@@ -0,0 +1,152 @@
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <mbedtls/md.h>
+#include <config.h>
+#include "presence.h"
+#include "internal.h"
+#include "log/log.h"
+
+namespace presence
+{
+    namespace
+    {
+        // Scans end after this many s and are started again, which also clears
+        // the results the scan library keeps of every advertiser
+        static const uint32_t SCAN_SECONDS = 60;
+
+        BLEScan *scan = nullptr;
+        bool scanning = false;
+        volatile bool scanEnded = false;
+        uint16_t scanInterval = 0;
+        unsigned long wantedSinceMillis = 0;
+        volatile unsigned long lastTokenMillis = 0;
+        volatile bool tokenSeen = false;
+
+        // Expected tokens of the counter window, recomputed when the counter moved
+        uint8_t expected[PRESENCE_COUNTER_WINDOW][PRESENCE_TOKEN_LENGTH];
+        uint32_t expectedCounter = 0;
+        bool expectedValid = false;
+
+        void token(uint32_t counter, uint8_t *out)
+        {
+            static const uint8_t label[] = {'O', 'C', 'K', 'P'};
+            uint8_t hmac[32];
+
+            mbedtls_md_context_t ctx;
+            mbedtls_md_init(&ctx);
+            mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1); // 1 = HMAC
+            mbedtls_md_hmac_starts(&ctx, sharedSecret, 32);
+            mbedtls_md_hmac_update(&ctx, label, sizeof(label));
+            mbedtls_md_hmac_update(&ctx, (const uint8_t *)&counter, sizeof(counter));
+            mbedtls_md_hmac_finish(&ctx, hmac);
+            mbedtls_md_free(&ctx);
+
+            memcpy(out, hmac, PRESENCE_TOKEN_LENGTH);
+        }
+
+        void scanComplete(BLEScanResults /* results */)
+        {
+            scanEnded = true;
+        }
+
+        // Runs in the BLE task like gapCallback
+        class PresenceCallbacks : public BLEAdvertisedDeviceCallbacks
+        {
+            void onResult(BLEAdvertisedDevice device)
+            {
+                if (!device.haveManufacturerData())
+                    return;
+
+                std::string data = device.getManufacturerData();
+                if (!verifyPresenceData(reinterpret_cast<const uint8_t *>(data.data()), data.length(), counter))
+                    return;
+
+                lastTokenMillis = millis();
+                tokenSeen = true;
+                presenceReading(device.getRSSI());
+            }
+        };
+
+        void startScan(uint16_t interval)
+        {
+            scan->setInterval(interval);
+            scan->setWindow(PRESENCE_SCAN_WINDOW);
+            scanEnded = false;
+            scanning = scan->start(SCAN_SECONDS, scanComplete, false);
+            if (scanning && interval != scanInterval)
+                LOG_DEBUG(PRESENCE_SCAN_STARTED, PRESENCE_SCAN_WINDOW, interval);
+            scanInterval = interval;
+        }
+    }
+
+    void setupPresence()
+    {
+        scan = BLEDevice::getScan();
+        scan->setAdvertisedDeviceCallbacks(new PresenceCallbacks(), true); // Every advertisement is a reading
+        scan->setActiveScan(false);
+    }
+
+    void presenceLoop(bool wanted)
+    {
+        if (scan == nullptr)
+            return;
+
+        unsigned long now = millis();
+        if (!wanted)
+        {
+            if (scanning)
+            {
+                scan->stop();
+                scan->clearResults();
+                scanning = false;
+                scanInterval = 0;
+                LOG_DEBUG(PRESENCE_SCAN_STOPPED);
+            }
+            wantedSinceMillis = now;
+            return;
+        }
+
+        unsigned long quietMillis = now - wantedSinceMillis;
+        if (tokenSeen && now - lastTokenMillis < quietMillis)
+            quietMillis = now - lastTokenMillis;
+        uint16_t interval = quietMillis >= PRESENCE_IDLE_AFTER ? PRESENCE_IDLE_INTERVAL : PRESENCE_SCAN_INTERVAL;
+
+        if (scanning && !scanEnded && interval == scanInterval)
+            return;
+
+        if (scanning)
+            scan->stop();
+        scan->clearResults();
+        startScan(interval);
+    }
+
+    void buildPresenceData(uint32_t counter, uint8_t *out)
+    {
+        out[0] = PRESENCE_COMPANY_ID & 0xFF;
+        out[1] = PRESENCE_COMPANY_ID >> 8;
+        out[2] = PRESENCE_DATA_TYPE;
+        token(counter, out + 3);
+    }
+
+    bool verifyPresenceData(const uint8_t *data, size_t length, uint32_t counter)
+    {
+        if (length != PRESENCE_DATA_LENGTH || data[0] != (PRESENCE_COMPANY_ID & 0xFF) ||
+            data[1] != PRESENCE_COMPANY_ID >> 8 || data[2] != PRESENCE_DATA_TYPE)
+            return false;
+
+        if (!expectedValid || expectedCounter != counter)
+        {
+            for (uint32_t i = 0; i < PRESENCE_COUNTER_WINDOW; i++)
+                token(counter + i, expected[i]);
+            expectedCounter = counter;
+            expectedValid = true;
+        }
+
+        for (uint32_t i = 0; i < PRESENCE_COUNTER_WINDOW; i++)
+        {
+            if (memcmp(data + 3, expected[i], PRESENCE_TOKEN_LENGTH) == 0)
+                return true;
+        }
+        return false;
+    }
+}
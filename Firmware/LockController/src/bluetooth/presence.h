@@ -0,0 +1,45 @@
+#ifndef BLUETOOTH_PRESENCE_H
+#define BLUETOOTH_PRESENCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Connectionless presence detection (PRESENCE_SCAN in config.h). While the
+// phone is not connected it advertises manufacturer specific data
+//
+//   uint16 company ID 0xFFFF, 0x50 ('P'), 12 byte token
+//
+// with token = first 12 bytes of HMAC-SHA256(key, "OCKP" | uint32 counter),
+// counter being the rolling code counter of its next command. The controller
+// scans for it, duty-cycled, and accepts the token for counters within
+// PRESENCE_COUNTER_WINDOW of its own, so it changes with every connection and
+// an old one stops working once a newer command was accepted.
+//
+// The RSSI of the advertisements only prepares the unlock (onApproaching, and
+// the zone state machine continues from there once connected); unlocking
+// still needs the connection and a reading through it.
+namespace presence
+{
+    static const uint16_t PRESENCE_COMPANY_ID = 0xFFFF;
+    static const uint8_t PRESENCE_DATA_TYPE = 0x50;
+    static const size_t PRESENCE_TOKEN_LENGTH = 12;
+    /// @brief Manufacturer data length (company ID, type, token)
+    static const size_t PRESENCE_DATA_LENGTH = 3 + PRESENCE_TOKEN_LENGTH;
+    /// @brief Counters from the stored one on that are accepted
+    static const uint32_t PRESENCE_COUNTER_WINDOW = 8;
+    /// @brief Readings of the scan are carried over into a connection made within this many ms
+    static const uint32_t PRESENCE_FRESH_MILLIS = 10000;
+
+    /// @brief Sets up the (not yet running) passive scan
+    void setupPresence();
+    /// @brief Starts, stops and duty-cycles the scan, wanted while the phone is
+    /// away with the proximity key on
+    void presenceLoop(bool wanted);
+
+    /// @brief Manufacturer data the phone advertises for a counter (PRESENCE_DATA_LENGTH bytes)
+    void buildPresenceData(uint32_t counter, uint8_t *out);
+    /// @brief True if data is a presence token for a counter within the window of `counter`
+    bool verifyPresenceData(const uint8_t *data, size_t length, uint32_t counter);
+}
+
+#endif
@@ -0,0 +1,189 @@
+// Protocol schema: every command and response, in ID order (IDs index the
+// tables generated from this list, so there must be no gaps).
+//
+//   COMMAND(name, id, min, max, step, feature, response, handler, doc)
+//
+// min/max: length of the additional data in bytes, step: what a longer one
+// grows by between them (0 if only min and max are valid). feature: the
+// SUPPORTED_FEATURES bit the command needs (None: always available).
+// response: what it is answered with (NONE if nothing). handler: function in
+// bluetooth.cpp. doc: for the app, paragraphs separated by \n.
+//
+//   RESPONSE(name, id, doc)
+//
+// Included by bluetooth/commands.h (enums, names, payload and feature checks),
+// bluetooth.cpp (handler table) and tools/dart_commands, which generates
+// MobileApp/lib/types/ble_commands.dart from it. Protocol version: V4, so
+// existing entries never change, new ones are appended.
+
+// clang-format off
+#ifdef COMMAND
+COMMAND(GET_VERSION,        0x00, 0, 0, 0,  None,      VERSION,        handleGetVersion,
+        "Gets the protocol version of the ESP32")
+COMMAND(GET_DATA,           0x01, 0, 0, 0,  None,      LOCKED,         handleGetData,
+        "Triggers a doors locked or unlocked event depending on the state (and "
+        "engine and windows events if the vehicle supports them)")
+COMMAND(LOCK_DOORS,         0x02, 0, 0, 0,  DoorsLock, LOCKED,         handleLockDoors,
+        "Locks the doors")
+COMMAND(UNLOCK_DOORS,       0x03, 0, 0, 0,  DoorsLock, UNLOCKED,       handleUnlockDoors,
+        "Unlocks the doors")
+COMMAND(OPEN_TRUNK,         0x04, 0, 0, 0,  TrunkOpen, NONE,           handleOpenTrunk,
+        "Opens the trunk")
+COMMAND(START_ENGINE,       0x05, 0, 0, 0,  Engine,    ENGINE_STARTED, handleStartEngine,
+        "Starts the engine")
+COMMAND(STOP_ENGINE,        0x06, 0, 0, 0,  Engine,    ENGINE_STOPPED, handleStopEngine,
+        "Stops the engine")
+COMMAND(PROXIMITY_KEY_ON,   0x07, 0, 0, 0,  None,      NONE,           handleProximityKeyOn,
+        "Enables proximity key")
+COMMAND(PROXIMITY_KEY_OFF,  0x08, 0, 0, 0,  None,      NONE,           handleProximityKeyOff,
+        "Disables proximity key")
+COMMAND(PROXIMITY_COOLDOWN, 0x09, 4, 4, 0,  None,      NONE,           handleProximityCooldown,
+        "Sets the proximity cooldown\n"
+        "Additional data: `float` proximity cooldown in minutes")
+COMMAND(RSSI_TRIGGER,       0x0A, 8, 8, 0,  None,      NONE,           handleRssiTrigger,
+        "Sets the RSSI trigger values\n"
+        "Additional data: `float` RSSI trigger, `float` RSSI dead zone")
+COMMAND(GET_RSSI,           0x0B, 0, 0, 0,  None,      RSSI,           handleGetRssi,
+        "Gets the current RSSI")
+COMMAND(GET_FEATURES,       0x0C, 0, 0, 0,  None,      FEATURES,       handleGetFeatures,
+        "Gets the features supported by the vehicle")
+COMMAND(OPEN_WINDOWS,       0x0D, 0, 0, 0,  Windows,   WINDOWS_OPENED, handleOpenWindows,
+        "Opens (rolls down) the windows")
+COMMAND(CLOSE_WINDOWS,      0x0E, 0, 0, 0,  Windows,   WINDOWS_CLOSED, handleCloseWindows,
+        "Closes (rolls up) the windows")
+COMMAND(GET_STATS,          0x0F, 0, 0, 0,  None,      STATS,          handleGetStats,
+        "Gets the command latency statistics of the controller\n"
+        "Answered with several [Esp32Response.STATS] messages")
+COMMAND(GET_MEMORY,         0x10, 0, 0, 0,  None,      MEMORY,         handleGetMemory,
+        "Gets the heap and stack samples of the controller\n"
+        "Answered with one [Esp32Response.MEMORY] message per sample")
+COMMAND(RSSI_FILTER,        0x11, 0, 9, 9,  None,      RSSI_FILTER,    handleRssiFilter,
+        "Selects and tunes the RSSI filter of the proximity key\n"
+        "Additional data: filter type byte (0 moving average, 1 exponential, 2 "
+        "median, 3 Kalman), 2 parameter floats. Without data the active filter is "
+        "only reported. Answered with [Esp32Response.RSSI_FILTER]")
+COMMAND(CALIBRATE,          0x12, 4, 4, 0,  None,      CALIBRATION,    handleCalibrate,
+        "Collects RSSI readings for the given time while the phone is held where "
+        "the vehicle should unlock and derives trigger and release RSSI from them\n"
+        "Additional data: `float` duration in s (max. 120, 0 clears the "
+        "calibration). Answered with [Esp32Response.CALIBRATION] when done")
+COMMAND(GET_TRACE,          0x13, 0, 0, 0,  None,      TRACE,          handleGetTrace,
+        "Requests the recorded RSSI trace (raw readings, connection events and "
+        "proximity decisions). Answered with several [Esp32Response.TRACE]")
+COMMAND(PHONE_RSSI,         0x14, 2, 26, 2, None,      NONE,           handlePhoneRssi,
+        "Hands the controller the RSSI the phone measured of it, which it fuses "
+        "with its own readings for the proximity key\n"
+        "Additional data: up to 13 pairs of `int8` RSSI and `uint8` age (in 20ms "
+        "units before sending), oldest first. Not answered")
+COMMAND(RSSI_STREAM,        0x15, 2, 4, 2,  None,      RSSI_SAMPLES,   handleRssiStream,
+        "Subscribes to the RSSI instead of sending [ClientCommand.GET_RSSI] for "
+        "every reading, ends on disconnect\n"
+        "Additional data: `uint16` interval in ms (0 ends the subscription), "
+        "optionally `uint16` duration in s (max. and default 300). Answered with "
+        "[Esp32Response.RSSI_SAMPLES]")
+COMMAND(SETTINGS,           0x16, 0, 27, 1, None,      SETTINGS,       handleSettings,
+        "Changes several settings at once (proximity key, trigger RSSI, dead zone, "
+        "cooldown, RSSI filter)\n"
+        "Additional data: TLV settings (see Docs/LockController.md), fields with "
+        "unknown tags are skipped, covered by the HMAC. Without data the settings "
+        "are only reported. Answered with [Esp32Response.SETTINGS]")
+COMMAND(BATCH,              0x17, 3, 27, 1, None,      BATCH_RESULT,   handleBatch,
+        "Runs several commands in order under one rolling code, either all of them "
+        "or none (if one of them is unknown, unsupported or has invalid data)\n"
+        "Additional data: TLV (see Docs/LockController.md) with the command as tag "
+        "and its additional data as value. The HMAC also covers the additional "
+        "data. Answered with [Esp32Response.BATCH_RESULT] "
+        "after the answers of the commands")
+COMMAND(GET_LIMITS,         0x18, 0, 0, 0,  None,      LIMITS,         handleGetLimits,
+        "Gets how many commands may wait for their answer at once (credits) and "
+        "the longest additional data in both directions\n"
+        "Answered with [Esp32Response.LIMITS]")
+COMMAND(STATE_SINCE,        0x19, 4, 4, 0,  None,      STATE_DELTA,    handleStateSince,
+        "Gets what changed since a state version the client saw (after a reconnect)\n"
+        "Additional data: `uint32` version of the last [Esp32Response.STATE] or "
+        "[Esp32Response.STATE_DELTA]. Answered with [Esp32Response.STATE_DELTA], "
+        "every bit counts as changed if the version is unknown")
+COMMAND(UNLOCK_FOR,         0x1A, 2, 2, 0,  DoorsLock, UNLOCKED,       handleUnlockFor,
+        "Unlocks the doors and locks them again after the given time, unless a "
+        "door was opened or the lock changed otherwise meanwhile\n"
+        "Additional data: `uint16` seconds (0 only cancels a pending relock), "
+        "covered by the HMAC. Answered with [Esp32Response.UNLOCKED], or [Esp32Response.COMMAND_REJECTED] "
+        "without unlocking if no timer is free")
+COMMAND(START_ENGINE_FOR,   0x1B, 2, 2, 0,  Engine,    ENGINE_STARTED, handleStartEngineFor,
+        "Starts the engine and stops it after the given time at the latest, unless "
+        "it was stopped otherwise meanwhile\n"
+        "Additional data: `uint16` seconds, at most the controller's maximum "
+        "runtime, covered by the HMAC. Answered with [Esp32Response.ENGINE_STARTED], or "
+        "[Esp32Response.COMMAND_REJECTED] without starting if no timer is free")
+COMMAND(SCHEDULE,           0x1C, 0, 5, 0,  None,      SCHEDULE,       handleSchedule,
+        "Runs a command later without the app (up to 6 timers; after a reboot the "
+        "ones that unlock, start the engine or open the windows are dropped, the "
+        "others run right away)\n"
+        "Additional data: `uint8` command (LOCK_DOORS, UNLOCK_DOORS, START_ENGINE, "
+        "STOP_ENGINE, OPEN_WINDOWS or CLOSE_WINDOWS), `uint32` seconds from now "
+        "(max. 7 days, 0 cancels the scheduled ones of the command), covered by "
+        "the HMAC. Without data the timers are only reported. Answered with [Esp32Response.SCHEDULE], "
+        "or [Esp32Response.COMMAND_REJECTED] changing nothing if the command isn't supported, the "
+        "delay too long or no timer free")
+#endif
+
+#ifdef RESPONSE
+RESPONSE(INVALID_HMAC,       0x00, "The HMAC was invalid")
+RESPONSE(VERSION,            0x01, "The protocol version")
+RESPONSE(LOCKED,             0x02, "Car was locked manually")
+RESPONSE(PROXIMITY_LOCKED,   0x03, "Car was locked by proximity")
+RESPONSE(UNLOCKED,           0x04, "Car was unlocked manually")
+RESPONSE(PROXIMITY_UNLOCKED, 0x05, "Car was unlocked by proximity")
+RESPONSE(RSSI,               0x06, "Current RSSI\n"
+                                   "Additional data: `float` RSSI")
+RESPONSE(FEATURES,           0x07, "Features supported by the vehicle\n"
+                                   "Additional data: `int` bitmask")
+RESPONSE(ENGINE_STARTED,     0x08, "Engine was started")
+RESPONSE(ENGINE_STOPPED,     0x09, "Engine was stopped")
+RESPONSE(WINDOWS_OPENED,     0x0A, "Windows were opened")
+RESPONSE(WINDOWS_CLOSED,     0x0B, "Windows were closed")
+RESPONSE(STATS,              0x0C, "One record of the controller statistics\n"
+                                   "Additional data: summary or histogram record (see Docs/LockController.md)")
+RESPONSE(MEMORY,             0x0D, "One heap and stack sample of the controller\n"
+                                   "Additional data: memory sample (see Docs/LockController.md)")
+RESPONSE(MEMORY_ALERT,       0x0E, "Free heap or the largest free block of the controller is low\n"
+                                   "Additional data: memory sample that triggered it")
+RESPONSE(RSSI_FILTER,        0x0F, "Active RSSI filter (unchanged if the requested one was invalid)\n"
+                                   "Additional data: filter type byte, 2 parameter floats")
+RESPONSE(CALIBRATION,        0x10, "Result of [ClientCommand.CALIBRATE]\n"
+                                   "Additional data: `float` trigger RSSI, `float` release RSSI, `float` 5%, "
+                                   "25% and 50% quantile, `uint16` readings. None if it failed or was cleared")
+RESPONSE(TRACE,              0x11, "One record of the RSSI trace, ~20ms apart\n"
+                                   "Additional data: header (`0x00`, `uint32` base ms, `int8` base RSSI, "
+                                   "`uint16` entries, `uint32` ms now) first, then `0x01` + up to 14 entries")
+RESPONSE(RSSI_SAMPLES,       0x12, "A batch of the [ClientCommand.RSSI_STREAM] subscription, about once a second\n"
+                                   "Additional data: `uint32` ms of the first sample, `uint16` ms between "
+                                   "samples, `int8` RSSI per sample. None once the subscription ended")
+RESPONSE(SETTINGS,           0x13, "Settings of the controller after [ClientCommand.SETTINGS]\n"
+                                   "Additional data: TLV settings, including the release RSSI")
+RESPONSE(BATCH_RESULT,       0x14, "Result of [ClientCommand.BATCH]\n"
+                                   "Additional data: status byte (0 all ran, 1 malformed, 2 unknown or "
+                                   "unsupported command, 3 invalid data, 4 nested batch), `uint8` index "
+                                   "of the command it failed at (number of commands if all ran)")
+RESPONSE(COMMAND_DONE,       0x15, "A command with a request ID that isn't answered otherwise was handled\n"
+                                   "Additional data: status byte (0 ran, 1 unknown or unsupported, 2 invalid data)")
+RESPONSE(LIMITS,             0x16, "Result of [ClientCommand.GET_LIMITS]\n"
+                                   "Additional data: `uint8` credits, `uint8` longest additional data of a "
+                                   "command, `uint8` longest additional data of an answer (both one less "
+                                   "with a request ID)")
+RESPONSE(STATE,              0x17, "Vehicle state, the value of the state characteristic (read after an "
+                                   "authenticated command)\n"
+                                   "Additional data: `uint8` state bits (1 locked, 2 engine on, 4 windows "
+                                   "open, 8 relock pending, 16 engine shutoff pending, 32 commands "
+                                   "scheduled), `uint8` bits the vehicle has, `uint32` state version")
+RESPONSE(STATE_DELTA,        0x18, "State bits that changed, notified on the state characteristic on every "
+                                   "change and the answer to [ClientCommand.STATE_SINCE]\n"
+                                   "Additional data: `uint8` changed bits, `uint8` state bits, `uint32` "
+                                   "state version")
+RESPONSE(SCHEDULE,           0x19, "Timers of the controller after [ClientCommand.SCHEDULE]\n"
+                                   "Additional data: per timer `uint8` command, `uint8` kind (0 scheduled, "
+                                   "1 relock of UNLOCK_FOR, 2 shutoff of START_ENGINE_FOR), `uint32` seconds left")
+RESPONSE(COMMAND_REJECTED,   0x1A, "A timed command or schedule was refused without changing anything\n"
+                                   "Additional data: `uint8` command")
+#endif
+// clang-format on
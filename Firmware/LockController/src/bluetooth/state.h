@@ -0,0 +1,135 @@
+#ifndef BLUETOOTH_STATE_H
+#define BLUETOOTH_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "types/features.h"
+
+// Vehicle state (and pending timers, see timers.h) packed into one byte, and
+// the journal of its changes:
+//
+//   STATE:       uint8 state bits, uint8 bits the vehicle has, uint32 version
+//   STATE_DELTA: uint8 changed bits, uint8 state bits, uint32 version
+//
+// Bits of features the vehicle doesn't support are always 0. The version goes
+// up by one with every change and starts at a random value on boot, so a
+// version from before a reboot is (almost certainly) unknown to the journal,
+// which then reports every bit as changed.
+namespace state
+{
+    /// @brief Length of the STATE data
+    static const size_t STATE_LENGTH = 6;
+    /// @brief Length of the STATE_DELTA data
+    static const size_t DELTA_LENGTH = 6;
+    /// @brief Changes the journal remembers, older versions get everything
+    static const uint32_t JOURNAL_LENGTH = 16;
+
+    /// @brief Bits of the state byte (append only)
+    enum Bit : uint8_t
+    {
+        Locked = 1 << 0,
+        EngineOn = 1 << 1,
+        WindowsOpen = 1 << 2,
+        RelockPending = 1 << 3,  // UNLOCK_FOR will lock again
+        ShutoffPending = 1 << 4, // START_ENGINE_FOR will stop the engine
+        Scheduled = 1 << 5,      // SCHEDULE has commands waiting
+    };
+
+    /// @brief Bits that mean something for a vehicle with `features`
+    constexpr uint8_t supportedBits(Feature features)
+    {
+        return Locked | RelockPending | Scheduled | (hasFeature(features, Feature::Engine) ? EngineOn | ShutoffPending : 0) |
+               (hasFeature(features, Feature::Windows) ? WindowsOpen : 0);
+    }
+
+    constexpr uint8_t pack(bool locked, bool engineOn, bool windowsOpen)
+    {
+        return (locked ? Locked : 0) | (engineOn ? EngineOn : 0) | (windowsOpen ? WindowsOpen : 0);
+    }
+
+    struct Delta
+    {
+        uint8_t changed;
+        uint8_t bits;
+        uint32_t version;
+    };
+
+    /// @brief Writes `version` little-endian to `out`
+    inline void encodeVersion(uint32_t version, uint8_t *out)
+    {
+        for (size_t i = 0; i < 4; i++)
+            out[i] = static_cast<uint8_t>(version >> (8 * i));
+    }
+
+    /// @brief Writes the STATE_DELTA data (DELTA_LENGTH bytes)
+    inline void encodeDelta(const Delta &delta, uint8_t *out)
+    {
+        out[0] = delta.changed;
+        out[1] = delta.bits;
+        encodeVersion(delta.version, out + 2);
+    }
+
+    /// @brief The current state bits, their version and which bits the last
+    /// JOURNAL_LENGTH versions changed
+    class Journal
+    {
+    public:
+        /// @brief Starts over at `version` with `bits`, forgetting all changes
+        void reset(uint8_t bits, uint32_t version)
+        {
+            current = bits;
+            currentVersion = version;
+            remembered = 0;
+        }
+
+        /// @brief Takes the new state bits, true (and a new version) if any changed
+        bool record(uint8_t bits)
+        {
+            uint8_t changed = bits ^ current;
+            if (changed == 0)
+                return false;
+
+            current = bits;
+            currentVersion++;
+            changes[currentVersion % JOURNAL_LENGTH] = changed;
+            if (remembered < JOURNAL_LENGTH)
+                remembered++;
+            return true;
+        }
+
+        /// @brief Every bit that changed after version `seen`, `all` if the
+        /// journal doesn't know it (too old, from another boot, in the future)
+        Delta since(uint32_t seen, uint8_t all) const
+        {
+            Delta delta = {0, current, currentVersion};
+            uint32_t behind = currentVersion - seen;
+            if (behind > remembered)
+            {
+                delta.changed = all;
+                return delta;
+            }
+            for (uint32_t version = seen + 1; version != currentVersion + 1; version++)
+                delta.changed |= changes[version % JOURNAL_LENGTH];
+            return delta;
+        }
+
+        /// @brief The change to the current version
+        Delta latest() const
+        {
+            Delta delta = {remembered > 0 ? changes[currentVersion % JOURNAL_LENGTH] : static_cast<uint8_t>(0), current,
+                           currentVersion};
+            return delta;
+        }
+
+        uint8_t bits() const { return current; }
+        uint32_t version() const { return currentVersion; }
+
+    private:
+        uint8_t current = 0;
+        uint32_t currentVersion = 0;
+        uint32_t remembered = 0;
+        uint8_t changes[JOURNAL_LENGTH] = {};
+    };
+}
+
+#endif
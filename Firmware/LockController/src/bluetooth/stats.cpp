@@ -0,0 +1,177 @@
+#include <Arduino.h>
+#include "stats.h"
+
+namespace stats
+{
+    namespace
+    {
+        const uint8_t STAGE_COUNT = static_cast<uint8_t>(Stage::Count);
+
+        uint16_t histograms[COMMAND_SLOTS][STAGE_COUNT][BUCKET_COUNT] = {};
+
+        uint16_t invalidHmacs = 0;
+        uint16_t connections = 0;
+        uint16_t proximityActions = 0;
+
+        bool commandActive = false;
+        uint8_t currentCommand = 0;
+        uint32_t currentReceivedAt = 0;
+        uint8_t reachedStages = 0;
+
+        // Report cursor: -1 = summary, then command * STAGE_COUNT + stage
+        int reportCursor = -1;
+
+        uint8_t bucketFor(uint32_t micros)
+        {
+            uint8_t bucket = 0;
+            micros >>= 4;
+            while (micros != 0 && bucket < BUCKET_COUNT - 1)
+            {
+                micros >>= 1;
+                bucket++;
+            }
+            return bucket;
+        }
+
+        void increment(uint16_t &value)
+        {
+            if (value != UINT16_MAX)
+                value++;
+        }
+
+        bool isEmpty(const uint16_t *buckets)
+        {
+            for (uint8_t i = 0; i < BUCKET_COUNT; i++)
+            {
+                if (buckets[i] != 0)
+                    return false;
+            }
+            return true;
+        }
+
+        uint16_t histogramCount()
+        {
+            uint16_t count = 0;
+            for (uint8_t command = 0; command < COMMAND_SLOTS; command++)
+            {
+                for (uint8_t stage = 0; stage < STAGE_COUNT; stage++)
+                {
+                    if (!isEmpty(histograms[command][stage]))
+                        count++;
+                }
+            }
+            return count;
+        }
+
+        size_t putUint16(uint8_t *out, uint16_t value)
+        {
+            out[0] = value & 0xFF;
+            out[1] = value >> 8;
+            return 2;
+        }
+
+        size_t putUint32(uint8_t *out, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                out[i] = (value >> (8 * i)) & 0xFF;
+            return 4;
+        }
+
+        size_t putVarint(uint8_t *out, uint16_t value)
+        {
+            size_t length = 0;
+            do
+            {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                out[length++] = byte | (value != 0 ? 0x80 : 0);
+            } while (value != 0);
+            return length;
+        }
+    }
+
+    void commandVerified(uint8_t command, uint32_t receivedAtMicros)
+    {
+        commandActive = command < COMMAND_SLOTS;
+        currentCommand = command;
+        currentReceivedAt = receivedAtMicros;
+        reachedStages = 0;
+        mark(Stage::MacVerified);
+    }
+
+    void mark(Stage stage)
+    {
+        uint8_t stageBit = 1 << static_cast<uint8_t>(stage);
+        if (!commandActive || (reachedStages & stageBit))
+            return;
+
+        reachedStages |= stageBit;
+        uint32_t elapsed = micros() - currentReceivedAt;
+        increment(histograms[currentCommand][static_cast<uint8_t>(stage)][bucketFor(elapsed)]);
+    }
+
+    void commandCompleted()
+    {
+        mark(Stage::Completed);
+        commandActive = false;
+    }
+
+    void countInvalidHmac() { increment(invalidHmacs); }
+    void countConnection() { increment(connections); }
+    void countProximityAction() { increment(proximityActions); }
+
+    void startReport()
+    {
+        reportCursor = -1;
+    }
+
+    size_t nextRecord(uint8_t *out, size_t maxLength)
+    {
+        if (maxLength < MAX_RECORD_LENGTH)
+            return 0;
+
+        if (reportCursor == -1)
+        {
+            size_t length = 0;
+            out[length++] = static_cast<uint8_t>(Record::Summary);
+            length += putUint32(out + length, millis());
+            length += putUint16(out + length, invalidHmacs);
+            length += putUint16(out + length, connections > 0 ? connections - 1 : 0);
+            length += putUint16(out + length, proximityActions);
+            length += putUint16(out + length, histogramCount());
+            reportCursor = 0;
+            return length;
+        }
+
+        while (reportCursor < COMMAND_SLOTS * STAGE_COUNT)
+        {
+            uint8_t command = reportCursor / STAGE_COUNT;
+            uint8_t stage = reportCursor % STAGE_COUNT;
+            reportCursor++;
+
+            const uint16_t *buckets = histograms[command][stage];
+            if (isEmpty(buckets))
+                continue;
+
+            size_t length = 0;
+            out[length++] = static_cast<uint8_t>(Record::Histogram);
+            out[length++] = command;
+            out[length++] = stage;
+
+            uint16_t mask = 0;
+            size_t maskOffset = length;
+            length += 2;
+            for (uint8_t i = 0; i < BUCKET_COUNT; i++)
+            {
+                if (buckets[i] == 0)
+                    continue;
+                mask |= 1 << i;
+                length += putVarint(out + length, buckets[i]);
+            }
+            putUint16(out + maskOffset, mask);
+            return length;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "commands.h"
+
+// Command latency histograms and event counters, kept in RAM only (reset on
+// reboot) and reported to the app with GET_STATS.
+namespace stats
+{
+    /// @brief Points a command passes through, all measured from the moment the
+    /// frame was received by onWrite
+    enum class Stage : uint8_t
+    {
+        MacVerified      = 0,
+        CounterPersisted = 1,
+        CallbackInvoked  = 2, // The callback in main.cpp (relay etc.) returned
+        ResponseNotified = 3,
+        Completed        = 4,
+        Count
+    };
+
+    /// @brief Log2 buckets: bucket 0 is < 16us, bucket n is [8 << n, 16 << n) us,
+    /// the last bucket also holds everything above (>= 262ms)
+    static const uint8_t BUCKET_COUNT = 16;
+    /// @brief Command bytes with their own histograms, one per command of schema.h
+    static_assert(COMMAND_COUNT <= 256, "Histogram records carry the command as one byte");
+    static const uint8_t COMMAND_SLOTS = COMMAND_COUNT;
+    /// @brief Largest record: 5 byte header + 3 byte varint per bucket, the
+    /// least maxLength nextRecord() needs
+    static const size_t MAX_RECORD_LENGTH = 5 + 3 * BUCKET_COUNT;
+
+    /// @brief Record types inside a STATS response
+    enum class Record : uint8_t
+    {
+        Summary   = 0x00,
+        Histogram = 0x01,
+    };
+
+    /// @brief Starts timing a command that passed HMAC verification
+    void commandVerified(uint8_t command, uint32_t receivedAtMicros);
+    /// @brief Records the time since the frame was received for the current
+    /// command (only the first time a stage is reached, no-op without a command)
+    void mark(Stage stage);
+    /// @brief Records the Completed stage and ends the current command
+    void commandCompleted();
+
+    void countInvalidHmac();
+    void countConnection();
+    void countProximityAction();
+
+    /// @brief Restarts the report at the summary record
+    void startReport();
+    /// @brief Encodes the next record of the report into out (returns 0 once
+    /// everything was reported).
+    ///
+    /// Summary: `0x00, uint32 uptime ms, uint16 invalid HMACs, uint16 reconnects,
+    /// uint16 proximity actions, uint16 histogram record count`
+    ///
+    /// Histogram: `0x01, command, stage, uint16 bucket mask, LEB128 count per set bit`
+    size_t nextRecord(uint8_t *out, size_t maxLength);
+}
+
+#endif
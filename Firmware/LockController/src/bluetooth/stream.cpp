@@ -0,0 +1,51 @@
+#include <string.h>
+#include "stream.h"
+
+namespace stream
+{
+    void RssiBatch::start(uint16_t intervalMillis)
+    {
+        spacing = intervalMillis;
+        count = 0;
+        slotted = false;
+    }
+
+    void RssiBatch::clear()
+    {
+        // The next batch continues with the next slot
+        first += count * static_cast<uint32_t>(spacing);
+        count = 0;
+    }
+
+    BatchResult RssiBatch::add(int8_t rssi, uint32_t nowMillis)
+    {
+        // Distance to the slot of the next sample, negative if before it
+        int32_t offset = static_cast<int32_t>(nowMillis - (first + count * static_cast<uint32_t>(spacing)));
+        if (slotted && offset < -static_cast<int32_t>(spacing / 4))
+            return BatchResult::Skipped;
+
+        if (!slotted || (count == 0 && offset > static_cast<int32_t>(spacing / 2)))
+        {
+            // Slots start over from this sample
+            first = nowMillis;
+            slotted = true;
+        }
+        else if (offset > static_cast<int32_t>(spacing / 2) || full())
+        {
+            return BatchResult::Late;
+        }
+
+        samples[count++] = rssi;
+        return BatchResult::Added;
+    }
+
+    size_t RssiBatch::encode(uint8_t *out) const
+    {
+        for (size_t i = 0; i < 4; i++)
+            out[i] = (first >> (8 * i)) & 0xFF;
+        out[4] = spacing & 0xFF;
+        out[5] = spacing >> 8;
+        memcpy(out + RSSI_SAMPLES_HEADER_LENGTH, samples, count);
+        return RSSI_SAMPLES_HEADER_LENGTH + count;
+    }
+}
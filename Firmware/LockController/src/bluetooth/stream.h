@@ -0,0 +1,64 @@
+#ifndef BLUETOOTH_STREAM_H
+#define BLUETOOTH_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RSSI subscription (RSSI_STREAM): instead of one GET_RSSI command per
+// reading, the app subscribes once and gets the filtered RSSI every `interval`
+// ms, packed into RSSI_SAMPLES notifications of up to RSSI_BATCH_CAPACITY
+// samples (or RSSI_STREAM_BATCH_MILLIS worth of them):
+//
+//   uint32 ms of the first sample, uint16 ms between samples, int8 RSSI...
+//
+// Little-endian. Sample n was taken at first + n * interval (within a quarter
+// interval). A reading that misses its slot starts a new notification, so
+// there are no gaps inside one. The subscription ends on disconnect, with an interval of 0
+// or after its duration, then an RSSI_SAMPLES without data follows the rest.
+namespace stream
+{
+    /// @brief Length of the RSSI_SAMPLES header
+    static const size_t RSSI_SAMPLES_HEADER_LENGTH = 6;
+    /// @brief Samples per notification (fills MAX_RESPONSE_DATA_LENGTH)
+    static const size_t RSSI_BATCH_CAPACITY = 53;
+    /// @brief Samples are sent at least this often
+    static const uint32_t RSSI_STREAM_BATCH_MILLIS = 1000;
+    /// @brief Longest subscription (and the one without a duration)
+    static const uint16_t RSSI_STREAM_MAX_SECONDS = 300;
+    /// @brief Longest interval between two samples
+    static const uint16_t RSSI_STREAM_MAX_INTERVAL = 10000;
+
+    enum class BatchResult : uint8_t
+    {
+        Added,
+        Skipped, // Before its slot (the controller reads faster for the proximity key)
+        Late,    // After its slot, the batch has to be sent first
+    };
+
+    class RssiBatch
+    {
+    public:
+        /// @brief Empties the batch and sets the time between two samples
+        void start(uint16_t intervalMillis);
+        BatchResult add(int8_t rssi, uint32_t nowMillis);
+        /// @brief Empties the batch after it was sent
+        void clear();
+
+        bool empty() const { return count == 0; }
+        bool full() const { return count == RSSI_BATCH_CAPACITY; }
+        uint32_t firstMillis() const { return first; }
+        uint16_t interval() const { return spacing; }
+
+        /// @brief Encodes the RSSI_SAMPLES data (empty batches too)
+        size_t encode(uint8_t *out) const;
+
+    private:
+        int8_t samples[RSSI_BATCH_CAPACITY];
+        uint8_t count = 0;
+        uint32_t first = 0;
+        uint16_t spacing = 1000;
+        bool slotted = false; // first is the slot of the first sample
+    };
+}
+
+#endif
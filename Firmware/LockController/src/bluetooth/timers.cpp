@@ -0,0 +1,139 @@
+#include "timers.h"
+
+namespace timers
+{
+    namespace
+    {
+        // Due or overdue, also across the wrap of millis()
+        bool isDue(const Timer &timer, uint32_t nowMillis)
+        {
+            return static_cast<int32_t>(nowMillis - timer.dueMillis) >= 0;
+        }
+    }
+
+    bool Table::add(uint8_t command, Kind kind, uint32_t delayMillis, uint32_t nowMillis)
+    {
+        if (!hasRoom(kind))
+            return false;
+        if (kind != Kind::Scheduled)
+            cancel(kind);
+
+        entries[used++] = {command, kind, nowMillis + delayMillis};
+        return true;
+    }
+
+    bool Table::hasRoom(Kind kind) const
+    {
+        if (kind == Kind::Scheduled)
+            return used < MAX_TIMERS && count(Kind::Scheduled) < MAX_SCHEDULED;
+        return used < MAX_TIMERS || pending(kind);
+    }
+
+    bool Table::cancel(Kind kind)
+    {
+        bool removed = false;
+        for (size_t i = used; i-- > 0;)
+        {
+            if (entries[i].kind != kind)
+                continue;
+            removeAt(i);
+            removed = true;
+        }
+        return removed;
+    }
+
+    bool Table::cancelScheduled(uint8_t command)
+    {
+        bool removed = false;
+        for (size_t i = used; i-- > 0;)
+        {
+            if (entries[i].kind != Kind::Scheduled || entries[i].command != command)
+                continue;
+            removeAt(i);
+            removed = true;
+        }
+        return removed;
+    }
+
+    void Table::expire(uint32_t nowMillis)
+    {
+        for (size_t i = 0; i < used; i++)
+            entries[i].dueMillis = nowMillis;
+    }
+
+    bool Table::takeDue(uint32_t nowMillis, Timer &due)
+    {
+        size_t first = used;
+        for (size_t i = 0; i < used; i++)
+        {
+            if (isDue(entries[i], nowMillis) &&
+                (first == used || static_cast<int32_t>(entries[i].dueMillis - entries[first].dueMillis) < 0))
+                first = i;
+        }
+        if (first == used)
+            return false;
+
+        due = entries[first];
+        removeAt(first);
+        return true;
+    }
+
+    bool Table::scheduled(uint8_t command) const
+    {
+        for (size_t i = 0; i < used; i++)
+        {
+            if (entries[i].kind == Kind::Scheduled && entries[i].command == command)
+                return true;
+        }
+        return false;
+    }
+
+    size_t Table::count(Kind kind) const
+    {
+        size_t found = 0;
+        for (size_t i = 0; i < used; i++)
+        {
+            if (entries[i].kind == kind)
+                found++;
+        }
+        return found;
+    }
+
+    size_t Table::encode(uint32_t nowMillis, uint8_t *out) const
+    {
+        for (size_t i = 0; i < used; i++)
+        {
+            uint32_t left = isDue(entries[i], nowMillis) ? 0 : (entries[i].dueMillis - nowMillis + 999) / 1000;
+            uint8_t *entry = out + i * ENTRY_LENGTH;
+            entry[0] = entries[i].command;
+            entry[1] = static_cast<uint8_t>(entries[i].kind);
+            for (size_t b = 0; b < 4; b++)
+                entry[2 + b] = static_cast<uint8_t>(left >> (8 * b));
+        }
+        return used * ENTRY_LENGTH;
+    }
+
+    void Table::decode(const uint8_t *data, size_t length, uint32_t nowMillis)
+    {
+        used = 0;
+        for (size_t offset = 0; offset + ENTRY_LENGTH <= length && used < MAX_TIMERS; offset += ENTRY_LENGTH)
+        {
+            const uint8_t *entry = data + offset;
+            if (entry[1] > static_cast<uint8_t>(Kind::Shutoff))
+                continue;
+            uint32_t left = static_cast<uint32_t>(entry[2]) | static_cast<uint32_t>(entry[3]) << 8 |
+                            static_cast<uint32_t>(entry[4]) << 16 | static_cast<uint32_t>(entry[5]) << 24;
+            Kind kind = static_cast<Kind>(entry[1]);
+            if (left > MAX_DELAY_SECONDS || !hasRoom(kind) || (kind != Kind::Scheduled && pending(kind)))
+                continue;
+            entries[used++] = {entry[0], kind, nowMillis + left * 1000};
+        }
+    }
+
+    void Table::removeAt(size_t index)
+    {
+        for (size_t i = index; i + 1 < used; i++)
+            entries[i] = entries[i + 1];
+        used--;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef BLUETOOTH_TIMERS_H
+#define BLUETOOTH_TIMERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Commands the controller runs later by itself, so the app doesn't have to stay
+// awake to send them (UNLOCK_FOR, START_ENGINE_FOR, SCHEDULE). A small table,
+// encoded per timer (SCHEDULE answer, and the file that keeps it over a reboot):
+//
+//   uint8 command, uint8 kind, uint32 seconds left
+//
+// Due times are millis() based and the board has no clock, so after a reboot
+// there is no telling how late a saved timer is (the table is only saved when
+// it changes); the controller drops or expires them (setupBluetooth).
+// Independent of Arduino so host tools can replay it; not thread-safe, the
+// caller serializes.
+namespace timers
+{
+    static const size_t MAX_TIMERS = 8;
+    /// @brief Most Scheduled timers, a slot each stays free for the relock and
+    /// the shutoff so UNLOCK_FOR and START_ENGINE_FOR always get theirs
+    static const size_t MAX_SCHEDULED = MAX_TIMERS - 2;
+    /// @brief Length of one encoded timer
+    static const size_t ENTRY_LENGTH = 6;
+    /// @brief Longest delay of a timer, far from the wrap of millis()
+    static const uint32_t MAX_DELAY_SECONDS = 7 * 24 * 3600;
+
+    enum class Kind : uint8_t
+    {
+        Scheduled = 0, // SCHEDULE: runs whatever happens meanwhile
+        Relock = 1,    // UNLOCK_FOR: cancelled by any other lock change or an opened door
+        Shutoff = 2,   // START_ENGINE_FOR: cancelled by any other engine change
+    };
+
+    struct Timer
+    {
+        uint8_t command; // ClientCommand it runs
+        Kind kind;
+        uint32_t dueMillis;
+    };
+
+    class Table
+    {
+    public:
+        /// @brief Runs `command` in delayMillis, replaces the Relock or Shutoff
+        /// timer if there is one already. False if there is no room (hasRoom)
+        bool add(uint8_t command, Kind kind, uint32_t delayMillis, uint32_t nowMillis);
+        /// @brief True if add() would take a timer of this kind
+        bool hasRoom(Kind kind) const;
+        /// @brief Removes the timers of a kind, true if there were any
+        bool cancel(Kind kind);
+        /// @brief Removes the Scheduled timers of a command, true if there were any
+        bool cancelScheduled(uint8_t command);
+        /// @brief Makes every timer due at nowMillis
+        void expire(uint32_t nowMillis);
+        /// @brief Takes the timer out that is due first, false if none is due
+        bool takeDue(uint32_t nowMillis, Timer &due);
+
+        bool pending(Kind kind) const { return count(kind) > 0; }
+        /// @brief True if a Scheduled timer runs `command`
+        bool scheduled(uint8_t command) const;
+        size_t count(Kind kind) const;
+        size_t count() const { return used; }
+
+        /// @brief Writes count() timers (ENTRY_LENGTH each), seconds left rounded up
+        size_t encode(uint32_t nowMillis, uint8_t *out) const;
+        /// @brief Replaces the table with encoded timers, due from nowMillis on
+        void decode(const uint8_t *data, size_t length, uint32_t nowMillis);
+
+    private:
+        void removeAt(size_t index);
+
+        Timer entries[MAX_TIMERS];
+        size_t used = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef BLUETOOTH_TLV_H
+#define BLUETOOTH_TLV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "frame.h"
+
+// Compact tag-length-value payloads (SETTINGS), header-only so the firmware,
+// the host tools and the app's port (MobileApp/lib/utils/tlv.dart) share it:
+//
+//   uint8 version, then per field: uint8 tag, uint8 length, value (little-endian)
+//
+// A reader skips fields with tags it doesn't know by their length, so new
+// fields (tags) are added without changing TLV_VERSION or PROTOCOL_VERSION;
+// TLV_VERSION only changes if this layout itself does. A field is only used if
+// its value has the length its tag has.
+namespace tlv
+{
+    static const uint8_t TLV_VERSION = 1;
+    /// @brief Tag and length byte before every value
+    static const size_t FIELD_HEADER_LENGTH = 2;
+
+    /// @brief Bytes a field with a value of `valueLength` takes
+    constexpr size_t fieldLength(size_t valueLength)
+    {
+        return FIELD_HEADER_LENGTH + valueLength;
+    }
+
+    /// @brief Byte `index` of `value`, little-endian
+    constexpr uint8_t byteOf(uint32_t value, unsigned index)
+    {
+        return static_cast<uint8_t>(value >> (8 * index));
+    }
+
+    /// @brief Tags of the SETTINGS command and response (append only)
+    enum class Setting : uint8_t
+    {
+        TriggerRssi = 0x01,  // float dBm
+        DeadZone = 0x02,     // uint8 rough meters between trigger and release point
+        Cooldown = 0x03,     // float minutes
+        ProximityKey = 0x04, // uint8 0 off, 1 on
+        RssiFilter = 0x05,   // filter type byte, 2 floats (like RSSI_FILTER)
+        ReleaseRssi = 0x06,  // float dBm, only reported (follows from the two above)
+    };
+
+    struct Field
+    {
+        uint8_t tag;
+        frame::Payload value;
+    };
+
+    /// @brief Writes a version byte and fields into `out` (at most `capacity`
+    /// bytes), fields that don't fit anymore are left out and mark it overflowed
+    class Writer
+    {
+    public:
+        Writer(uint8_t *out, size_t capacity) : bytes(out), capacity(capacity), size(0), overflow(false)
+        {
+            if (capacity == 0)
+            {
+                overflow = true;
+                return;
+            }
+            bytes[size++] = TLV_VERSION;
+        }
+
+        bool put(uint8_t tag, const uint8_t *value, uint8_t length)
+        {
+            if (overflow || size + fieldLength(length) > capacity)
+            {
+                overflow = true;
+                return false;
+            }
+            bytes[size++] = tag;
+            bytes[size++] = length;
+            memcpy(bytes + size, value, length);
+            size += length;
+            return true;
+        }
+
+        bool putU8(Setting tag, uint8_t value)
+        {
+            return put(static_cast<uint8_t>(tag), &value, 1);
+        }
+
+        bool putU32(Setting tag, uint32_t value)
+        {
+            const uint8_t data[4] = {byteOf(value, 0), byteOf(value, 1), byteOf(value, 2), byteOf(value, 3)};
+            return put(static_cast<uint8_t>(tag), data, sizeof(data));
+        }
+
+        bool putF32(Setting tag, float value)
+        {
+            uint32_t word;
+            memcpy(&word, &value, sizeof(word));
+            return putU32(tag, word);
+        }
+
+        bool putBytes(Setting tag, const uint8_t *value, uint8_t length)
+        {
+            return put(static_cast<uint8_t>(tag), value, length);
+        }
+
+        size_t length() const { return size; }
+        bool overflowed() const { return overflow; }
+
+    private:
+        uint8_t *bytes;
+        size_t capacity;
+        size_t size;
+        bool overflow;
+    };
+
+    /// @brief Walks the fields of a payload in place
+    class Reader
+    {
+    public:
+        Reader(const uint8_t *data, size_t length) : bytes(data), size(length), position(1), cut(false) {}
+
+        /// @brief There is a version byte and it is one this reader understands
+        bool valid() const { return bytes != nullptr && size > 0 && bytes[0] == TLV_VERSION; }
+        uint8_t version() const { return bytes != nullptr && size > 0 ? bytes[0] : 0; }
+
+        /// @brief Next field, false at the end or if the last field was cut off
+        bool next(Field &field)
+        {
+            if (!valid() || position + FIELD_HEADER_LENGTH > size)
+            {
+                cut = valid() && position < size;
+                return false;
+            }
+            uint8_t length = bytes[position + 1];
+            if (position + fieldLength(length) > size)
+            {
+                cut = true;
+                return false;
+            }
+            field.tag = bytes[position];
+            field.value = frame::Payload(bytes + position + FIELD_HEADER_LENGTH, length);
+            position += fieldLength(length);
+            return true;
+        }
+
+        /// @brief The payload ended inside a field
+        bool truncated() const { return cut; }
+
+    private:
+        const uint8_t *bytes;
+        size_t size;
+        size_t position;
+        bool cut;
+    };
+}
+
+#endif
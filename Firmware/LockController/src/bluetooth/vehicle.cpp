@@ -0,0 +1,87 @@
+#include "vehicle.h"
+
+namespace vehicle
+{
+    namespace
+    {
+        enum class Guard : uint8_t
+        {
+            Always,
+            RecentTransition, // The device changed within repeatWindow
+            RecentCommand,    // A command changed the device within mergeWindow
+        };
+
+        struct Rule
+        {
+            Source source;
+            bool redundant; // The device already is in the requested state
+            Guard guard;
+            Outcome outcome;
+        };
+
+        const Rule RULES[] = {
+            {Source::Command, true, Guard::RecentTransition, Outcome::Redundant},
+            {Source::Command, true, Guard::Always, Outcome::Actuate},
+            {Source::Command, false, Guard::Always, Outcome::Actuate},
+            {Source::Proximity, false, Guard::RecentCommand, Outcome::Merged},
+            {Source::Proximity, false, Guard::Always, Outcome::Actuate},
+            {Source::AutoLock, false, Guard::Always, Outcome::Actuate},
+            {Source::Report, false, Guard::Always, Outcome::Record},
+            {Source::Timer, false, Guard::Always, Outcome::Actuate},
+        };
+    }
+
+    uint8_t Machine::bitOf(Device device)
+    {
+        switch (device)
+        {
+        case Device::Doors:
+            return state::Locked;
+        case Device::Engine:
+            return state::EngineOn;
+        case Device::Windows:
+            return state::WindowsOpen;
+        }
+        return 0;
+    }
+
+    void Machine::reset(uint8_t bits)
+    {
+        current = bits;
+        for (Last &entry : last)
+            entry.valid = false;
+    }
+
+    Decision Machine::request(Device device, bool on, Source source, uint32_t nowMillis)
+    {
+        const Last &previous = last[static_cast<uint8_t>(device)];
+        bool redundant = isOn(device) == on;
+
+        Outcome outcome = Outcome::Redundant;
+        for (const Rule &rule : RULES)
+        {
+            if (rule.source != source || rule.redundant != redundant)
+                continue;
+
+            bool holds = rule.guard == Guard::Always;
+            if (rule.guard == Guard::RecentTransition)
+                holds = previous.valid && nowMillis - previous.millis < settings.repeatWindow;
+            else if (rule.guard == Guard::RecentCommand)
+                holds = previous.valid && previous.source == Source::Command && nowMillis - previous.millis < settings.mergeWindow;
+            if (!holds)
+                continue;
+
+            outcome = rule.outcome;
+            break;
+        }
+
+        Decision decision = {outcome, lastSequence};
+        if (!decision.accepted())
+            return decision;
+
+        current = on ? current | bitOf(device) : current & ~bitOf(device);
+        last[static_cast<uint8_t>(device)] = {nowMillis, source, true};
+        decision.sequence = ++lastSequence;
+        return decision;
+    }
+}
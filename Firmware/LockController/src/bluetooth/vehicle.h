@@ -0,0 +1,102 @@
+#ifndef BLUETOOTH_VEHICLE_H
+#define BLUETOOTH_VEHICLE_H
+
+#include <stdint.h>
+#include "state.h"
+
+// Decides whether a request to lock/unlock, start/stop the engine or open/close
+// the windows actuates, by a table of rules per source (first match wins):
+//
+//   source    | request    | guard                                   | outcome
+//   Command   | already so | device changed within repeatWindow      | Redundant
+//   Command   | any        |                                         | Actuate
+//   Proximity | opposite   | a command changed it within mergeWindow | Merged
+//   Proximity | opposite   |                                         | Actuate
+//   AutoLock  | opposite   |                                         | Actuate
+//   Report    | opposite   |                                         | Record
+//   Timer     | opposite   |                                         | Actuate
+//   (no rule) |            |                                         | Redundant
+//
+// A repeated command after repeatWindow actuates again: without a sensor the
+// tracked state goes stale when the vehicle is locked another way (key fob,
+// lock cylinder). The proximity key doesn't undo what the app just did, it only
+// acts on zone changes, so a merged action isn't retried. A timer (timers.h)
+// finding the vehicle in its state already does nothing, like the other
+// sources besides a command. After a reboot the state is unknown, so
+// setupBluetooth resets to the opposite of what the restored timers lock, stop
+// or close, and they actuate. Every accepted transition (Actuate, Record) gets
+// the next sequence number. Independent of Arduino so host tools can replay
+// it; not thread-safe, the caller serializes.
+namespace vehicle
+{
+    enum class Device : uint8_t
+    {
+        Doors,   // on: locked
+        Engine,  // on: running
+        Windows, // on: open
+    };
+
+    enum class Source : uint8_t
+    {
+        Command,   // The app (or BATCH) asked for it
+        Proximity, // Zone change of the proximity key
+        AutoLock,  // Connection lost before the proximity key locked
+        Report,    // main.cpp reports what the vehicle did by itself (report*())
+        Timer,     // A timer of UNLOCK_FOR, START_ENGINE_FOR or SCHEDULE ran out
+    };
+
+    enum class Outcome : uint8_t
+    {
+        Actuate,   // Pulse the relay and tell the app
+        Record,    // Only take the new state, nothing to pulse
+        Redundant, // It already is in that state
+        Merged,    // Opposes a command that just happened, dropped
+    };
+
+    struct Decision
+    {
+        Outcome outcome;
+        uint32_t sequence; // Of this transition, or of the last one if dropped
+
+        bool accepted() const { return outcome == Outcome::Actuate || outcome == Outcome::Record; }
+    };
+
+    struct MachineConfig
+    {
+        uint32_t repeatWindow; // ms after a transition a repeated command is redundant
+        uint32_t mergeWindow;  // ms after a command an opposing proximity action is merged
+    };
+
+    class Machine
+    {
+    public:
+        void configure(const MachineConfig &config) { settings = config; }
+
+        /// @brief Starts over with the state bits (state::Bit), forgetting the
+        /// transitions but not the sequence number
+        void reset(uint8_t bits);
+        /// @brief Decides a request at nowMillis and takes its state if accepted
+        Decision request(Device device, bool on, Source source, uint32_t nowMillis);
+
+        bool isOn(Device device) const { return (current & bitOf(device)) != 0; }
+        uint8_t bits() const { return current; }
+        uint32_t sequence() const { return lastSequence; }
+
+        static uint8_t bitOf(Device device);
+
+    private:
+        struct Last
+        {
+            uint32_t millis;
+            Source source;
+            bool valid;
+        };
+
+        MachineConfig settings = {0, 0};
+        uint8_t current = state::Locked;
+        uint32_t lastSequence = 0;
+        Last last[3] = {};
+    };
+}
+
+#endif
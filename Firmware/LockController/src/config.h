@@ -4,13 +4,70 @@
 // Features supported by the vehicle
 // Add `| Feature::Engine` and/or `| Feature::Windows` once you wired up the
 // matching relays and callbacks (onEngineStarted, onEngineStopped,
-// onWindowsOpened, onWindowsClosed) in main.cpp
-static const Feature SUPPORTED_FEATURES =
+// onWindowsOpened, onWindowsClosed) in main.cpp. Known at compile time, so the
+// code of the other features isn't part of the firmware. VEHICLE_FEATURES (the
+// bitmask, e.g. `-D VEHICLE_FEATURES=0x0F` in platformio.ini) overrides it
+#ifdef VEHICLE_FEATURES
+static constexpr Feature SUPPORTED_FEATURES = static_cast<Feature>(VEHICLE_FEATURES);
+#else
+static constexpr Feature SUPPORTED_FEATURES =
     Feature::DoorsLock | Feature::TrunkOpen;
+#endif
 
 // Bluetooth display name of the device
 #define DEVICE_NAME "ESP32_Lock"
 // Please change to something unique (can also be longer)
 #define PASSWORD "abc123"
-// Enable to get debug messages via serial
-#define DEBUG_MODE true
\ No newline at end of file
+// Free heap and largest allocatable block (in bytes) below which a memory
+// alert is printed via serial and sent to the app
+#define MEMORY_ALERT_FREE_HEAP 16384
+#define MEMORY_ALERT_LARGEST_BLOCK 8192
+// Proximity key timing in ms: how long the phone has to stay above the trigger
+// RSSI before unlocking (the extra unlock latency), how long below the release
+// RSSI before locking, and the minimum time between two proximity actions (the
+// cooldown set in the app applies on top of it)
+#define PROXIMITY_UNLOCK_DWELL 1000
+#define PROXIMITY_LOCK_DWELL 3000
+#define PROXIMITY_MIN_ACTION_INTERVAL 5000
+// When the RSSI trend says the phone reaches the trigger RSSI within this many
+// ms, the fast connection interval is requested and onApproaching is called
+#define PROXIMITY_PREARM_HORIZON 3000
+// Unlock ahead of time on a clear approach by deciding on the RSSI the trend
+// expects this many ms later (0 only unlocks on the measured RSSI)
+#define PROXIMITY_PREDICT_AHEAD 0
+// Vehicle state machine timing in ms: a command the vehicle already is in the
+// state of actuates nothing within VEHICLE_REPEAT_WINDOW after that state was
+// reached (later it actuates again, the tracked state may be stale without a
+// sensor), and a proximity action opposing a command within
+// VEHICLE_MERGE_WINDOW before is dropped
+#define VEHICLE_REPEAT_WINDOW 30000
+#define VEHICLE_MERGE_WINDOW 1500
+// Longest runtime in s START_ENGINE_FOR accepts, longer ones are cut to it
+#define ENGINE_MAX_RUNTIME 900
+// Bounds of the time between two RSSI readings in ms while the proximity key is
+// on: the minimum close to the trigger/release RSSI or while the phone moves
+// towards it, up to the maximum the further away from both it is
+#define RSSI_INTERVAL_MIN 500
+#define RSSI_INTERVAL_MAX 2000
+// Scan for the phone's presence token while it is not connected (only after it
+// disconnected with the proximity key on), so the approach is seen before the
+// connection is up. The scan listens PRESENCE_SCAN_WINDOW of every
+// PRESENCE_SCAN_INTERVAL ms, after PRESENCE_IDLE_AFTER ms without a token only
+// every PRESENCE_IDLE_INTERVAL ms
+#ifndef PRESENCE_SCAN
+#define PRESENCE_SCAN false
+#endif
+#define PRESENCE_SCAN_WINDOW 100
+#define PRESENCE_SCAN_INTERVAL 1000
+#define PRESENCE_IDLE_INTERVAL 5000
+#define PRESENCE_IDLE_AFTER 300000
+// Log messages up to this level are compiled in, everything below is removed:
+// LOG_LEVEL_NONE, LOG_LEVEL_ERROR, LOG_LEVEL_WARN, LOG_LEVEL_INFO or LOG_LEVEL_DEBUG
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+// Enable to get the log messages as text via serial (printed from the loop
+// without blocking, send `lg` via serial for a binary dump instead)
+#ifndef DEBUG_MODE
+#define DEBUG_MODE true
+#endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "format.h"
+#include "bluetooth/commands.h"
+
+namespace logging
+{
+    namespace
+    {
+        const char *const formats[] = {
+#define LOG_MESSAGE(id, format) format,
+#include "messages.h"
+#undef LOG_MESSAGE
+        };
+
+        // Appends to out like snprintf, but never past maxLength
+        size_t append(char *out, size_t length, size_t maxLength, const char *spec, ...) __attribute__((format(printf, 4, 5)));
+
+        size_t append(char *out, size_t length, size_t maxLength, const char *spec, ...)
+        {
+            if (length >= maxLength)
+                return length;
+
+            va_list args;
+            va_start(args, spec);
+            int written = vsnprintf(out + length, maxLength - length, spec, args);
+            va_end(args);
+
+            if (written < 0)
+                return length;
+            return length + written < maxLength ? length + written : maxLength - 1;
+        }
+    }
+
+    const char *messageFormat(uint8_t id)
+    {
+        return id < static_cast<uint8_t>(LogId::Count) ? formats[id] : nullptr;
+    }
+
+    const char *levelName(uint8_t level)
+    {
+        switch (level)
+        {
+        case LOG_LEVEL_ERROR: return "E";
+        case LOG_LEVEL_WARN:  return "W";
+        case LOG_LEVEL_INFO:  return "I";
+        default:              return "D";
+        }
+    }
+
+    size_t formatMessage(const Record &record, char *out, size_t maxLength)
+    {
+        if (maxLength == 0)
+            return 0;
+        out[0] = '\0';
+
+        const char *format = messageFormat(record.id);
+        if (format == nullptr)
+            return append(out, 0, maxLength, "Unknown log message %u", record.id);
+
+        uint8_t argCount = record.meta & 0x0F;
+        uint8_t argIndex = 0;
+        size_t length = 0;
+
+        for (const char *p = format; *p != '\0' && length < maxLength - 1; p++)
+        {
+            if (*p != '%')
+            {
+                out[length++] = *p;
+                out[length] = '\0';
+                continue;
+            }
+
+            // Copy the conversion spec (flags, width, precision) up to its type
+            char spec[16];
+            size_t specLength = 0;
+            spec[specLength++] = *p++;
+            while (*p != '\0' && strchr("-+ #0123456789.", *p) && specLength < sizeof(spec) - 3)
+                spec[specLength++] = *p++;
+            if (*p == '\0')
+                break;
+
+            char type = *p;
+            if (type == '%')
+            {
+                length = append(out, length, maxLength, "%%");
+                continue;
+            }
+
+            uint32_t word = argIndex < argCount ? record.args[argIndex] : 0;
+            argIndex++;
+
+            switch (type)
+            {
+            case 'C':
+                length = append(out, length, maxLength, "%s", toString(static_cast<ClientCommand>(word)));
+                break;
+            case 'd':
+            case 'i':
+                spec[specLength++] = 'd';
+                spec[specLength] = '\0';
+                length = append(out, length, maxLength, spec, static_cast<int32_t>(word));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'c':
+                spec[specLength++] = type;
+                spec[specLength] = '\0';
+                length = append(out, length, maxLength, spec, static_cast<unsigned>(word));
+                break;
+            case 'f':
+            case 'e':
+            case 'g':
+            {
+                float value;
+                memcpy(&value, &word, sizeof(value));
+                spec[specLength++] = type;
+                spec[specLength] = '\0';
+                length = append(out, length, maxLength, spec, static_cast<double>(value));
+            }
+            break;
+            default:
+                length = append(out, length, maxLength, "?");
+                break;
+            }
+        }
+
+        return length;
+    }
+
+    size_t formatRecord(const Record &record, char *out, size_t maxLength)
+    {
+        size_t length = append(out, 0, maxLength, "[%6lu.%03lu] %s ",
+                               (unsigned long)(record.timestamp / 1000000),
+                               (unsigned long)(record.timestamp / 1000 % 1000),
+                               levelName(record.meta >> 4));
+        return length + formatMessage(record, out + length, maxLength - length);
+    }
+}
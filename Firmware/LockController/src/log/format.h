@@ -0,0 +1,53 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+// Binary log record layout and its text formatting. Shared by the firmware
+// and the host decoder (tools/log_decoder), so no Arduino dependencies here.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/// @brief Version of the record layout and message table, printed in every dump
+#define LOG_FORMAT_VERSION 1
+
+namespace logging
+{
+    enum class LogId : uint8_t
+    {
+#define LOG_MESSAGE(id, format) id,
+#include "messages.h"
+#undef LOG_MESSAGE
+        Count
+    };
+
+    static const uint8_t MAX_ARGS = 3;
+
+    /// @brief One log message as it is kept in the ring and dumped (20 bytes, little-endian)
+    struct Record
+    {
+        uint32_t timestamp; // micros() when it was logged
+        uint16_t sequence;  // Low 16 bits of its position in the ring
+        uint8_t id;         // LogId
+        uint8_t meta;       // Level << 4 | number of arguments
+        uint32_t args[MAX_ARGS];
+    };
+    static_assert(sizeof(Record) == 20, "Log records are dumped as 20 bytes");
+
+    /// @brief Format string of a message (nullptr for unknown IDs)
+    const char *messageFormat(uint8_t id);
+    /// @brief "E", "W", "I" or "D"
+    const char *levelName(uint8_t level);
+
+    /// @brief Formats the message of a record (without timestamp/level) into out
+    size_t formatMessage(const Record &record, char *out, size_t maxLength);
+    /// @brief Formats a whole line: `[seconds] L message`
+    size_t formatRecord(const Record &record, char *out, size_t maxLength);
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <atomic>
+#include "log.h"
+
+namespace logging
+{
+    namespace
+    {
+        static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE must be a power of two");
+
+        Record ring[RING_SIZE];
+        // Per slot: 2 * position + 1 while a writer fills it, 2 * position + 2
+        // once it is complete, so readers can tell stale, torn and valid slots apart
+        std::atomic<uint32_t> stamps[RING_SIZE];
+        std::atomic<uint32_t> head(0); // Next position to be claimed
+
+        uint32_t printPosition = 0;
+
+        // Copies the record at position if it is complete and wasn't overwritten meanwhile
+        bool read(uint32_t position, Record &out)
+        {
+            std::atomic<uint32_t> &stamp = stamps[position & (RING_SIZE - 1)];
+            uint32_t expected = 2 * position + 2;
+
+            if (stamp.load(std::memory_order_acquire) != expected)
+                return false;
+            out = ring[position & (RING_SIZE - 1)];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return stamp.load(std::memory_order_relaxed) == expected;
+        }
+
+        uint32_t oldestPosition(uint32_t end)
+        {
+            return end > RING_SIZE ? end - RING_SIZE : 0;
+        }
+    }
+
+    void write(LogId id, uint8_t level, uint8_t argCount, const uint32_t *args)
+    {
+        uint32_t position = head.fetch_add(1, std::memory_order_relaxed);
+        std::atomic<uint32_t> &stamp = stamps[position & (RING_SIZE - 1)];
+        Record &record = ring[position & (RING_SIZE - 1)];
+
+        stamp.store(2 * position + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        record.timestamp = micros();
+        record.sequence = static_cast<uint16_t>(position);
+        record.id = static_cast<uint8_t>(id);
+        record.meta = static_cast<uint8_t>(level << 4 | argCount);
+        memcpy(record.args, args, sizeof(record.args));
+
+        stamp.store(2 * position + 2, std::memory_order_release);
+    }
+
+    void printPending()
+    {
+        uint32_t end = head.load(std::memory_order_acquire);
+        if (end - printPosition > RING_SIZE)
+        {
+            Serial.printf("... %u log messages dropped\n", (unsigned)(end - RING_SIZE - printPosition));
+            printPosition = end - RING_SIZE;
+        }
+
+        char line[160];
+        while (printPosition != end)
+        {
+            Record record;
+            if (!read(printPosition, record))
+            {
+                // Claimed but not complete yet: try again next loop. Otherwise a
+                // writer of the next lap already overwrote it.
+                if (stamps[printPosition & (RING_SIZE - 1)].load(std::memory_order_acquire) < 2 * printPosition + 2)
+                    return;
+                printPosition++;
+                continue;
+            }
+
+            size_t length = formatRecord(record, line, sizeof(line) - 1);
+            line[length++] = '\n';
+            if (Serial.availableForWrite() < (int)length)
+                return; // Would block, the rest goes out in a later loop
+
+            Serial.write(reinterpret_cast<const uint8_t *>(line), length);
+            printPosition++;
+        }
+    }
+
+    size_t snapshot(Record *out, size_t maxRecords)
+    {
+        uint32_t end = head.load(std::memory_order_acquire);
+        uint32_t start = oldestPosition(end);
+        if (end - start > maxRecords)
+            start = end - maxRecords;
+
+        size_t count = 0;
+        for (uint32_t position = start; position != end; position++)
+        {
+            if (read(position, out[count]))
+                count++;
+        }
+        return count;
+    }
+
+    void dump()
+    {
+        static Record records[RING_SIZE];
+        size_t count = snapshot(records, RING_SIZE);
+
+        Serial.printf("#LOG v%u %u\n", LOG_FORMAT_VERSION, (unsigned)count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&records[i]);
+            char line[6 + 2 * sizeof(Record) + 2] = "#LOG ";
+            for (size_t b = 0; b < sizeof(Record); b++)
+                snprintf(line + 5 + 2 * b, 3, "%02x", bytes[b]);
+            Serial.println(line);
+        }
+    }
+}
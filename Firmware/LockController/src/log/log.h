@@ -0,0 +1,91 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Logging without formatting on the caller's task. Messages below LOG_LEVEL
+// (config.h) are compiled out completely (their arguments aren't evaluated
+// either), enabled ones are written as a binary Record (message ID, raw
+// arguments, timestamp) into a lock-free ring. The ring is turned into text
+// later: from loop() when DEBUG_MODE is on, or on the host from a dump (`lg`
+// via serial) with tools/log_decoder.
+//
+//   LOG_INFO(LOCKED, proximity);   // IDs and formats are in messages.h
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <config.h>
+#include "format.h"
+
+namespace logging
+{
+    /// @brief Number of records kept (power of two)
+    static const uint16_t RING_SIZE = 128;
+
+    /// @brief Claims a slot in the ring and fills it (safe from any task)
+    void write(LogId id, uint8_t level, uint8_t argCount, const uint32_t *args);
+
+    /// @brief Prints records that were not printed yet as text via serial, only
+    /// as much as fits into the serial TX buffer so it never blocks
+    void printPending();
+    /// @brief Dumps the whole ring via serial for tools/log_decoder:
+    /// `#LOG v<format version> <records>`, then one `#LOG <40 hex chars>` line per record
+    void dump();
+    /// @brief Copies up to maxRecords of the most recent records to out, oldest first
+    size_t snapshot(Record *out, size_t maxRecords);
+
+    inline uint32_t toWord(float value)
+    {
+        uint32_t word;
+        memcpy(&word, &value, sizeof(word));
+        return word;
+    }
+
+    inline uint32_t toWord(double value)
+    {
+        return toWord(static_cast<float>(value));
+    }
+
+    /// @brief Integers and enums (stored as 32 bit), pointers/strings intentionally don't compile
+    template <typename T>
+    inline uint32_t toWord(T value)
+    {
+        static_assert(!std::is_pointer<T>::value, "Log arguments can't be pointers or strings");
+        return static_cast<uint32_t>(value);
+    }
+
+    template <typename... Args>
+    inline void log(LogId id, uint8_t level, Args... args)
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "Log messages take at most 3 arguments");
+        const uint32_t words[MAX_ARGS > sizeof...(Args) ? MAX_ARGS : sizeof...(Args)] = {toWord(args)...};
+        write(id, level, sizeof...(Args), words);
+    }
+}
+
+#define LOG_AT(level, id, ...) logging::log(logging::LogId::id, level, ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(id, ...) LOG_AT(LOG_LEVEL_ERROR, id, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(id, ...) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(id, ...) LOG_AT(LOG_LEVEL_WARN, id, ##__VA_ARGS__)
+#else
+#define LOG_WARN(id, ...) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(id, ...) LOG_AT(LOG_LEVEL_INFO, id, ##__VA_ARGS__)
+#else
+#define LOG_INFO(id, ...) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(id, ...) LOG_AT(LOG_LEVEL_DEBUG, id, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(id, ...) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+// Log message table: LOG_MESSAGE(id, format)
+//
+// The position of a message is its ID in the binary log records, so only ever
+// append to this list (the host decoder in tools/log_decoder uses the same table).
+// Every argument is stored as 4 raw bytes, so formats may only use integer,
+// character and floating point conversions, plus `%C` for a ClientCommand name.
+
+// clang-format off
+LOG_MESSAGE(RESPONSE_TRUNCATED,     "Warning: data truncated to %u bytes.")
+LOG_MESSAGE(RESPONSE_SENT,          "Sent ESP32 Response: 0x%02X, Data Length: %u")
+LOG_MESSAGE(LOCKED,                 "Locked (proximity:%u)")
+LOG_MESSAGE(UNLOCKED,               "Unlocked (proximity:%u)")
+LOG_MESSAGE(ENGINE_STARTED,         "Engine started")
+LOG_MESSAGE(ENGINE_STOPPED,         "Engine stopped")
+LOG_MESSAGE(WINDOWS_OPENED,         "Windows opened")
+LOG_MESSAGE(WINDOWS_CLOSED,         "Windows closed")
+LOG_MESSAGE(CONNECTED,              "Connected")
+LOG_MESSAGE(DISCONNECTED,           "Disconnected")
+LOG_MESSAGE(EMPTY_VALUE,            "Received empty value.")
+LOG_MESSAGE(FRAME_TOO_SHORT,        "Received malformed client command: too short (%u bytes).")
+LOG_MESSAGE(FRAME_LENGTH_MISMATCH,  "Malformed data: advertised length %u exceeds actual data.")
+LOG_MESSAGE(INVALID_HMAC,           "Received invalid HMAC. Tested counters: %u-%u")
+LOG_MESSAGE(COMMAND_RECEIVED,       "Received command: %C (0x%02X) with %u bytes of data")
+LOG_MESSAGE(MISSING_DATA,           "No data for command %C")
+LOG_MESSAGE(RSSI_TRIGGER_SET,       "Trigger RSSI set: %.2f, release RSSI set: %.2f")
+LOG_MESSAGE(PROXIMITY_COOLDOWN_SET, "Proximity cooldown set: %.2f")
+LOG_MESSAGE(CONN_PARAMS_REQUESTED,  "Requested low-power connection parameters")
+LOG_MESSAGE(BOOT_BUTTON_PRESSED,    "BOOT Pressed. hold for 5 seconds to reset rolling code counter")
+LOG_MESSAGE(COUNTER_RESET,          "Resetting rolling code counter")
+LOG_MESSAGE(LOW_MEMORY,             "Warning: low memory (free heap: %u, largest block: %u)")
+LOG_MESSAGE(RSSI_FILTER_SET,        "RSSI filter set: type %u (%.2f, %.2f)")
+LOG_MESSAGE(RSSI_FILTER_INVALID,    "Invalid RSSI filter: type %u (%.2f, %.2f)")
+LOG_MESSAGE(PROXIMITY_ZONE,         "Proximity zone: %u (RSSI %.1f)")
+LOG_MESSAGE(APPROACH_ARMED,         "Approach expected (%.1f dB/s, R2 %.2f), fast connection interval requested")
+LOG_MESSAGE(APPROACH_DISARMED,      "Approach over")
+LOG_MESSAGE(CALIBRATION_STARTED,    "Range calibration started for %.0f s")
+LOG_MESSAGE(CALIBRATION_DONE,       "Range calibrated from %u readings: trigger RSSI %.1f, release RSSI %.1f")
+LOG_MESSAGE(CALIBRATION_FAILED,     "Range calibration failed: only %u readings")
+LOG_MESSAGE(CALIBRATION_CLEARED,    "Range calibration cleared")
+LOG_MESSAGE(RSSI_TRIGGER_CALIBRATED, "Keeping calibrated trigger RSSI %.1f, release RSSI %.1f")
+LOG_MESSAGE(PRESENCE_SCAN_STARTED,  "Presence scan started (%u of %u ms)")
+LOG_MESSAGE(PRESENCE_SCAN_STOPPED,  "Presence scan stopped")
+LOG_MESSAGE(PRESENCE_ZONE,          "Presence zone: %u (RSSI %.1f)")
+LOG_MESSAGE(PRESENCE_APPROACH,      "Approach seen in advertisements (RSSI %.1f)")
+LOG_MESSAGE(PHONE_RSSI_RECEIVED,    "Phone RSSI: %u samples, weight %.2f, offset %.1f dB")
+LOG_MESSAGE(RSSI_STREAM_STARTED,    "RSSI stream: every %u ms for %u s")
+LOG_MESSAGE(RSSI_STREAM_STOPPED,    "RSSI stream ended")
+LOG_MESSAGE(UNKNOWN_COMMAND,        "Unknown command 0x%02X")
+LOG_MESSAGE(COMMAND_UNSUPPORTED,    "Command %C needs a feature the vehicle doesn't support")
+LOG_MESSAGE(INVALID_PAYLOAD,        "Invalid data for command %C: %u bytes")
+LOG_MESSAGE(SETTINGS_APPLIED,       "Settings: %u applied, %u skipped")
+LOG_MESSAGE(SETTINGS_INVALID,       "Settings rejected: TLV version %u")
+LOG_MESSAGE(BATCH_DONE,             "Batch: %u commands ran")
+LOG_MESSAGE(BATCH_REJECTED,         "Batch rejected at command %u: status %u")
+LOG_MESSAGE(TRANSITION,             "Transition %u: device %u -> %u")
+LOG_MESSAGE(ACTION_DROPPED,         "Dropped device %u -> %u (outcome %u)")
+LOG_MESSAGE(TIMER_SET,              "Timer: %C in %u s (kind %u)")
+LOG_MESSAGE(TIMER_REJECTED,         "Timer rejected: %C in %u s")
+LOG_MESSAGE(TIMER_RAN,              "Timer ran: %C (kind %u)")
+LOG_MESSAGE(TIMERS_RESTORED,        "Restored %u timers, dropped %u")
+// clang-format on
@@ -1,12 +1,23 @@
 // Lock Controller code for ESP32 (Not tested yet!)
 #include <Arduino.h>
 #include "bluetooth/bluetooth.h"
+#include "telemetry/memory.h"
+#include "telemetry/trace.h"
+#include "log/log.h"
 #include "config.h"
 
 // Pin definitions
 const int doorsRelayPin1 = 25;
 const int doorsRelayPin2 = 26;
 const int trunkRelayPin1 = 27;
+// Only used if the feature is in SUPPORTED_FEATURES (config.h)
+const int engineRelayPin1 = 32;
+const int windowsRelayPin1 = 33;
+const int windowsRelayPin2 = 13;
+
+// The code of features the vehicle doesn't support is compiled out
+constexpr bool hasEngine = hasFeature(SUPPORTED_FEATURES, Feature::Engine);
+constexpr bool hasWindows = hasFeature(SUPPORTED_FEATURES, Feature::Windows);
 
 void openTrunk()
 {
@@ -36,6 +47,12 @@ void closeWindows()
   // Custom code to close the windows
 }
 
+void prepareUnlock()
+{
+  // Custom code to get ready for a proximity unlock that is expected soon
+  // (e.g. wake up or power the actuator)
+}
+
 void unlock(bool proximity)
 {
   digitalWrite(doorsRelayPin1, LOW);
@@ -61,33 +78,58 @@ void checkSerial()
   if (Serial.available() > 0)
   {
     String data = Serial.readStringUntil('\n');
+    // Actuated here, past the controller: report the new state so a
+    // connected app learns about it
     if (data == "ld")
     {
       lock(false);
+      reportLocked(true);
     }
     else if (data == "ud")
     {
       unlock(false);
+      reportLocked(false);
     }
     else if (data == "ut")
     {
       openTrunk();
     }
-    else if (data == "se")
+    else if (hasEngine && data == "se")
     {
       startEngine();
+      reportEngine(true);
     }
-    else if (data == "pe")
+    else if (hasEngine && data == "pe")
     {
       stopEngine();
+      reportEngine(false);
     }
-    else if (data == "ow")
+    else if (hasWindows && data == "ow")
     {
       openWindows();
+      reportWindows(true);
     }
-    else if (data == "cw")
+    else if (hasWindows && data == "cw")
     {
       closeWindows();
+      reportWindows(false);
+    }
+    else if (data == "do")
+    {
+      // What a door sensor would report (cancels the relock of UNLOCK_FOR)
+      reportDoorOpened();
+    }
+    else if (data == "ms")
+    {
+      telemetry::printMemorySamples();
+    }
+    else if (data == "lg")
+    {
+      logging::dump();
+    }
+    else if (data == "tr")
+    {
+      telemetry::dumpTrace();
     }
   }
 }
@@ -98,16 +140,23 @@ void setup()
   pinMode(doorsRelayPin1, OUTPUT);
   pinMode(doorsRelayPin2, OUTPUT);
   pinMode(trunkRelayPin1, OUTPUT);
-  pinMode(engineRelayPin1, OUTPUT);
-  pinMode(windowsRelayPin1, OUTPUT);
-  pinMode(windowsRelayPin2, OUTPUT);
 
   digitalWrite(doorsRelayPin1, HIGH); // You might need to swap high and low depending on if your relays are active low
   digitalWrite(doorsRelayPin2, HIGH);
   digitalWrite(trunkRelayPin1, HIGH);
-  digitalWrite(engineRelayPin1, HIGH);
-  digitalWrite(windowsRelayPin1, HIGH);
-  digitalWrite(windowsRelayPin2, HIGH);
+
+  if (hasEngine)
+  {
+    pinMode(engineRelayPin1, OUTPUT);
+    digitalWrite(engineRelayPin1, HIGH);
+  }
+  if (hasWindows)
+  {
+    pinMode(windowsRelayPin1, OUTPUT);
+    pinMode(windowsRelayPin2, OUTPUT);
+    digitalWrite(windowsRelayPin1, HIGH);
+    digitalWrite(windowsRelayPin2, HIGH);
+  }
 
   Serial.begin(115200);
 
@@ -116,10 +165,17 @@ void setup()
   onLocked = lock;
   onUnlocked = unlock;
   onTrunkOpened = openTrunk;
-  onEngineStarted = startEngine;
-  onEngineStopped = stopEngine;
-  onWindowsOpened = openWindows;
-  onWindowsClosed = closeWindows;
+  if (hasEngine)
+  {
+    onEngineStarted = startEngine;
+    onEngineStopped = stopEngine;
+  }
+  if (hasWindows)
+  {
+    onWindowsOpened = openWindows;
+    onWindowsClosed = closeWindows;
+  }
+  onApproaching = prepareUnlock;
 
   if (DEBUG_MODE)
     Serial.println("BLE Lock Controller Ready");
@@ -0,0 +1,29 @@
+#ifndef PROXIMITY_BYTES_H
+#define PROXIMITY_BYTES_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Floats on the wire (filter configs, calibration results): IEEE 754,
+// little-endian whatever the byte order of the board
+namespace proximity
+{
+    inline void putFloat(uint8_t *out, float value)
+    {
+        uint32_t word;
+        memcpy(&word, &value, sizeof(word));
+        for (int i = 0; i < 4; i++)
+            out[i] = (word >> (8 * i)) & 0xFF;
+    }
+
+    inline float getFloat(const uint8_t *data)
+    {
+        uint32_t word = static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+                        static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+        float value;
+        memcpy(&value, &word, sizeof(value));
+        return value;
+    }
+}
+
+#endif
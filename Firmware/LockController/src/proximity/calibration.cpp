@@ -0,0 +1,57 @@
+#include "calibration.h"
+#include "bytes.h"
+
+namespace proximity
+{
+    void Calibration::start(uint32_t durationMillis, uint32_t nowMillis)
+    {
+        low.reset();
+        lower.reset();
+        median.reset();
+        startMillis = nowMillis;
+        duration = durationMillis;
+        running = true;
+    }
+
+    void Calibration::add(float rssi)
+    {
+        if (!running)
+            return;
+        low.add(rssi);
+        lower.add(rssi);
+        median.add(rssi);
+    }
+
+    bool Calibration::due(uint32_t nowMillis) const
+    {
+        return running && nowMillis - startMillis >= duration;
+    }
+
+    bool Calibration::finish(CalibrationResult &result)
+    {
+        running = false;
+
+        result.readings = median.count() > 0xFFFF ? 0xFFFF : median.count();
+        result.low = low.value();
+        result.lower = lower.value();
+        result.median = median.value();
+        if (result.readings < CALIBRATION_MIN_READINGS)
+            return false;
+
+        result.trigger = result.lower;
+        result.release = result.low - (result.median - result.low);
+        if (result.release > result.trigger - CALIBRATION_MIN_GAP)
+            result.release = result.trigger - CALIBRATION_MIN_GAP;
+        return true;
+    }
+
+    size_t encodeCalibrationResult(const CalibrationResult &result, uint8_t *out)
+    {
+        const float values[] = {result.trigger, result.release, result.low, result.lower, result.median};
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+            putFloat(out + 4 * i, values[i]);
+        out[20] = result.readings & 0xFF;
+        out[21] = result.readings >> 8;
+        return CALIBRATION_RESULT_LENGTH;
+    }
+}
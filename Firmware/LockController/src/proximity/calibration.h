@@ -0,0 +1,61 @@
+#ifndef PROXIMITY_CALIBRATION_H
+#define PROXIMITY_CALIBRATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "quantile.h"
+
+// Range calibration: the phone is held at the spot where the vehicle should
+// unlock while the raw RSSI readings are collected. Trigger and release RSSI
+// are then taken from their distribution (streaming quantiles, so constant
+// memory however long it runs):
+//
+//   trigger = 25% quantile            (above it most of the time at the spot)
+//   release = 5% quantile - (median - 5% quantile), at least
+//             CALIBRATION_MIN_GAP below the trigger
+namespace proximity
+{
+    /// @brief Fewest readings for a usable calibration
+    static const uint16_t CALIBRATION_MIN_READINGS = 10;
+    /// @brief Smallest distance of release below trigger RSSI in dB
+    static const float CALIBRATION_MIN_GAP = 6;
+    /// @brief Size of an encoded CalibrationResult
+    static const size_t CALIBRATION_RESULT_LENGTH = 22;
+
+    struct CalibrationResult
+    {
+        float trigger;
+        float release;
+        float low;    // 5% quantile
+        float lower;  // 25% quantile
+        float median;
+        uint16_t readings;
+    };
+
+    class Calibration
+    {
+    public:
+        void start(uint32_t durationMillis, uint32_t nowMillis);
+        void cancel() { running = false; }
+        bool active() const { return running; }
+
+        void add(float rssi);
+        /// @brief True once the duration passed (then call finish())
+        bool due(uint32_t nowMillis) const;
+        /// @brief Ends the calibration, false if there were too few readings
+        bool finish(CalibrationResult &result);
+
+    private:
+        P2Quantile low = P2Quantile(0.05f);
+        P2Quantile lower = P2Quantile(0.25f);
+        P2Quantile median = P2Quantile(0.5f);
+        uint32_t startMillis = 0;
+        uint32_t duration = 0;
+        bool running = false;
+    };
+
+    /// @brief `float trigger, float release, float 5% / 25% / 50% quantile, uint16 readings` (little-endian)
+    size_t encodeCalibrationResult(const CalibrationResult &result, uint8_t *out);
+}
+
+#endif
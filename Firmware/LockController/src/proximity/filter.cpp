@@ -0,0 +1,219 @@
+#include "filter.h"
+#include "bytes.h"
+
+namespace proximity
+{
+    namespace
+    {
+        MovingAverageFilter movingAverage;
+        ExponentialFilter exponential;
+        MedianFilter median;
+        KalmanFilter kalman;
+
+        // Same smoothing as before the filters were selectable
+        FilterConfig config = {FilterType::MovingAverage, 5, 0};
+        RssiFilter *active = &movingAverage;
+
+        // A whole number of readings, a fraction would be cut off but reported back
+        bool validWindow(float window)
+        {
+            return window >= 1 && window <= MAX_FILTER_WINDOW && static_cast<uint8_t>(window) == window;
+        }
+    }
+
+    bool MovingAverageFilter::configure(uint8_t window)
+    {
+        if (!validWindow(window))
+            return false;
+        this->window = window;
+        reset();
+        return true;
+    }
+
+    float MovingAverageFilter::update(float rssi)
+    {
+        if (count == window)
+            sum -= samples[index];
+        else
+            count++;
+
+        samples[index] = rssi;
+        sum += rssi;
+        index = (index + 1) % window;
+        return sum / count;
+    }
+
+    void MovingAverageFilter::reset()
+    {
+        index = 0;
+        count = 0;
+        sum = 0;
+    }
+
+    bool ExponentialFilter::configure(float alpha)
+    {
+        if (!(alpha > 0 && alpha <= 1))
+            return false;
+        this->alpha = alpha;
+        reset();
+        return true;
+    }
+
+    float ExponentialFilter::update(float rssi)
+    {
+        if (!primed)
+        {
+            value = rssi;
+            primed = true;
+        }
+        else
+        {
+            value += alpha * (rssi - value);
+        }
+        return value;
+    }
+
+    void ExponentialFilter::reset()
+    {
+        primed = false;
+    }
+
+    bool MedianFilter::configure(uint8_t window)
+    {
+        if (!validWindow(window))
+            return false;
+        this->window = window;
+        reset();
+        return true;
+    }
+
+    float MedianFilter::update(float rssi)
+    {
+        if (count == window)
+        {
+            // Drop the oldest reading from the sorted values
+            float oldest = samples[index];
+            uint8_t position = 0;
+            while (sorted[position] != oldest)
+                position++;
+            memmove(&sorted[position], &sorted[position + 1], (count - position - 1) * sizeof(float));
+            count--;
+        }
+
+        uint8_t position = count;
+        while (position > 0 && sorted[position - 1] > rssi)
+        {
+            sorted[position] = sorted[position - 1];
+            position--;
+        }
+        sorted[position] = rssi;
+        count++;
+
+        samples[index] = rssi;
+        index = (index + 1) % window;
+
+        if (count % 2 == 1)
+            return sorted[count / 2];
+        return (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    }
+
+    void MedianFilter::reset()
+    {
+        index = 0;
+        count = 0;
+    }
+
+    bool KalmanFilter::configure(float processNoise, float measurementNoise)
+    {
+        if (!(processNoise > 0) || !(measurementNoise > 0))
+            return false;
+        this->processNoise = processNoise;
+        this->measurementNoise = measurementNoise;
+        reset();
+        return true;
+    }
+
+    float KalmanFilter::update(float rssi)
+    {
+        if (!primed)
+        {
+            estimate = rssi;
+            errorCovariance = measurementNoise;
+            primed = true;
+            return estimate;
+        }
+
+        errorCovariance += processNoise;
+        float gain = errorCovariance / (errorCovariance + measurementNoise);
+        estimate += gain * (rssi - estimate);
+        errorCovariance *= 1 - gain;
+        return estimate;
+    }
+
+    void KalmanFilter::reset()
+    {
+        primed = false;
+    }
+
+    bool configureFilter(const FilterConfig &newConfig)
+    {
+        RssiFilter *filter = nullptr;
+        bool valid = false;
+
+        switch (newConfig.type)
+        {
+        case FilterType::MovingAverage:
+            valid = validWindow(newConfig.first) && movingAverage.configure(static_cast<uint8_t>(newConfig.first));
+            filter = &movingAverage;
+            break;
+        case FilterType::Exponential:
+            valid = exponential.configure(newConfig.first);
+            filter = &exponential;
+            break;
+        case FilterType::Median:
+            valid = validWindow(newConfig.first) && median.configure(static_cast<uint8_t>(newConfig.first));
+            filter = &median;
+            break;
+        case FilterType::Kalman:
+            valid = kalman.configure(newConfig.first, newConfig.second);
+            filter = &kalman;
+            break;
+        }
+
+        if (!valid)
+            return false;
+
+        config = newConfig;
+        active = filter;
+        return true;
+    }
+
+    const FilterConfig &filterConfig()
+    {
+        return config;
+    }
+
+    RssiFilter &activeFilter()
+    {
+        return *active;
+    }
+
+    size_t encodeFilterConfig(const FilterConfig &config, uint8_t *out)
+    {
+        out[0] = static_cast<uint8_t>(config.type);
+        putFloat(out + 1, config.first);
+        putFloat(out + 5, config.second);
+        return FILTER_CONFIG_LENGTH;
+    }
+
+    bool decodeFilterConfig(const uint8_t *data, size_t length, FilterConfig &config)
+    {
+        if (data == nullptr || length < FILTER_CONFIG_LENGTH || data[0] > static_cast<uint8_t>(FilterType::Kalman))
+            return false;
+
+        config.type = static_cast<FilterType>(data[0]);
+        config.first = getFloat(data + 1);
+        config.second = getFloat(data + 5);
+        return true;
+    }
+}
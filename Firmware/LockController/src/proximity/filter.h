@@ -0,0 +1,122 @@
+#ifndef RSSI_FILTER_H
+#define RSSI_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Filters that smooth the raw RSSI readings before they are compared to the
+// proximity thresholds. One instance of every type is kept, the active one is
+// picked (and tuned) at runtime with RSSI_FILTER. No heap allocation and no
+// dependency on Arduino, so tools/rssi_filters runs the same code on traces.
+namespace proximity
+{
+    enum class FilterType : uint8_t
+    {
+        MovingAverage = 0x00, // first: window (a whole number)
+        Exponential   = 0x01, // first: alpha (0, 1]
+        Median        = 0x02, // first: window (a whole number)
+        Kalman        = 0x03, // first: process noise, second: measurement noise (dB²)
+    };
+
+    /// @brief Longest window of the moving average and median filter
+    static const uint8_t MAX_FILTER_WINDOW = 16;
+
+    struct FilterConfig
+    {
+        FilterType type;
+        float first;
+        float second;
+    };
+
+    /// @brief Size of an encoded FilterConfig: `uint8 type, float first, float second`
+    /// (little-endian)
+    static const size_t FILTER_CONFIG_LENGTH = 9;
+
+    class RssiFilter
+    {
+    public:
+        virtual ~RssiFilter() {}
+        /// @brief Adds a reading and returns the filtered RSSI
+        virtual float update(float rssi) = 0;
+        /// @brief Forgets all readings (e.g. on a new connection)
+        virtual void reset() = 0;
+    };
+
+    /// @brief Mean of the last `window` readings, kept as a running sum
+    class MovingAverageFilter : public RssiFilter
+    {
+    public:
+        bool configure(uint8_t window);
+        float update(float rssi) override;
+        void reset() override;
+
+    private:
+        float samples[MAX_FILTER_WINDOW];
+        uint8_t window = 5;
+        uint8_t index = 0;
+        uint8_t count = 0;
+        float sum = 0;
+    };
+
+    /// @brief value += alpha * (rssi - value)
+    class ExponentialFilter : public RssiFilter
+    {
+    public:
+        bool configure(float alpha);
+        float update(float rssi) override;
+        void reset() override;
+
+    private:
+        float alpha = 0.3f;
+        float value = 0;
+        bool primed = false;
+    };
+
+    /// @brief Median of the last `window` readings, ignores single deep fades.
+    /// Keeps the window sorted next to the arrival order, so an update is one
+    /// removal and one insertion into at most MAX_FILTER_WINDOW values: O(window),
+    /// not O(1), but at 16 values that is cheaper than a two-heap or skip-list
+    /// structure would be (~30ns over the moving average on the host).
+    class MedianFilter : public RssiFilter
+    {
+    public:
+        bool configure(uint8_t window);
+        float update(float rssi) override;
+        void reset() override;
+
+    private:
+        float samples[MAX_FILTER_WINDOW]; // Arrival order
+        float sorted[MAX_FILTER_WINDOW];
+        uint8_t window = 5;
+        uint8_t index = 0;
+        uint8_t count = 0;
+    };
+
+    /// @brief 1-D Kalman filter with a constant RSSI model
+    class KalmanFilter : public RssiFilter
+    {
+    public:
+        bool configure(float processNoise, float measurementNoise);
+        float update(float rssi) override;
+        void reset() override;
+
+    private:
+        float processNoise = 0.5f;
+        float measurementNoise = 16.0f;
+        float estimate = 0;
+        float errorCovariance = 0;
+        bool primed = false;
+    };
+
+    /// @brief Makes config the active filter if its parameters are valid (the
+    /// filter starts empty), otherwise keeps the current one and returns false
+    bool configureFilter(const FilterConfig &config);
+    const FilterConfig &filterConfig();
+    RssiFilter &activeFilter();
+
+    size_t encodeFilterConfig(const FilterConfig &config, uint8_t *out);
+    /// @brief Returns false if length is too short or the type is unknown
+    bool decodeFilterConfig(const uint8_t *data, size_t length, FilterConfig &config);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "fusion.h"
+
+namespace proximity
+{
+    namespace
+    {
+        const float LEVEL_ALPHA = 0.3f;    // Smoothing of the phone samples
+        const float VARIANCE_ALPHA = 0.1f; // Of both directions
+        const float OFFSET_ALPHA = 0.05f;  // Per controller reading with fresh phone samples
+        const float MIN_VARIANCE = 1;      // dB², so a quiet direction can't take it all
+    }
+
+    void RssiFusion::reset()
+    {
+        phone = Channel();
+        weight = 0;
+    }
+
+    void RssiFusion::addPhone(float rssi, uint32_t atMillis)
+    {
+        if (phone.primed && static_cast<int32_t>(atMillis - phone.lastMillis) < 0)
+            return;
+
+        if (!phone.primed || atMillis - phone.lastMillis > FUSION_STALE_MILLIS)
+        {
+            // Smoothing over a gap would drag old samples into the new ones
+            phone.level = rssi;
+            phone.primed = true;
+        }
+        else
+        {
+            float deviation = rssi - phone.level;
+            phone.variance += VARIANCE_ALPHA * (deviation * deviation - phone.variance);
+            phone.level += LEVEL_ALPHA * deviation;
+        }
+        phone.lastMillis = atMillis;
+    }
+
+    float RssiFusion::fuse(float raw, float filtered, uint32_t nowMillis)
+    {
+        float deviation = raw - filtered;
+        local.variance += VARIANCE_ALPHA * (deviation * deviation - local.variance); // Its level is the filter's
+
+        uint32_t age = nowMillis - phone.lastMillis;
+        if (!phone.primed || static_cast<int32_t>(age) < 0)
+            age = 0;
+        if (!phone.primed || age > FUSION_STALE_MILLIS)
+        {
+            weight = 0;
+            return filtered;
+        }
+
+        float difference = phone.level - filtered;
+        if (!offsetPrimed)
+        {
+            phoneOffset = difference;
+            offsetPrimed = true;
+        }
+        else
+        {
+            phoneOffset += OFFSET_ALPHA * (difference - phoneOffset);
+        }
+
+        float localConfidence = 1 / (local.variance > MIN_VARIANCE ? local.variance : MIN_VARIANCE);
+        float phoneConfidence = 1 / (phone.variance > MIN_VARIANCE ? phone.variance : MIN_VARIANCE);
+        phoneConfidence *= 1 - static_cast<float>(age) / FUSION_STALE_MILLIS;
+
+        weight = phoneConfidence / (localConfidence + phoneConfidence);
+        return filtered + weight * (phone.level - phoneOffset - filtered);
+    }
+
+    size_t encodePhoneSamples(const PhoneSample *samples, size_t count, uint32_t sentMillis, uint8_t *out)
+    {
+        if (count > MAX_PHONE_SAMPLES)
+            count = MAX_PHONE_SAMPLES;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t age = (sentMillis - samples[i].millis) / PHONE_SAMPLE_AGE_UNIT;
+            out[i * 2] = static_cast<uint8_t>(samples[i].rssi);
+            out[i * 2 + 1] = age > 0xFF ? 0xFF : age;
+        }
+        return count * 2;
+    }
+
+    size_t decodePhoneSamples(const uint8_t *data, size_t length, uint32_t receivedMillis, PhoneSample *samples)
+    {
+        if (data == nullptr || length % 2 != 0)
+            return 0;
+
+        size_t count = length / 2;
+        if (count > MAX_PHONE_SAMPLES)
+            count = MAX_PHONE_SAMPLES;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            samples[i].rssi = static_cast<int8_t>(data[i * 2]);
+            samples[i].millis = receivedMillis - data[i * 2 + 1] * PHONE_SAMPLE_AGE_UNIT;
+        }
+        return count;
+    }
+}
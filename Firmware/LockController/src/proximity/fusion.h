@@ -0,0 +1,71 @@
+#ifndef PROXIMITY_FUSION_H
+#define PROXIMITY_FUSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fuses the RSSI the controller reads with the RSSI the phone measures of the
+// controller (PHONE_RSSI). Both directions see the same path, but not the same
+// noise: the phone's radio, its orientation in a pocket and the moments it
+// samples differ. Every direction gets a confidence from how much its samples
+// scatter (inverse variance), the phone's also fades out with the age of its
+// newest sample, and the fused RSSI is the weighted mean of the filtered
+// controller reading and the smoothed phone samples. A constant difference
+// between the two (transmit power, antennas) is learned slowly and removed.
+namespace proximity
+{
+    /// @brief Phone samples older than this are not used at all
+    static const uint32_t FUSION_STALE_MILLIS = 3000;
+    /// @brief Most samples in one PHONE_RSSI command (2 bytes each)
+    static const size_t MAX_PHONE_SAMPLES = 13;
+    /// @brief Unit of the sample age on the wire in ms
+    static const uint32_t PHONE_SAMPLE_AGE_UNIT = 20;
+
+    struct PhoneSample
+    {
+        int8_t rssi;
+        uint32_t millis; // Controller time of the sample
+    };
+
+    class RssiFusion
+    {
+    public:
+        /// @brief Forgets the phone's samples (e.g. on a new connection), keeps
+        /// the learned offset
+        void reset();
+        /// @brief Adds a sample of the phone, older ones than its newest are ignored
+        void addPhone(float rssi, uint32_t atMillis);
+        /// @brief Fuses a reading of the controller (raw and filtered) with
+        /// the phone's samples and returns the RSSI to decide on
+        float fuse(float raw, float filtered, uint32_t nowMillis);
+        /// @brief Share of the phone in the last fused RSSI (0 without fresh samples)
+        float phoneWeight() const { return weight; }
+        /// @brief Learned phone RSSI minus controller RSSI in dB
+        float offset() const { return phoneOffset; }
+
+    private:
+        // Smoothed level and variance of the samples around it
+        struct Channel
+        {
+            float level = 0;
+            float variance = 16;
+            uint32_t lastMillis = 0;
+            bool primed = false;
+        };
+
+        Channel local;
+        Channel phone;
+        float phoneOffset = 0;
+        bool offsetPrimed = false;
+        float weight = 0;
+    };
+
+    /// @brief Encodes samples as `int8 RSSI, uint8 age` pairs, the age in
+    /// PHONE_SAMPLE_AGE_UNIT before sentMillis (max. MAX_PHONE_SAMPLES)
+    size_t encodePhoneSamples(const PhoneSample *samples, size_t count, uint32_t sentMillis, uint8_t *out);
+    /// @brief Decodes up to MAX_PHONE_SAMPLES samples received at receivedMillis,
+    /// returns how many (0 if length is odd)
+    size_t decodePhoneSamples(const uint8_t *data, size_t length, uint32_t receivedMillis, PhoneSample *samples);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include "quantile.h"
+
+namespace proximity
+{
+    void P2Quantile::reset()
+    {
+        total = 0;
+    }
+
+    void P2Quantile::add(float value)
+    {
+        if (total < 5)
+        {
+            heights[total++] = value;
+            if (total == 5)
+            {
+                std::sort(heights, heights + 5);
+                for (int i = 0; i < 5; i++)
+                    positions[i] = i + 1;
+                desired[0] = 1;
+                desired[1] = 1 + 2 * p;
+                desired[2] = 1 + 4 * p;
+                desired[3] = 3 + 2 * p;
+                desired[4] = 5;
+            }
+            return;
+        }
+        total++;
+
+        // Cell the value falls into, extending the outer markers if needed
+        int cell;
+        if (value < heights[0])
+        {
+            heights[0] = value;
+            cell = 0;
+        }
+        else if (value >= heights[4])
+        {
+            heights[4] = value;
+            cell = 3;
+        }
+        else
+        {
+            cell = 0;
+            while (value >= heights[cell + 1])
+                cell++;
+        }
+
+        for (int i = cell + 1; i < 5; i++)
+            positions[i]++;
+        desired[1] += p / 2;
+        desired[2] += p;
+        desired[3] += (1 + p) / 2;
+        desired[4] += 1;
+
+        // Move the middle markers back towards their desired positions
+        for (int i = 1; i < 4; i++)
+        {
+            float offset = desired[i] - positions[i];
+            if ((offset >= 1 && positions[i + 1] - positions[i] > 1) ||
+                (offset <= -1 && positions[i - 1] - positions[i] < -1))
+            {
+                int direction = offset > 0 ? 1 : -1;
+                float height = parabolic(i, direction);
+                if (heights[i - 1] < height && height < heights[i + 1])
+                    heights[i] = height;
+                else
+                    heights[i] = linear(i, direction);
+                positions[i] += direction;
+            }
+        }
+    }
+
+    float P2Quantile::parabolic(int i, int direction) const
+    {
+        float below = positions[i] - positions[i - 1];
+        float above = positions[i + 1] - positions[i];
+        return heights[i] + direction / static_cast<float>(positions[i + 1] - positions[i - 1]) *
+                                ((below + direction) * (heights[i + 1] - heights[i]) / above +
+                                 (above - direction) * (heights[i] - heights[i - 1]) / below);
+    }
+
+    float P2Quantile::linear(int i, int direction) const
+    {
+        return heights[i] + direction * (heights[i + direction] - heights[i]) /
+                                (positions[i + direction] - positions[i]);
+    }
+
+    float P2Quantile::value() const
+    {
+        if (total == 0)
+            return 0;
+        if (total >= 5)
+            return heights[2];
+
+        float sorted[5];
+        std::copy(heights, heights + total, sorted);
+        std::sort(sorted, sorted + total);
+        int index = static_cast<int>(p * (total - 1) + 0.5f);
+        return sorted[index];
+    }
+}
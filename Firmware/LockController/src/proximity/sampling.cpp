@@ -0,0 +1,47 @@
+#include <math.h>
+#include "sampling.h"
+
+namespace proximity
+{
+    void SamplingPlanner::configure(uint32_t minInterval, uint32_t maxInterval)
+    {
+        shortest = minInterval;
+        longest = maxInterval > minInterval ? maxInterval : minInterval;
+    }
+
+    void SamplingPlanner::reset()
+    {
+        smoothedSlope = 0;
+        primed = false;
+    }
+
+    uint32_t SamplingPlanner::update(float rssi, uint32_t nowMillis, float threshold, bool deciding)
+    {
+        if (primed && nowMillis != previousMillis)
+        {
+            float slope = (rssi - previousRssi) * 1000 / (nowMillis - previousMillis);
+            smoothedSlope += 0.5f * (slope - smoothedSlope);
+        }
+        previousRssi = rssi;
+        previousMillis = nowMillis;
+        primed = true;
+
+        if (deciding)
+            return shortest;
+
+        float margin = fabsf(rssi - threshold);
+        float interval = shortest + (longest - shortest) * (margin < FULL_INTERVAL_MARGIN ? margin / FULL_INTERVAL_MARGIN : 1);
+
+        // Moving towards the threshold: at least two readings before it is reached
+        if ((threshold - rssi) * smoothedSlope > 0)
+        {
+            float millisToThreshold = margin / fabsf(smoothedSlope) * 1000;
+            if (millisToThreshold / 2 < interval)
+                interval = millisToThreshold / 2;
+        }
+
+        if (interval < shortest)
+            return shortest;
+        return static_cast<uint32_t>(interval);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef PROXIMITY_SAMPLING_H
+#define PROXIMITY_SAMPLING_H
+
+#include <stdint.h>
+
+// Picks the time until the next RSSI reading: the minimum interval while a
+// decision is pending (Approaching/Leaving) or the phone moves towards the
+// threshold that matters in its zone, scaling up to the maximum interval the
+// further away from it the phone is. Every reading costs an HCI round trip
+// and a wake-up of the BLE task, most of them are useless far from the car.
+namespace proximity
+{
+    /// @brief Margin to the threshold (dB) from which on the maximum interval is used
+    static const float FULL_INTERVAL_MARGIN = 20;
+
+    class SamplingPlanner
+    {
+    public:
+        void configure(uint32_t minInterval, uint32_t maxInterval);
+        /// @brief Forgets the slope (e.g. on a new connection)
+        void reset();
+
+        /// @brief Feeds a filtered reading taken at nowMillis and returns the
+        /// interval in ms until the next one should be taken
+        uint32_t update(float rssi, uint32_t nowMillis, float threshold, bool deciding);
+        /// @brief Smoothed change of the filtered RSSI in dB/s
+        float slope() const { return smoothedSlope; }
+        uint32_t minInterval() const { return shortest; }
+
+    private:
+        uint32_t shortest = 250;
+        uint32_t longest = 2000;
+        float previousRssi = 0;
+        uint32_t previousMillis = 0;
+        float smoothedSlope = 0;
+        bool primed = false;
+    };
+}
+
+#endif
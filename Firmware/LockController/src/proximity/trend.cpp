@@ -0,0 +1,84 @@
+#include "trend.h"
+
+namespace proximity
+{
+    void TrendEstimator::reset()
+    {
+        index = 0;
+        count = 0;
+        fitSlope = 0;
+        fitIntercept = 0;
+        fitRSquared = 0;
+    }
+
+    void TrendEstimator::add(float rssi, uint32_t nowMillis)
+    {
+        rssiValues[index] = rssi;
+        readingMillis[index] = nowMillis;
+        index = (index + 1) % TREND_WINDOW;
+        if (count < TREND_WINDOW)
+            count++;
+        fit();
+    }
+
+    void TrendEstimator::fit()
+    {
+        fitSlope = 0;
+        fitRSquared = 0;
+        fitIntercept = rssiValues[(index + TREND_WINDOW - 1) % TREND_WINDOW];
+        if (count < TREND_MIN_READINGS)
+            return;
+
+        // Times in s relative to the newest reading, so floats stay precise
+        uint32_t newest = readingMillis[(index + TREND_WINDOW - 1) % TREND_WINDOW];
+        float times[TREND_WINDOW];
+        float meanT = 0, meanR = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            times[i] = -static_cast<float>(newest - readingMillis[i]) / 1000;
+            meanT += times[i];
+            meanR += rssiValues[i];
+        }
+        meanT /= count;
+        meanR /= count;
+
+        float varT = 0, varR = 0, covariance = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            float dt = times[i] - meanT;
+            float dr = rssiValues[i] - meanR;
+            varT += dt * dt;
+            varR += dr * dr;
+            covariance += dt * dr;
+        }
+        if (varT <= 0)
+            return;
+
+        fitSlope = covariance / varT;
+        fitIntercept = meanR - fitSlope * meanT;
+        fitRSquared = varR > 0 ? covariance * covariance / (varT * varR) : 1;
+    }
+
+    float TrendEstimator::predict(uint32_t aheadMillis) const
+    {
+        return fitIntercept + fitSlope * aheadMillis / 1000;
+    }
+
+    int32_t TrendEstimator::millisUntil(float threshold, float minRSquared) const
+    {
+        if (fitSlope <= 0 || fitRSquared < minRSquared || fitIntercept >= threshold)
+            return -1;
+        return static_cast<int32_t>((threshold - fitIntercept) / fitSlope * 1000);
+    }
+
+    float anticipatedRssi(const TrendEstimator &trend, float rssi, Zone zone, uint32_t aheadMillis)
+    {
+        if (aheadMillis == 0 || (zone != Zone::Far && zone != Zone::Approaching))
+            return rssi;
+        if (trend.slope() <= 0 || trend.rSquared() < PREDICT_MIN_R_SQUARED)
+            return rssi;
+
+        float predicted = trend.predict(aheadMillis);
+        return predicted > rssi ? predicted : rssi;
+    }
+}
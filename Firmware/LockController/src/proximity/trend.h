@@ -0,0 +1,54 @@
+#ifndef PROXIMITY_TREND_H
+#define PROXIMITY_TREND_H
+
+#include <stdint.h>
+#include "zones.h"
+
+// Linear regression over the last filtered RSSI readings, to see a phone
+// walking up to the car before it reaches the trigger RSSI. The readings don't
+// need to be evenly spaced (see SamplingPlanner).
+namespace proximity
+{
+    /// @brief Number of readings the trend is fitted to
+    static const uint8_t TREND_WINDOW = 8;
+    /// @brief Fewest readings before there is a trend at all
+    static const uint8_t TREND_MIN_READINGS = 4;
+    /// @brief R² of the fit from which on an approach gets pre-armed
+    static const float PREARM_MIN_R_SQUARED = 0.6f;
+    /// @brief R² of the fit from which on the unlock may be anticipated
+    static const float PREDICT_MIN_R_SQUARED = 0.8f;
+
+    class TrendEstimator
+    {
+    public:
+        void reset();
+        void add(float rssi, uint32_t nowMillis);
+
+        /// @brief Slope of the fit in dB/s (0 without a trend)
+        float slope() const { return fitSlope; }
+        /// @brief Coefficient of determination of the fit, 0 (noise) to 1 (straight line)
+        float rSquared() const { return fitRSquared; }
+        /// @brief RSSI the fit expects aheadMillis after the newest reading
+        float predict(uint32_t aheadMillis) const;
+        /// @brief Time until the fit reaches threshold from below, or -1 if it
+        /// doesn't rise, is less certain than minRSquared or is already above it
+        int32_t millisUntil(float threshold, float minRSquared) const;
+
+    private:
+        void fit();
+
+        float rssiValues[TREND_WINDOW];
+        uint32_t readingMillis[TREND_WINDOW];
+        uint8_t index = 0;
+        uint8_t count = 0;
+        float fitSlope = 0;
+        float fitIntercept = 0; // RSSI of the fit at the newest reading
+        float fitRSquared = 0;
+    };
+
+    /// @brief RSSI the unlock is decided on: the reading, or, while the phone
+    /// is outside and clearly approaching, the RSSI expected aheadMillis later
+    float anticipatedRssi(const TrendEstimator &trend, float rssi, Zone zone, uint32_t aheadMillis);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "zones.h"
+
+namespace proximity
+{
+    void ZoneTracker::configure(const ZoneConfig &config)
+    {
+        settings = config;
+    }
+
+    void ZoneTracker::reset(bool near)
+    {
+        current = near ? Zone::Near : Zone::Far;
+        enteredMillis = 0;
+    }
+
+    void ZoneTracker::enter(Zone zone, uint32_t sinceMillis)
+    {
+        current = zone;
+        enteredMillis = sinceMillis;
+    }
+
+    bool ZoneTracker::actionAllowed(uint32_t nowMillis) const
+    {
+        return !acted || nowMillis - lastActionMillis >= settings.minActionInterval;
+    }
+
+    Action ZoneTracker::update(float rssi, uint32_t nowMillis)
+    {
+        switch (current)
+        {
+        case Zone::Far:
+            if (rssi <= settings.trigger)
+                break;
+            // Evaluated right away, so a dwell time of 0 acts on this reading
+            current = Zone::Approaching;
+            enteredMillis = nowMillis;
+            // fall through
+        case Zone::Approaching:
+            if (rssi <= settings.trigger)
+            {
+                current = Zone::Far;
+            }
+            else if (nowMillis - enteredMillis >= settings.unlockDwell && actionAllowed(nowMillis))
+            {
+                current = Zone::Near;
+                lastActionMillis = nowMillis;
+                acted = true;
+                return Action::Unlock;
+            }
+            break;
+        case Zone::Near:
+            if (rssi >= settings.release)
+                break;
+            current = Zone::Leaving;
+            enteredMillis = nowMillis;
+            // fall through
+        case Zone::Leaving:
+            if (rssi >= settings.release)
+            {
+                current = Zone::Near;
+            }
+            else if (nowMillis - enteredMillis >= settings.lockDwell && actionAllowed(nowMillis))
+            {
+                current = Zone::Far;
+                lastActionMillis = nowMillis;
+                acted = true;
+                return Action::Lock;
+            }
+            break;
+        }
+        return Action::None;
+    }
+}
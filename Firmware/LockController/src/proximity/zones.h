@@ -0,0 +1,69 @@
+#ifndef PROXIMITY_ZONES_H
+#define PROXIMITY_ZONES_H
+
+#include <stdint.h>
+
+// Decides when the proximity key locks and unlocks. The filtered RSSI moves the
+// phone through four zones, an action only happens when a transition was held
+// for its dwell time and the last action is at least minActionInterval ago:
+//
+//   Far --(> trigger)--> Approaching --(unlockDwell)--> Near       => Unlock
+//   Near --(< release)--> Leaving --(lockDwell)--> Far             => Lock
+//
+// Approaching falls back to Far and Leaving to Near as soon as the RSSI is on
+// the other side of its threshold again. Between release and trigger (the dead
+// zone) nothing changes. Independent of Arduino so host tools can replay it.
+namespace proximity
+{
+    enum class Zone : uint8_t
+    {
+        Far         = 0,
+        Approaching = 1,
+        Near        = 2,
+        Leaving     = 3,
+    };
+
+    enum class Action : uint8_t
+    {
+        None,
+        Unlock,
+        Lock,
+    };
+
+    struct ZoneConfig
+    {
+        float trigger;              // RSSI above which the phone is near
+        float release;              // RSSI below which the phone is far
+        uint32_t unlockDwell;       // ms above trigger before unlocking
+        uint32_t lockDwell;         // ms below release before locking
+        uint32_t minActionInterval; // ms between two actions at least
+    };
+
+    class ZoneTracker
+    {
+    public:
+        void configure(const ZoneConfig &config);
+        const ZoneConfig &config() const { return settings; }
+
+        /// @brief Puts the phone into Near or Far without an action (e.g. on
+        /// connect, so it matches the current lock state)
+        void reset(bool near);
+        /// @brief Puts the phone into a zone entered at sinceMillis without an
+        /// action (e.g. to carry on with what the presence scan saw)
+        void enter(Zone zone, uint32_t sinceMillis);
+        /// @brief Feeds a filtered RSSI reading taken at nowMillis
+        Action update(float rssi, uint32_t nowMillis);
+        Zone zone() const { return current; }
+
+    private:
+        bool actionAllowed(uint32_t nowMillis) const;
+
+        ZoneConfig settings = {0, 0, 0, 0, 0};
+        Zone current = Zone::Far;
+        uint32_t enteredMillis = 0;    // When current was entered
+        uint32_t lastActionMillis = 0;
+        bool acted = false;            // lastActionMillis is valid
+    };
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <config.h>
+#include "memory.h"
+#include "log/log.h"
+
+namespace telemetry
+{
+    void (*onMemoryAlert)(const MemorySample &sample) = nullptr;
+
+    namespace
+    {
+        MemorySample samples[MEMORY_SAMPLES] = {};
+        uint8_t sampleIndex = 0; // Where the next sample goes
+        uint8_t sampleCount = 0;
+        unsigned long previousSampleMillis = 0;
+        bool alertActive = false;
+
+        uint8_t reportPosition = 0;
+        // Set by startMemoryReport() (BTC task), taken by nextMemoryRecord() (loop)
+        volatile bool reportRequested = false;
+
+        uint16_t stackHighWaterMark(const char *taskName)
+        {
+            TaskHandle_t task = xTaskGetHandle(taskName);
+            if (task == nullptr)
+                return 0;
+            return uxTaskGetStackHighWaterMark(task);
+        }
+
+        const MemorySample &sampleAt(uint8_t age)
+        {
+            return samples[(sampleIndex + MEMORY_SAMPLES - 1 - age) % MEMORY_SAMPLES];
+        }
+
+        void checkThresholds(const MemorySample &sample)
+        {
+            bool low = sample.freeHeap < MEMORY_ALERT_FREE_HEAP ||
+                       sample.largestFreeBlock < MEMORY_ALERT_LARGEST_BLOCK;
+
+            if (low && !alertActive)
+            {
+                alertActive = true;
+                LOG_WARN(LOW_MEMORY, sample.freeHeap, sample.largestFreeBlock);
+                if (onMemoryAlert)
+                    onMemoryAlert(sample);
+            }
+            else if (!low)
+            {
+                alertActive = false;
+            }
+        }
+
+        size_t putUint16(uint8_t *out, uint16_t value)
+        {
+            out[0] = value & 0xFF;
+            out[1] = value >> 8;
+            return 2;
+        }
+
+        size_t putUint32(uint8_t *out, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                out[i] = (value >> (8 * i)) & 0xFF;
+            return 4;
+        }
+    }
+
+    const MemorySample &sampleMemory()
+    {
+        MemorySample &sample = samples[sampleIndex];
+        sample.atMillis = millis();
+        sample.freeHeap = ESP.getFreeHeap();
+        sample.minFreeHeap = ESP.getMinFreeHeap();
+        sample.largestFreeBlock = ESP.getMaxAllocHeap();
+        sample.loopStack = stackHighWaterMark("loopTask");
+        sample.btcStack = stackHighWaterMark("BTC_TASK");
+        sample.btuStack = stackHighWaterMark("BTU_TASK");
+
+        sampleIndex = (sampleIndex + 1) % MEMORY_SAMPLES;
+        if (sampleCount < MEMORY_SAMPLES)
+            sampleCount++;
+
+        checkThresholds(sample);
+        return sample;
+    }
+
+    void memoryLoop()
+    {
+        unsigned long currentMillis = millis();
+        if (sampleCount != 0 && currentMillis - previousSampleMillis < MEMORY_SAMPLE_INTERVAL)
+            return;
+        previousSampleMillis = currentMillis;
+        sampleMemory();
+    }
+
+    void printMemorySamples()
+    {
+        Serial.println("age_ms,free_heap,min_free_heap,largest_block,loop_stack,btc_stack,btu_stack");
+        for (uint8_t age = 0; age < sampleCount; age++)
+        {
+            const MemorySample &sample = sampleAt(age);
+            Serial.printf("%lu,%u,%u,%u,%u,%u,%u\n",
+                          millis() - sample.atMillis,
+                          (unsigned)sample.freeHeap,
+                          (unsigned)sample.minFreeHeap,
+                          (unsigned)sample.largestFreeBlock,
+                          sample.loopStack,
+                          sample.btcStack,
+                          sample.btuStack);
+        }
+    }
+
+    size_t encodeMemorySample(const MemorySample &sample, uint8_t *out)
+    {
+        size_t length = 0;
+        length += putUint32(out + length, millis() - sample.atMillis);
+        length += putUint32(out + length, sample.freeHeap);
+        length += putUint32(out + length, sample.minFreeHeap);
+        length += putUint32(out + length, sample.largestFreeBlock);
+        length += putUint16(out + length, sample.loopStack);
+        length += putUint16(out + length, sample.btcStack);
+        length += putUint16(out + length, sample.btuStack);
+        return length;
+    }
+
+    void startMemoryReport()
+    {
+        reportRequested = true;
+    }
+
+    size_t nextMemoryRecord(uint8_t *out, size_t maxLength)
+    {
+        if (reportRequested)
+        {
+            reportRequested = false;
+            reportPosition = 0;
+            sampleMemory();
+        }
+        if (reportPosition >= sampleCount || maxLength < MEMORY_RECORD_LENGTH)
+            return 0;
+        return encodeMemorySample(sampleAt(reportPosition++), out);
+    }
+}
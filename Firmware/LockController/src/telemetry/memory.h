@@ -0,0 +1,52 @@
+#ifndef MEMORY_TELEMETRY_H
+#define MEMORY_TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Periodic heap and stack watermark samples, kept in a small ring in RAM so
+// slow leaks and fragmentation show up long before an allocation fails.
+// Only the loop task writes the ring (memoryLoop(), nextMemoryRecord()), the
+// BTC task merely asks for a report.
+namespace telemetry
+{
+    struct MemorySample
+    {
+        uint32_t atMillis;
+        uint32_t freeHeap;
+        uint32_t minFreeHeap;      // Lowest free heap since boot
+        uint32_t largestFreeBlock; // Largest block that can still be allocated
+        uint16_t loopStack;        // Stack high-water marks (unused stack, bytes on ESP32)
+        uint16_t btcStack;
+        uint16_t btuStack;
+    };
+
+    /// @brief Number of samples kept (the oldest one gets overwritten)
+    static const uint8_t MEMORY_SAMPLES = 16;
+    /// @brief Time between two samples in ms
+    static const unsigned long MEMORY_SAMPLE_INTERVAL = 30000;
+    /// @brief Size of an encoded sample (see encodeMemorySample())
+    static const size_t MEMORY_RECORD_LENGTH = 22;
+
+    /// @brief Called once when free heap or the largest free block drops below
+    /// the thresholds in config.h (again only after both recovered)
+    extern void (*onMemoryAlert)(const MemorySample &sample);
+
+    /// @brief Takes a sample when MEMORY_SAMPLE_INTERVAL passed (first call samples right away)
+    void memoryLoop();
+    /// @brief Takes a sample now, adds it to the ring and checks the thresholds
+    const MemorySample &sampleMemory();
+    /// @brief Prints the samples in the ring to serial, newest first
+    void printMemorySamples();
+
+    /// @brief `uint32 age ms, uint32 free heap, uint32 min free heap,
+    /// uint32 largest free block, uint16 loop/BTC/BTU stack high-water marks`
+    size_t encodeMemorySample(const MemorySample &sample, uint8_t *out);
+    /// @brief Restarts the report, at a sample nextMemoryRecord() takes first
+    void startMemoryReport();
+    /// @brief Encodes the next sample of the report (returns 0 when done), call
+    /// from the loop task
+    size_t nextMemoryRecord(uint8_t *out, size_t maxLength);
+}
+
+#endif
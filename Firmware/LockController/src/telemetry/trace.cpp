@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include <atomic>
+#include "trace.h"
+
+namespace telemetry
+{
+    namespace
+    {
+        struct Entry
+        {
+            uint16_t deltaMillis;
+            TraceEvent event;
+            int8_t value;
+        };
+
+        struct Cursor
+        {
+            uint32_t start;  // Position of the oldest entry in the report
+            uint16_t count;
+            uint16_t index;  // Next entry to encode
+            uint32_t baseMillis;
+            int8_t baseRssi;
+            bool headerSent;
+            // The oldest entries are the next to be overwritten, so they are
+            // copied together with the base
+            Entry oldest[TRACE_ENTRIES_PER_RECORD];
+        };
+
+        static const size_t HEADER_LENGTH = 12;
+
+        // Only the BLE task records, readers (the report and the serial dump)
+        // run in the loop task and check the positions they copied weren't
+        // overwritten meanwhile
+        Entry entries[TRACE_ENTRIES];
+        std::atomic<uint32_t> written(0); // Entries recorded since boot
+        // Odd while an entry is recorded
+        std::atomic<uint32_t> version(0);
+        uint32_t baseMillis = 0; // Time and RSSI before the oldest entry
+        int8_t baseRssi = 0;
+
+        uint32_t lastMillis = 0;
+        int8_t lastRssi = 0;
+
+        Cursor report = {};
+
+        void append(TraceEvent event, int8_t value, uint16_t deltaMillis)
+        {
+            uint32_t position = written.load(std::memory_order_relaxed);
+            Entry &entry = entries[position % TRACE_ENTRIES];
+
+            version.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            if (position >= TRACE_ENTRIES)
+            {
+                baseMillis += entry.deltaMillis;
+                if (entry.event == TraceEvent::Rssi)
+                    baseRssi += entry.value;
+            }
+
+            entry.deltaMillis = deltaMillis;
+            entry.event = event;
+            entry.value = value;
+            written.store(position + 1, std::memory_order_release);
+            version.fetch_add(1, std::memory_order_release);
+        }
+
+        // Adds Time entries until the rest of the gap fits into one entry
+        uint16_t advanceTime()
+        {
+            uint32_t now = millis();
+            if (written.load(std::memory_order_relaxed) == 0)
+            {
+                baseMillis = now;
+                lastMillis = now;
+            }
+
+            uint32_t delta = now - lastMillis;
+            lastMillis = now;
+            while (delta > 0xFFFF)
+            {
+                append(TraceEvent::Time, 0, 0xFFFF);
+                delta -= 0xFFFF;
+            }
+            return static_cast<uint16_t>(delta);
+        }
+
+        void startCursor(Cursor &cursor)
+        {
+            uint32_t before;
+            do
+            {
+                before = version.load(std::memory_order_acquire);
+                uint32_t end = written.load(std::memory_order_relaxed);
+                cursor.count = end > TRACE_ENTRIES ? TRACE_ENTRIES : end;
+                cursor.start = end - cursor.count;
+                cursor.baseMillis = baseMillis;
+                cursor.baseRssi = baseRssi;
+                for (uint8_t i = 0; i < TRACE_ENTRIES_PER_RECORD; i++)
+                    cursor.oldest[i] = entries[(cursor.start + i) % TRACE_ENTRIES];
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((before & 1) || before != version.load(std::memory_order_relaxed));
+
+            cursor.index = 0;
+            cursor.headerSent = false;
+        }
+
+        size_t putUint32(uint8_t *out, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                out[i] = (value >> (8 * i)) & 0xFF;
+            return 4;
+        }
+
+        size_t nextRecord(Cursor &cursor, uint8_t *out, size_t maxLength)
+        {
+            if (!cursor.headerSent)
+            {
+                if (maxLength < HEADER_LENGTH)
+                    return 0;
+                cursor.headerSent = true;
+                out[0] = static_cast<uint8_t>(TraceRecord::Header);
+                putUint32(out + 1, cursor.baseMillis);
+                out[5] = static_cast<uint8_t>(cursor.baseRssi);
+                out[6] = cursor.count & 0xFF;
+                out[7] = cursor.count >> 8;
+                putUint32(out + 8, millis());
+                return HEADER_LENGTH;
+            }
+
+            size_t fit = (maxLength - 1) / sizeof(Entry);
+            size_t remaining = cursor.count - cursor.index;
+            size_t count = remaining < fit ? remaining : fit;
+            if (count > TRACE_ENTRIES_PER_RECORD)
+                count = TRACE_ENTRIES_PER_RECORD;
+            if (count == 0)
+                return 0;
+
+            out[0] = static_cast<uint8_t>(TraceRecord::Entries);
+            uint32_t first = cursor.start + cursor.index;
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t index = cursor.index + i;
+                const Entry &entry = index < TRACE_ENTRIES_PER_RECORD ? cursor.oldest[index]
+                                                                      : entries[(first + i) % TRACE_ENTRIES];
+                uint8_t *slot = out + 1 + i * sizeof(Entry);
+                slot[0] = entry.deltaMillis & 0xFF;
+                slot[1] = entry.deltaMillis >> 8;
+                slot[2] = static_cast<uint8_t>(entry.event);
+                slot[3] = static_cast<uint8_t>(entry.value);
+            }
+
+            // The recording overwrote entries of the report before they were
+            // copied (the oldest ones are safe in the cursor)
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (cursor.index >= TRACE_ENTRIES_PER_RECORD &&
+                written.load(std::memory_order_acquire) >= first + TRACE_ENTRIES)
+            {
+                cursor.index = cursor.count;
+                return 0;
+            }
+            cursor.index += count;
+            return 1 + count * sizeof(Entry);
+        }
+    }
+
+    void traceRssi(int8_t rssi)
+    {
+        uint16_t delta = advanceTime();
+        int change = rssi - lastRssi;
+        if (change > 127)
+            change = 127;
+        else if (change < -128)
+            change = -128;
+        lastRssi += change;
+        append(TraceEvent::Rssi, static_cast<int8_t>(change), delta);
+    }
+
+    void traceEvent(TraceEvent event, int8_t value)
+    {
+        uint16_t delta = advanceTime();
+        append(event, value, delta);
+    }
+
+    void startTraceReport()
+    {
+        startCursor(report);
+    }
+
+    size_t nextTraceRecord(uint8_t *out, size_t maxLength)
+    {
+        return nextRecord(report, out, maxLength);
+    }
+
+    void dumpTrace()
+    {
+        Cursor cursor;
+        startCursor(cursor);
+
+        uint8_t record[1 + TRACE_ENTRIES_PER_RECORD * sizeof(Entry)];
+        char line[8 + 2 * sizeof(record) + 1] = "#TRACE ";
+        size_t length;
+        while ((length = nextRecord(cursor, record, sizeof(record))) > 0)
+        {
+            for (size_t b = 0; b < length; b++)
+                snprintf(line + 7 + 2 * b, 3, "%02x", record[b]);
+            Serial.println(line);
+        }
+    }
+}
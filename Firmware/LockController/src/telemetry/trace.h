@@ -0,0 +1,54 @@
+#ifndef TRACE_TELEMETRY_H
+#define TRACE_TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Recording of the raw RSSI readings, connection events and proximity
+// decisions, so complaints about the proximity key can be looked at with real
+// data. Every entry is 4 bytes (uint16 ms since the previous entry, type, int8
+// value, RSSI as change to the previous reading). The oldest entries are
+// overwritten, their time and RSSI move into the base the rest is relative to.
+namespace telemetry
+{
+    enum class TraceEvent : uint8_t
+    {
+        Rssi         = 0x00, // Value: change of the raw RSSI
+        Connected    = 0x01,
+        Disconnected = 0x02,
+        Zone         = 0x03, // Value: new proximity::Zone
+        Unlock       = 0x04, // Proximity unlock
+        Lock         = 0x05, // Proximity lock
+        Time         = 0x06, // Only moves the time on (gaps above 65535ms)
+        Presence     = 0x07, // Value: RSSI of a presence advertisement
+        PhoneRssi    = 0x08, // Value: RSSI the phone measured (PHONE_RSSI, at its arrival)
+    };
+
+    /// @brief Record types inside a TRACE response (and a serial dump)
+    enum class TraceRecord : uint8_t
+    {
+        Header  = 0x00,
+        Entries = 0x01,
+    };
+
+    /// @brief Number of entries kept
+    static const uint16_t TRACE_ENTRIES = 1024;
+    /// @brief Entries per Entries record (so a record fits into one notification)
+    static const uint8_t TRACE_ENTRIES_PER_RECORD = 14;
+
+    void traceRssi(int8_t rssi);
+    void traceEvent(TraceEvent event, int8_t value = 0);
+
+    /// @brief Freezes the current content for a report (entries recorded
+    /// meanwhile aren't part of it)
+    void startTraceReport();
+    /// @brief Header first: `0x00, uint32 base ms, int8 base RSSI, uint16 entries,
+    /// uint32 ms now`, then `0x01, up to 14 entries`. Returns 0 when done, or
+    /// early if the recording overtook the report
+    size_t nextTraceRecord(uint8_t *out, size_t maxLength);
+    /// @brief Dumps the trace via serial for tools/trace_decoder: one
+    /// `#TRACE <hex>` line per record
+    void dumpTrace();
+}
+
+#endif
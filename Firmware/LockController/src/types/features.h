@@ -11,13 +11,20 @@ enum Feature : uint32_t
     Windows = 1 << 3,
 };
 
-// Allow bitwise operators for the enum
-inline Feature operator|(Feature a, Feature b)
+// Allow bitwise operators for the enum (constexpr, so SUPPORTED_FEATURES is a
+// compile-time constant)
+constexpr Feature operator|(Feature a, Feature b)
 {
     return static_cast<Feature>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
 }
 
-inline Feature operator&(Feature a, Feature b)
+constexpr Feature operator&(Feature a, Feature b)
 {
     return static_cast<Feature>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
 }
+
+/// @brief True if `features` has every bit of `feature` (None always is)
+constexpr bool hasFeature(Feature features, Feature feature)
+{
+    return (features & feature) == feature;
+}
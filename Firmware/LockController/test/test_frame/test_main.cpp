@@ -0,0 +1,114 @@
+// FrameView::parse and the bounds-checked Payload accessors (frame.h)
+#include <unity.h>
+#include <string.h>
+#include "bluetooth/frame.h"
+
+using namespace frame;
+
+namespace
+{
+    uint8_t buffer[64];
+
+    // HMAC of 0xAA bytes, the command, then `tail` as it is
+    size_t buildFrame(uint8_t command, const uint8_t *tail, size_t tailLength)
+    {
+        memset(buffer, 0xAA, HMAC_LENGTH);
+        buffer[HMAC_LENGTH] = command;
+        memcpy(buffer + HEADER_LENGTH, tail, tailLength);
+        return HEADER_LENGTH + tailLength;
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_rejects_empty_and_short_frames()
+{
+    FrameView view;
+    TEST_ASSERT_EQUAL(FrameError::Empty, FrameView::parse(nullptr, 10, view));
+    TEST_ASSERT_EQUAL(FrameError::Empty, FrameView::parse(buffer, 0, view));
+    TEST_ASSERT_EQUAL(FrameError::TooShort, FrameView::parse(buffer, HEADER_LENGTH - 1, view));
+}
+
+void test_command_without_data()
+{
+    FrameView view;
+    size_t length = buildFrame(0x02, nullptr, 0);
+    TEST_ASSERT_EQUAL(FrameError::None, FrameView::parse(buffer, length, view));
+    TEST_ASSERT_EQUAL_HEX8(0x02, view.command());
+    TEST_ASSERT_TRUE(view.hmac() == buffer);
+    TEST_ASSERT_TRUE(view.payload().empty());
+    TEST_ASSERT_EQUAL(NO_REQUEST_ID, view.requestId());
+}
+
+void test_points_at_the_additional_data()
+{
+    const uint8_t tail[] = {3, 0x10, 0x20, 0x30};
+    FrameView view;
+    size_t length = buildFrame(0x1A, tail, sizeof(tail));
+    TEST_ASSERT_EQUAL(FrameError::None, FrameView::parse(buffer, length, view));
+    TEST_ASSERT_EQUAL(3, view.payload().length());
+    TEST_ASSERT_TRUE(view.payload().data() == buffer + PAYLOAD_OFFSET);
+    TEST_ASSERT_EQUAL(NO_REQUEST_ID, view.requestId());
+}
+
+void test_request_id_follows_the_data()
+{
+    const uint8_t withData[] = {2, 0x0A, 0x00, 0x7F};
+    FrameView view;
+    TEST_ASSERT_EQUAL(FrameError::None, FrameView::parse(buffer, buildFrame(0x1A, withData, sizeof(withData)), view));
+    TEST_ASSERT_EQUAL(2, view.payload().length());
+    TEST_ASSERT_EQUAL(0x7F, view.requestId());
+
+    // A length byte of 0 if there is no data
+    const uint8_t withoutData[] = {0, 0xFF};
+    TEST_ASSERT_EQUAL(FrameError::None, FrameView::parse(buffer, buildFrame(0x00, withoutData, sizeof(withoutData)), view));
+    TEST_ASSERT_TRUE(view.payload().empty());
+    TEST_ASSERT_EQUAL(0xFF, view.requestId());
+}
+
+void test_rejects_data_shorter_than_its_length_byte()
+{
+    const uint8_t tail[] = {4, 0x01, 0x02};
+    FrameView view;
+    TEST_ASSERT_EQUAL(FrameError::LengthMismatch, FrameView::parse(buffer, buildFrame(0x11, tail, sizeof(tail)), view));
+}
+
+void test_payload_reads_little_endian()
+{
+    // -60.0f is 0xC2700000
+    const uint8_t data[] = {0x34, 0x12, 0x78, 0x56, 0x34, 0x12, 0x00, 0x00, 0x70, 0xC2, 0xFF};
+    Payload payload(data, sizeof(data));
+    TEST_ASSERT_EQUAL_UINT16(0x1234, payload.u16(0));
+    TEST_ASSERT_EQUAL_UINT32(0x12345678, payload.u32(2));
+    TEST_ASSERT_EQUAL_FLOAT(-60.0f, payload.f32(6));
+    TEST_ASSERT_EQUAL(-1, payload.i8(10));
+}
+
+void test_payload_reads_zero_past_the_end()
+{
+    const uint8_t data[] = {0x01, 0x02, 0x03};
+    Payload payload(data, sizeof(data));
+    TEST_ASSERT_TRUE(payload.has(1, 2));
+    TEST_ASSERT_FALSE(payload.has(2, 2));
+    TEST_ASSERT_EQUAL(0, payload.u8(3));
+    TEST_ASSERT_EQUAL(0, payload.u16(2));
+    TEST_ASSERT_EQUAL(0, payload.u32(0));
+
+    Payload empty;
+    TEST_ASSERT_TRUE(empty.empty());
+    TEST_ASSERT_EQUAL(0, empty.u8(0));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_empty_and_short_frames);
+    RUN_TEST(test_command_without_data);
+    RUN_TEST(test_points_at_the_additional_data);
+    RUN_TEST(test_request_id_follows_the_data);
+    RUN_TEST(test_rejects_data_shorter_than_its_length_byte);
+    RUN_TEST(test_payload_reads_little_endian);
+    RUN_TEST(test_payload_reads_zero_past_the_end);
+    return UNITY_END();
+}
@@ -0,0 +1,310 @@
+// Commands through onWrite like the app sends them (native shims, host.h):
+// request IDs, rolling code, BATCH, STATE_SINCE and the timed commands
+#include <unity.h>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "host.h"
+#include "config.h"
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/commands.h"
+#include "bluetooth/state.h"
+#include "bluetooth/timers.h"
+#include "bluetooth/tlv.h"
+
+// The unsupported cases use the engine commands
+static_assert(!hasFeature(SUPPORTED_FEATURES, Feature::Engine), "Run the protocol tests with the default features of env:native");
+
+namespace
+{
+    const char *COMMAND_UUID = "0000ffe1-0000-1000-8000-00805f9b34fb";
+    const char *STATE_UUID = "0000ffe2-0000-1000-8000-00805f9b34fb";
+
+    typedef std::vector<uint8_t> Bytes;
+
+    uint32_t counter = 0;
+
+    Bytes frameOf(ClientCommand command, const Bytes &data = Bytes(), int requestId = -1)
+    {
+        return host::buildFrame(++counter, static_cast<uint8_t>(command), data.data(), static_cast<uint8_t>(data.size()),
+                                requestId);
+    }
+
+    void send(ClientCommand command, const Bytes &data = Bytes(), int requestId = -1)
+    {
+        host::write(frameOf(command, data, requestId));
+    }
+
+    // Notifications on the command characteristic since the last call
+    std::vector<Bytes> answers()
+    {
+        std::vector<Bytes> values;
+        for (const host::Notification &notification : host::notifications())
+        {
+            if (notification.characteristicUuid == COMMAND_UUID)
+                values.push_back(notification.value);
+        }
+        host::clearNotifications();
+        return values;
+    }
+
+    bool answered(const std::vector<Bytes> &values, Esp32Response response)
+    {
+        for (const Bytes &value : values)
+        {
+            if (value[0] == static_cast<uint8_t>(response))
+                return true;
+        }
+        return false;
+    }
+
+    // Advances the clock in steps of the main loop
+    void run(unsigned long ms)
+    {
+        for (unsigned long elapsed = 0; elapsed < ms; elapsed += 10)
+        {
+            host::advanceMillis(10);
+            bluetoothLoop();
+        }
+    }
+
+    // STATE: response, length, state bits, bits the vehicle has, uint32 version
+    Bytes readState()
+    {
+        Bytes value = host::read(STATE_UUID);
+        TEST_ASSERT_EQUAL(2 + state::STATE_LENGTH, value.size());
+        return value;
+    }
+
+    uint32_t versionOf(const Bytes &state)
+    {
+        return state[4] | state[5] << 8 | state[6] << 16 | static_cast<uint32_t>(state[7]) << 24;
+    }
+
+    Bytes seconds16(uint16_t seconds)
+    {
+        return Bytes{static_cast<uint8_t>(seconds), static_cast<uint8_t>(seconds >> 8)};
+    }
+
+    Bytes schedule(ClientCommand command, uint32_t seconds)
+    {
+        return Bytes{static_cast<uint8_t>(command), static_cast<uint8_t>(seconds), static_cast<uint8_t>(seconds >> 8),
+                     static_cast<uint8_t>(seconds >> 16), static_cast<uint8_t>(seconds >> 24)};
+    }
+}
+
+void setUp()
+{
+    host::connect();
+    host::clearNotifications();
+}
+
+void tearDown()
+{
+    // Let the repeat window of the last command pass
+    run(VEHICLE_REPEAT_WINDOW);
+    host::disconnect();
+    host::clearNotifications();
+}
+
+void test_answers_carry_the_request_id()
+{
+    send(ClientCommand::GET_VERSION, Bytes(), 0x42);
+    std::vector<Bytes> values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::VERSION, values[0][0]);
+    TEST_ASSERT_EQUAL_HEX8(0x42, values[0].back());
+
+    // Commands without an answer of their own get COMMAND_DONE
+    send(ClientCommand::PROXIMITY_KEY_OFF, Bytes(), 0x43);
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    const uint8_t done[] = {static_cast<uint8_t>(Esp32Response::COMMAND_DONE), 1, 0, 0x43};
+    TEST_ASSERT_EQUAL(sizeof(done), values[0].size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(done, values[0].data(), sizeof(done));
+}
+
+void test_rejects_a_used_counter()
+{
+    Bytes frame = frameOf(ClientCommand::GET_VERSION);
+    host::write(frame);
+    TEST_ASSERT_TRUE(answered(answers(), Esp32Response::VERSION));
+
+    host::write(frame);
+    std::vector<Bytes> values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::INVALID_HMAC, values[0][0]);
+}
+
+void test_batch_runs_every_command_under_one_counter()
+{
+    const Bytes batch = {1, static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS), 0,
+                         static_cast<uint8_t>(ClientCommand::GET_VERSION), 0};
+    send(ClientCommand::BATCH, batch);
+    std::vector<Bytes> values = answers();
+    TEST_ASSERT_TRUE(answered(values, Esp32Response::UNLOCKED));
+    TEST_ASSERT_TRUE(answered(values, Esp32Response::VERSION));
+    const uint8_t result[] = {static_cast<uint8_t>(Esp32Response::BATCH_RESULT), 2, 0, 2};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(result, values.back().data(), sizeof(result));
+    TEST_ASSERT_EQUAL_HEX8(0, readState()[2] & state::Locked);
+}
+
+void test_batch_runs_nothing_if_one_command_cant_run()
+{
+    send(ClientCommand::LOCK_DOORS);
+    answers();
+    run(VEHICLE_REPEAT_WINDOW);
+
+    // START_ENGINE needs a feature the default build doesn't have
+    const Bytes unsupported = {1, static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS), 0,
+                               static_cast<uint8_t>(ClientCommand::START_ENGINE), 0};
+    send(ClientCommand::BATCH, unsupported);
+    std::vector<Bytes> values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    const uint8_t result[] = {static_cast<uint8_t>(Esp32Response::BATCH_RESULT), 2, 2, 1};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(result, values[0].data(), sizeof(result));
+
+    const Bytes nested = {1, static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS), 0,
+                          static_cast<uint8_t>(ClientCommand::BATCH), 0};
+    send(ClientCommand::BATCH, nested);
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8(4, values[0][2]);
+
+    TEST_ASSERT_EQUAL_HEX8(state::Locked, readState()[2] & state::Locked);
+}
+
+void test_signed_data_cant_be_changed()
+{
+    const Bytes batch = {1, static_cast<uint8_t>(ClientCommand::LOCK_DOORS), 0};
+    Bytes frame = frameOf(ClientCommand::BATCH, batch);
+    frame[frame.size() - 2] = static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS);
+    host::write(frame);
+    std::vector<Bytes> values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::INVALID_HMAC, values[0][0]);
+
+    // A dead zone of 2 turned into 255, the proximity key unlocking from afar
+    const Bytes settings = {1, static_cast<uint8_t>(tlv::Setting::DeadZone), 1, 2};
+    frame = frameOf(ClientCommand::SETTINGS, settings);
+    frame[frame.size() - 1] = 0xFF;
+    host::write(frame);
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::INVALID_HMAC, values[0][0]);
+    send(ClientCommand::SETTINGS, settings);
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::SETTINGS, answers().back()[0]);
+
+    // A 10s unlock stretched to 65535s
+    frame = frameOf(ClientCommand::UNLOCK_FOR, seconds16(10));
+    frame[frame.size() - 1] = 0xFF;
+    frame[frame.size() - 2] = 0xFF;
+    host::write(frame);
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::INVALID_HMAC, values[0][0]);
+}
+
+void test_state_since_reports_what_changed()
+{
+    send(ClientCommand::LOCK_DOORS);
+    run(VEHICLE_REPEAT_WINDOW);
+    uint32_t seen = versionOf(readState());
+
+    send(ClientCommand::UNLOCK_DOORS);
+    send(ClientCommand::STATE_SINCE, {static_cast<uint8_t>(seen), static_cast<uint8_t>(seen >> 8),
+                                      static_cast<uint8_t>(seen >> 16), static_cast<uint8_t>(seen >> 24)});
+    std::vector<Bytes> values = answers();
+    const Bytes &delta = values.back();
+    TEST_ASSERT_EQUAL_HEX8(Esp32Response::STATE_DELTA, delta[0]);
+    TEST_ASSERT_EQUAL_HEX8(state::Locked, delta[2]);
+    TEST_ASSERT_EQUAL_HEX8(0, delta[3] & state::Locked);
+    TEST_ASSERT_EQUAL_UINT32(seen + 1, delta[4] | delta[5] << 8 | delta[6] << 16 | delta[7] << 24);
+
+    // A version from before the reboot (or never seen) gets every bit
+    send(ClientCommand::STATE_SINCE, {0, 0, 0, 0});
+    TEST_ASSERT_EQUAL_HEX8(state::supportedBits(SUPPORTED_FEATURES), answers().back()[2]);
+}
+
+void test_unlock_for_relocks_with_a_full_schedule()
+{
+    for (size_t i = 0; i < timers::MAX_TIMERS; i++)
+        send(ClientCommand::SCHEDULE, schedule(ClientCommand::LOCK_DOORS, 1000));
+    answers();
+
+    send(ClientCommand::UNLOCK_FOR, seconds16(10));
+    TEST_ASSERT_TRUE(answered(answers(), Esp32Response::UNLOCKED));
+    uint8_t bits = readState()[2];
+    TEST_ASSERT_EQUAL_HEX8(state::RelockPending | state::Scheduled, bits);
+
+    run(10000);
+    TEST_ASSERT_TRUE(answered(answers(), Esp32Response::LOCKED));
+    TEST_ASSERT_EQUAL_HEX8(state::Locked | state::Scheduled, readState()[2]);
+
+    send(ClientCommand::SCHEDULE, schedule(ClientCommand::LOCK_DOORS, 0));
+    TEST_ASSERT_EQUAL_HEX8(state::Locked, readState()[2]);
+}
+
+void test_refused_schedule_is_rejected()
+{
+    const uint8_t rejected[] = {static_cast<uint8_t>(Esp32Response::COMMAND_REJECTED), 1,
+                                static_cast<uint8_t>(ClientCommand::SCHEDULE)};
+
+    // START_ENGINE needs a feature the default build doesn't have
+    send(ClientCommand::SCHEDULE, schedule(ClientCommand::START_ENGINE, 60));
+    std::vector<Bytes> values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(rejected, values[0].data(), sizeof(rejected));
+
+    send(ClientCommand::SCHEDULE, schedule(ClientCommand::LOCK_DOORS, timers::MAX_DELAY_SECONDS + 1));
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(rejected, values[0].data(), sizeof(rejected));
+
+    for (size_t i = 0; i < timers::MAX_SCHEDULED; i++)
+    {
+        send(ClientCommand::SCHEDULE, schedule(ClientCommand::LOCK_DOORS, 1000));
+        TEST_ASSERT_EQUAL_HEX8(Esp32Response::SCHEDULE, answers().back()[0]);
+    }
+    send(ClientCommand::SCHEDULE, schedule(ClientCommand::UNLOCK_DOORS, 1000));
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(rejected, values[0].data(), sizeof(rejected));
+
+    // Cancelling leaves no timers, the answer has no data
+    send(ClientCommand::SCHEDULE, schedule(ClientCommand::LOCK_DOORS, 0));
+    values = answers();
+    TEST_ASSERT_EQUAL(1, values.size());
+    TEST_ASSERT_EQUAL(1, values[0].size());
+}
+
+void test_timer_doesnt_pulse_for_a_state_already_reached()
+{
+    send(ClientCommand::LOCK_DOORS);
+    run(VEHICLE_REPEAT_WINDOW);
+    answers();
+
+    send(ClientCommand::SCHEDULE, schedule(ClientCommand::LOCK_DOORS, 5));
+    answers();
+    run(5000);
+    TEST_ASSERT_FALSE(answered(answers(), Esp32Response::LOCKED));
+    TEST_ASSERT_EQUAL_HEX8(state::Locked, readState()[2]);
+}
+
+int main()
+{
+    host::setSerialOutput(nullptr);
+    setupBluetooth();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_answers_carry_the_request_id);
+    RUN_TEST(test_rejects_a_used_counter);
+    RUN_TEST(test_batch_runs_every_command_under_one_counter);
+    RUN_TEST(test_batch_runs_nothing_if_one_command_cant_run);
+    RUN_TEST(test_signed_data_cant_be_changed);
+    RUN_TEST(test_state_since_reports_what_changed);
+    RUN_TEST(test_unlock_for_relocks_with_a_full_schedule);
+    RUN_TEST(test_refused_schedule_is_rejected);
+    RUN_TEST(test_timer_doesnt_pulse_for_a_state_already_reached);
+    return UNITY_END();
+}
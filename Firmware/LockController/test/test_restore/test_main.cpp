@@ -0,0 +1,73 @@
+// Timers saved before a reboot (setupBluetooth): the ones that would open up
+// the vehicle are dropped, the ones that secure it actuate with the first loop
+#include <unity.h>
+#include <vector>
+#include <Arduino.h>
+#include "host.h"
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/commands.h"
+#include "bluetooth/internal.h"
+#include "bluetooth/state.h"
+#include "bluetooth/timers.h"
+#include "config.h"
+
+namespace
+{
+    int locks = 0;
+    int unlocks = 0;
+    int engineStops = 0;
+    int windowCloses = 0;
+
+    void countLock(bool /* proximity */) { locks++; }
+    void countUnlock(bool /* proximity */) { unlocks++; }
+    void countEngineStop() { engineStops++; }
+    void countWindowClose() { windowCloses++; }
+
+    // The engine and window timers only run with their features (-D VEHICLE_FEATURES=0x0F)
+    const bool ALL_FEATURES = hasFeature(SUPPORTED_FEATURES, Feature::Engine | Feature::Windows);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_restored_securing_timers_actuate()
+{
+    timers::Table saved;
+    TEST_ASSERT_TRUE(saved.add(static_cast<uint8_t>(ClientCommand::LOCK_DOORS), timers::Kind::Scheduled, 3600000, 0));
+    TEST_ASSERT_TRUE(saved.add(static_cast<uint8_t>(ClientCommand::UNLOCK_DOORS), timers::Kind::Scheduled, 60000, 0));
+    if (ALL_FEATURES)
+    {
+        TEST_ASSERT_TRUE(saved.add(static_cast<uint8_t>(ClientCommand::STOP_ENGINE), timers::Kind::Scheduled, 60000, 0));
+        TEST_ASSERT_TRUE(saved.add(static_cast<uint8_t>(ClientCommand::CLOSE_WINDOWS), timers::Kind::Scheduled, 60000, 0));
+    }
+    uint8_t data[timers::MAX_TIMERS * timers::ENTRY_LENGTH];
+    writeTimers(data, saved.encode(0, data));
+
+    onLocked = countLock;
+    onUnlocked = countUnlock;
+    onEngineStopped = countEngineStop;
+    onWindowsClosed = countWindowClose;
+    setupBluetooth();
+    bluetoothLoop();
+
+    // Locked although the boot default already says locked
+    TEST_ASSERT_EQUAL(1, locks);
+    TEST_ASSERT_EQUAL(0, unlocks);
+    TEST_ASSERT_EQUAL(ALL_FEATURES ? 1 : 0, engineStops);
+    TEST_ASSERT_EQUAL(ALL_FEATURES ? 1 : 0, windowCloses);
+    TEST_ASSERT_EQUAL(0, readTimers(data, sizeof(data)));
+
+    host::advanceMillis(3600000);
+    bluetoothLoop();
+    TEST_ASSERT_EQUAL(1, locks);
+    TEST_ASSERT_EQUAL(0, unlocks);
+}
+
+int main()
+{
+    host::setSerialOutput(nullptr);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_restored_securing_timers_actuate);
+    return UNITY_END();
+}
@@ -0,0 +1,102 @@
+// Journal of the state bits behind STATE_DELTA and STATE_SINCE (state.h)
+#include <unity.h>
+#include "bluetooth/state.h"
+
+using namespace state;
+
+namespace
+{
+    const uint8_t ALL = Locked | EngineOn | WindowsOpen;
+    Journal journal;
+}
+
+void setUp()
+{
+    journal.reset(Locked, 1000);
+}
+
+void tearDown() {}
+
+void test_unchanged_bits_make_no_version()
+{
+    TEST_ASSERT_FALSE(journal.record(Locked));
+    TEST_ASSERT_EQUAL_UINT32(1000, journal.version());
+}
+
+void test_each_change_is_a_version()
+{
+    TEST_ASSERT_TRUE(journal.record(0));
+    TEST_ASSERT_TRUE(journal.record(EngineOn));
+    TEST_ASSERT_EQUAL_UINT32(1002, journal.version());
+    TEST_ASSERT_EQUAL_HEX8(EngineOn, journal.bits());
+
+    Delta latest = journal.latest();
+    TEST_ASSERT_EQUAL_HEX8(EngineOn, latest.changed);
+    TEST_ASSERT_EQUAL_UINT32(1002, latest.version);
+}
+
+void test_since_collects_the_bits_changed_after_a_version()
+{
+    journal.record(0);                  // 1001: doors
+    journal.record(EngineOn);           // 1002: engine
+    journal.record(EngineOn | Locked);  // 1003: doors
+
+    Delta delta = journal.since(1002, ALL);
+    TEST_ASSERT_EQUAL_HEX8(Locked, delta.changed);
+    TEST_ASSERT_EQUAL_HEX8(Locked | EngineOn, delta.bits);
+    TEST_ASSERT_EQUAL_UINT32(1003, delta.version);
+
+    TEST_ASSERT_EQUAL_HEX8(Locked | EngineOn, journal.since(1000, ALL).changed);
+    TEST_ASSERT_EQUAL_HEX8(0, journal.since(1003, ALL).changed);
+}
+
+void test_unknown_versions_report_every_bit()
+{
+    journal.record(0);
+    TEST_ASSERT_EQUAL_HEX8(ALL, journal.since(999, ALL).changed);  // Before the reset
+    TEST_ASSERT_EQUAL_HEX8(ALL, journal.since(1002, ALL).changed); // Not there yet
+    TEST_ASSERT_EQUAL_HEX8(ALL, journal.since(7, ALL).changed);    // Another boot
+}
+
+void test_forgets_changes_beyond_its_length()
+{
+    for (uint32_t i = 0; i < JOURNAL_LENGTH + 1; i++)
+        journal.record(i % 2 == 0 ? 0 : Locked);
+
+    TEST_ASSERT_EQUAL_HEX8(ALL, journal.since(1000, ALL).changed);
+    TEST_ASSERT_EQUAL_HEX8(Locked, journal.since(1001, ALL).changed);
+}
+
+void test_versions_wrap_around()
+{
+    journal.reset(Locked, 0xFFFFFFFF);
+    journal.record(0);
+    journal.record(WindowsOpen);
+    TEST_ASSERT_EQUAL_UINT32(1, journal.version());
+    TEST_ASSERT_EQUAL_HEX8(Locked | WindowsOpen, journal.since(0xFFFFFFFF, ALL).changed);
+    TEST_ASSERT_EQUAL_HEX8(WindowsOpen, journal.since(0, ALL).changed);
+}
+
+void test_bits_follow_the_features()
+{
+    TEST_ASSERT_EQUAL_HEX8(Locked | RelockPending | Scheduled, supportedBits(Feature::DoorsLock | Feature::TrunkOpen));
+    TEST_ASSERT_EQUAL_HEX8(0x3F, supportedBits(Feature::DoorsLock | Feature::Engine | Feature::Windows));
+
+    uint8_t out[DELTA_LENGTH];
+    encodeDelta({EngineOn, EngineOn | Locked, 0x01020304}, out);
+    const uint8_t expected[] = {EngineOn, EngineOn | Locked, 0x04, 0x03, 0x02, 0x01};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unchanged_bits_make_no_version);
+    RUN_TEST(test_each_change_is_a_version);
+    RUN_TEST(test_since_collects_the_bits_changed_after_a_version);
+    RUN_TEST(test_unknown_versions_report_every_bit);
+    RUN_TEST(test_forgets_changes_beyond_its_length);
+    RUN_TEST(test_versions_wrap_around);
+    RUN_TEST(test_bits_follow_the_features);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+// Timer table of UNLOCK_FOR, START_ENGINE_FOR and SCHEDULE (timers.h)
+#include <unity.h>
+#include "bluetooth/timers.h"
+
+using namespace timers;
+
+namespace
+{
+    // Command bytes, only stored and handed back by the table
+    const uint8_t LOCK = 0x02;
+    const uint8_t UNLOCK = 0x03;
+    const uint8_t STOP = 0x06;
+
+    Table table;
+
+    void fillScheduled(uint32_t nowMillis)
+    {
+        for (size_t i = 0; i < MAX_SCHEDULED; i++)
+            TEST_ASSERT_TRUE(table.add(LOCK, Kind::Scheduled, 60000, nowMillis));
+    }
+}
+
+void setUp()
+{
+    table = Table();
+}
+
+void tearDown() {}
+
+void test_scheduled_timers_leave_room_for_relock_and_shutoff()
+{
+    fillScheduled(0);
+    TEST_ASSERT_FALSE(table.hasRoom(Kind::Scheduled));
+    TEST_ASSERT_FALSE(table.add(UNLOCK, Kind::Scheduled, 1000, 0));
+
+    TEST_ASSERT_TRUE(table.hasRoom(Kind::Relock));
+    TEST_ASSERT_TRUE(table.add(LOCK, Kind::Relock, 10000, 0));
+    TEST_ASSERT_TRUE(table.add(STOP, Kind::Shutoff, 900000, 0));
+    TEST_ASSERT_EQUAL(MAX_TIMERS, table.count());
+    // Replacing them still works with a full table
+    TEST_ASSERT_TRUE(table.hasRoom(Kind::Relock));
+    TEST_ASSERT_TRUE(table.add(LOCK, Kind::Relock, 20000, 0));
+    TEST_ASSERT_EQUAL(1, table.count(Kind::Relock));
+}
+
+void test_relock_replaces_the_previous_one()
+{
+    table.add(LOCK, Kind::Relock, 10000, 0);
+    table.add(LOCK, Kind::Relock, 30000, 0);
+    Timer due;
+    TEST_ASSERT_FALSE(table.takeDue(10000, due));
+    TEST_ASSERT_TRUE(table.takeDue(30000, due));
+    TEST_ASSERT_EQUAL(Kind::Relock, due.kind);
+    TEST_ASSERT_EQUAL(0, table.count());
+}
+
+void test_takes_the_earliest_due_timer_first()
+{
+    table.add(LOCK, Kind::Scheduled, 5000, 0);
+    table.add(STOP, Kind::Shutoff, 2000, 0);
+    table.add(UNLOCK, Kind::Scheduled, 9000, 0);
+
+    Timer due;
+    TEST_ASSERT_FALSE(table.takeDue(1999, due));
+    TEST_ASSERT_TRUE(table.takeDue(6000, due));
+    TEST_ASSERT_EQUAL_HEX8(STOP, due.command);
+    TEST_ASSERT_TRUE(table.takeDue(6000, due));
+    TEST_ASSERT_EQUAL_HEX8(LOCK, due.command);
+    TEST_ASSERT_FALSE(table.takeDue(6000, due));
+    TEST_ASSERT_EQUAL(1, table.count());
+}
+
+void test_due_across_the_wrap_of_millis()
+{
+    const uint32_t now = 0xFFFFF000;
+    table.add(LOCK, Kind::Relock, 10000, now);
+    Timer due;
+    TEST_ASSERT_FALSE(table.takeDue(now + 5000, due)); // Wrapped, but not due yet
+    TEST_ASSERT_TRUE(table.takeDue(now + 10000, due));
+}
+
+void test_cancels_by_kind_and_by_command()
+{
+    table.add(LOCK, Kind::Relock, 10000, 0);
+    table.add(LOCK, Kind::Scheduled, 10000, 0);
+    table.add(UNLOCK, Kind::Scheduled, 10000, 0);
+    table.add(UNLOCK, Kind::Scheduled, 20000, 0);
+
+    TEST_ASSERT_TRUE(table.scheduled(UNLOCK));
+    TEST_ASSERT_TRUE(table.cancelScheduled(UNLOCK));
+    TEST_ASSERT_FALSE(table.cancelScheduled(UNLOCK));
+    TEST_ASSERT_FALSE(table.scheduled(UNLOCK));
+    TEST_ASSERT_TRUE(table.pending(Kind::Relock));
+    TEST_ASSERT_TRUE(table.cancel(Kind::Relock));
+    TEST_ASSERT_FALSE(table.pending(Kind::Relock));
+    TEST_ASSERT_EQUAL(1, table.count());
+    TEST_ASSERT_TRUE(table.scheduled(LOCK));
+    TEST_ASSERT_FALSE(table.cancel(Kind::Shutoff));
+}
+
+void test_encodes_seconds_left_rounded_up()
+{
+    table.add(LOCK, Kind::Relock, 10000, 1000);
+    table.add(STOP, Kind::Shutoff, 2000, 1000);
+
+    uint8_t out[MAX_TIMERS * ENTRY_LENGTH];
+    TEST_ASSERT_EQUAL(2 * ENTRY_LENGTH, table.encode(1500, out));
+    const uint8_t expected[] = {LOCK, 1, 10, 0, 0, 0, STOP, 2, 2, 0, 0, 0};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+
+    // Overdue ones have 0 left
+    table.encode(5000, out);
+    TEST_ASSERT_EQUAL(0, out[ENTRY_LENGTH + 2]);
+}
+
+void test_decodes_what_it_encoded()
+{
+    table.add(LOCK, Kind::Scheduled, 7200000, 0);
+    table.add(STOP, Kind::Shutoff, 900000, 0);
+    uint8_t saved[MAX_TIMERS * ENTRY_LENGTH];
+    size_t length = table.encode(0, saved);
+
+    Table restored;
+    restored.decode(saved, length, 50000);
+    TEST_ASSERT_EQUAL(2, restored.count());
+    Timer due;
+    TEST_ASSERT_FALSE(restored.takeDue(50000 + 899999, due));
+    TEST_ASSERT_TRUE(restored.takeDue(50000 + 900000, due));
+    TEST_ASSERT_EQUAL(Kind::Shutoff, due.kind);
+}
+
+void test_decode_skips_invalid_entries()
+{
+    const uint8_t saved[] = {
+        LOCK, 7, 10, 0, 0, 0,          // Unknown kind
+        LOCK, 0, 0xFF, 0xFF, 0xFF, 0,  // More than 7 days
+        LOCK, 1, 10, 0, 0, 0,          // Relock
+        LOCK, 1, 20, 0, 0, 0,          // Second relock
+        UNLOCK, 0, 5,                  // Cut off
+    };
+    table.decode(saved, sizeof(saved), 0);
+    TEST_ASSERT_EQUAL(1, table.count());
+    TEST_ASSERT_TRUE(table.pending(Kind::Relock));
+}
+
+void test_decode_keeps_the_reserved_slots()
+{
+    uint8_t saved[MAX_TIMERS * ENTRY_LENGTH];
+    for (size_t i = 0; i < MAX_TIMERS; i++)
+    {
+        uint8_t entry[ENTRY_LENGTH] = {LOCK, 0, static_cast<uint8_t>(i + 1), 0, 0, 0};
+        for (size_t b = 0; b < ENTRY_LENGTH; b++)
+            saved[i * ENTRY_LENGTH + b] = entry[b];
+    }
+    table.decode(saved, sizeof(saved), 0);
+    TEST_ASSERT_EQUAL(MAX_SCHEDULED, table.count());
+    TEST_ASSERT_TRUE(table.add(LOCK, Kind::Relock, 1000, 0));
+}
+
+void test_expire_makes_every_timer_due()
+{
+    table.add(LOCK, Kind::Scheduled, 3600000, 0);
+    table.add(STOP, Kind::Shutoff, 900000, 0);
+    table.expire(100);
+    Timer due;
+    TEST_ASSERT_TRUE(table.takeDue(100, due));
+    TEST_ASSERT_TRUE(table.takeDue(100, due));
+    TEST_ASSERT_EQUAL(0, table.count());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduled_timers_leave_room_for_relock_and_shutoff);
+    RUN_TEST(test_relock_replaces_the_previous_one);
+    RUN_TEST(test_takes_the_earliest_due_timer_first);
+    RUN_TEST(test_due_across_the_wrap_of_millis);
+    RUN_TEST(test_cancels_by_kind_and_by_command);
+    RUN_TEST(test_encodes_seconds_left_rounded_up);
+    RUN_TEST(test_decodes_what_it_encoded);
+    RUN_TEST(test_decode_skips_invalid_entries);
+    RUN_TEST(test_decode_keeps_the_reserved_slots);
+    RUN_TEST(test_expire_makes_every_timer_due);
+    return UNITY_END();
+}
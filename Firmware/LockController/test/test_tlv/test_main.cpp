@@ -0,0 +1,105 @@
+// TLV codec of SETTINGS and BATCH (tlv.h)
+#include <unity.h>
+#include "bluetooth/tlv.h"
+
+using namespace tlv;
+
+void setUp() {}
+void tearDown() {}
+
+void test_writes_version_and_fields()
+{
+    uint8_t out[32];
+    Writer writer(out, sizeof(out));
+    TEST_ASSERT_TRUE(writer.putU8(Setting::ProximityKey, 1));
+    TEST_ASSERT_TRUE(writer.putF32(Setting::TriggerRssi, -60.0f));
+
+    const uint8_t expected[] = {TLV_VERSION, 0x04, 1, 1, 0x01, 4, 0x00, 0x00, 0x70, 0xC2};
+    TEST_ASSERT_EQUAL(sizeof(expected), writer.length());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+    TEST_ASSERT_FALSE(writer.overflowed());
+}
+
+void test_leaves_out_fields_that_dont_fit()
+{
+    uint8_t out[8];
+    Writer writer(out, sizeof(out));
+    TEST_ASSERT_TRUE(writer.putU8(Setting::DeadZone, 4));
+    TEST_ASSERT_FALSE(writer.putF32(Setting::Cooldown, 1.0f));
+    TEST_ASSERT_TRUE(writer.overflowed());
+    // Nothing after an overflow, even if it would fit
+    TEST_ASSERT_FALSE(writer.putU8(Setting::ProximityKey, 0));
+    TEST_ASSERT_EQUAL(4, writer.length());
+}
+
+void test_reads_back_what_was_written()
+{
+    uint8_t out[32];
+    Writer writer(out, sizeof(out));
+    writer.putU32(Setting::Cooldown, 0xA1B2C3D4);
+    writer.putU8(Setting::DeadZone, 7);
+
+    Reader reader(out, writer.length());
+    TEST_ASSERT_TRUE(reader.valid());
+    Field field;
+    TEST_ASSERT_TRUE(reader.next(field));
+    TEST_ASSERT_EQUAL_HEX8(Setting::Cooldown, field.tag);
+    TEST_ASSERT_EQUAL_UINT32(0xA1B2C3D4, field.value.u32(0));
+    TEST_ASSERT_TRUE(reader.next(field));
+    TEST_ASSERT_EQUAL_HEX8(Setting::DeadZone, field.tag);
+    TEST_ASSERT_EQUAL(7, field.value.u8(0));
+    TEST_ASSERT_FALSE(reader.next(field));
+    TEST_ASSERT_FALSE(reader.truncated());
+}
+
+void test_skips_unknown_tags_by_their_length()
+{
+    const uint8_t data[] = {TLV_VERSION, 0x7E, 3, 0xDE, 0xAD, 0xBE, 0x02, 1, 9};
+    Reader reader(data, sizeof(data));
+    Field field;
+    TEST_ASSERT_TRUE(reader.next(field));
+    TEST_ASSERT_EQUAL_HEX8(0x7E, field.tag);
+    TEST_ASSERT_EQUAL(3, field.value.length());
+    TEST_ASSERT_TRUE(reader.next(field));
+    TEST_ASSERT_EQUAL_HEX8(0x02, field.tag);
+    TEST_ASSERT_EQUAL(9, field.value.u8(0));
+}
+
+void test_detects_a_cut_off_field()
+{
+    const uint8_t data[] = {TLV_VERSION, 0x01, 4, 0x00, 0x00};
+    Reader reader(data, sizeof(data));
+    Field field;
+    TEST_ASSERT_FALSE(reader.next(field));
+    TEST_ASSERT_TRUE(reader.truncated());
+
+    // A lone tag byte at the end is cut off too
+    const uint8_t lone[] = {TLV_VERSION, 0x02, 1, 5, 0x03};
+    Reader second(lone, sizeof(lone));
+    TEST_ASSERT_TRUE(second.next(field));
+    TEST_ASSERT_FALSE(second.next(field));
+    TEST_ASSERT_TRUE(second.truncated());
+}
+
+void test_rejects_other_versions()
+{
+    const uint8_t data[] = {TLV_VERSION + 1, 0x02, 1, 5};
+    Reader reader(data, sizeof(data));
+    Field field;
+    TEST_ASSERT_FALSE(reader.valid());
+    TEST_ASSERT_EQUAL(TLV_VERSION + 1, reader.version());
+    TEST_ASSERT_FALSE(reader.next(field));
+    TEST_ASSERT_FALSE(Reader(nullptr, 0).valid());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_writes_version_and_fields);
+    RUN_TEST(test_leaves_out_fields_that_dont_fit);
+    RUN_TEST(test_reads_back_what_was_written);
+    RUN_TEST(test_skips_unknown_tags_by_their_length);
+    RUN_TEST(test_detects_a_cut_off_field);
+    RUN_TEST(test_rejects_other_versions);
+    return UNITY_END();
+}
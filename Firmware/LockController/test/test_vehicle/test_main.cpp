@@ -0,0 +1,133 @@
+// Rule table of the vehicle state machine (vehicle.h)
+#include <unity.h>
+#include "bluetooth/vehicle.h"
+
+using namespace vehicle;
+
+namespace
+{
+    const uint32_t REPEAT = 30000;
+    const uint32_t MERGE = 1500;
+    Machine machine;
+}
+
+void setUp()
+{
+    machine = Machine();
+    machine.configure({REPEAT, MERGE});
+    machine.reset(state::Locked);
+}
+
+void tearDown() {}
+
+void test_command_actuates_and_takes_the_state()
+{
+    Decision decision = machine.request(Device::Doors, false, Source::Command, 1000);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, decision.outcome);
+    TEST_ASSERT_EQUAL_UINT32(1, decision.sequence);
+    TEST_ASSERT_FALSE(machine.isOn(Device::Doors));
+    TEST_ASSERT_EQUAL_HEX8(0, machine.bits());
+}
+
+void test_repeated_command_is_redundant_within_the_window()
+{
+    machine.request(Device::Doors, false, Source::Command, 1000);
+    Decision decision = machine.request(Device::Doors, false, Source::Command, 1000 + REPEAT - 1);
+    TEST_ASSERT_EQUAL(Outcome::Redundant, decision.outcome);
+    TEST_ASSERT_EQUAL_UINT32(1, decision.sequence);
+
+    // Later the tracked state may be stale, it actuates again
+    decision = machine.request(Device::Doors, false, Source::Command, 1000 + REPEAT);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, decision.outcome);
+    TEST_ASSERT_EQUAL_UINT32(2, decision.sequence);
+}
+
+void test_command_for_the_boot_state_actuates()
+{
+    // Nothing changed since the reset, so nothing says the state is fresh
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Doors, true, Source::Command, 10).outcome);
+}
+
+void test_proximity_doesnt_undo_a_fresh_command()
+{
+    machine.request(Device::Doors, false, Source::Command, 1000);
+    TEST_ASSERT_EQUAL(Outcome::Merged, machine.request(Device::Doors, true, Source::Proximity, 1000 + MERGE - 1).outcome);
+    TEST_ASSERT_FALSE(machine.isOn(Device::Doors));
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Doors, true, Source::Proximity, 1000 + MERGE).outcome);
+}
+
+void test_proximity_acts_after_its_own_change()
+{
+    machine.request(Device::Doors, false, Source::Proximity, 1000);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Doors, true, Source::Proximity, 1100).outcome);
+}
+
+void test_automatic_sources_skip_a_state_already_reached()
+{
+    TEST_ASSERT_EQUAL(Outcome::Redundant, machine.request(Device::Doors, true, Source::Proximity, 100000).outcome);
+    TEST_ASSERT_EQUAL(Outcome::Redundant, machine.request(Device::Doors, true, Source::AutoLock, 100000).outcome);
+    TEST_ASSERT_EQUAL(Outcome::Redundant, machine.request(Device::Doors, true, Source::Report, 100000).outcome);
+    TEST_ASSERT_EQUAL(Outcome::Redundant, machine.request(Device::Doors, true, Source::Timer, 100000).outcome);
+    TEST_ASSERT_EQUAL_UINT32(0, machine.sequence());
+}
+
+void test_timer_actuates_a_change()
+{
+    machine.request(Device::Engine, true, Source::Command, 1000);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Engine, false, Source::Timer, 1001).outcome);
+    TEST_ASSERT_FALSE(machine.isOn(Device::Engine));
+}
+
+void test_restored_timer_actuates_from_the_seeded_state()
+{
+    // setupBluetooth seeds the opposite of what a restored timer secures
+    machine.reset(state::EngineOn | state::WindowsOpen);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Doors, true, Source::Timer, 0).outcome);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Engine, false, Source::Timer, 0).outcome);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Windows, false, Source::Timer, 0).outcome);
+    TEST_ASSERT_EQUAL_HEX8(state::Locked, machine.bits());
+}
+
+void test_report_only_records()
+{
+    Decision decision = machine.request(Device::Windows, true, Source::Report, 1000);
+    TEST_ASSERT_EQUAL(Outcome::Record, decision.outcome);
+    TEST_ASSERT_TRUE(decision.accepted());
+    TEST_ASSERT_EQUAL_UINT32(1, decision.sequence);
+    TEST_ASSERT_TRUE(machine.isOn(Device::Windows));
+}
+
+void test_devices_are_independent()
+{
+    machine.request(Device::Doors, false, Source::Command, 1000);
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Engine, true, Source::Proximity, 1001).outcome);
+    TEST_ASSERT_EQUAL_HEX8(state::EngineOn, machine.bits());
+}
+
+void test_reset_keeps_the_sequence()
+{
+    machine.request(Device::Doors, false, Source::Command, 1000);
+    machine.reset(state::Locked);
+    TEST_ASSERT_TRUE(machine.isOn(Device::Doors));
+    TEST_ASSERT_EQUAL_UINT32(1, machine.sequence());
+    // The window of the command before the reset is forgotten
+    TEST_ASSERT_EQUAL(Outcome::Actuate, machine.request(Device::Doors, false, Source::Proximity, 1001).outcome);
+    TEST_ASSERT_EQUAL_UINT32(2, machine.sequence());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_command_actuates_and_takes_the_state);
+    RUN_TEST(test_repeated_command_is_redundant_within_the_window);
+    RUN_TEST(test_command_for_the_boot_state_actuates);
+    RUN_TEST(test_proximity_doesnt_undo_a_fresh_command);
+    RUN_TEST(test_proximity_acts_after_its_own_change);
+    RUN_TEST(test_automatic_sources_skip_a_state_already_reached);
+    RUN_TEST(test_timer_actuates_a_change);
+    RUN_TEST(test_restored_timer_actuates_from_the_seeded_state);
+    RUN_TEST(test_report_only_records);
+    RUN_TEST(test_devices_are_independent);
+    RUN_TEST(test_reset_keeps_the_sequence);
+    return UNITY_END();
+}
@@ -0,0 +1,232 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <random>
+#include "traces.h"
+#include "proximity/zones.h"
+
+namespace traces
+{
+    bool readTrace(const char *path, std::vector<Reading> &trace, std::vector<Reading> *phone)
+    {
+        FILE *file = fopen(path, "r");
+        if (file == nullptr)
+            return false;
+
+        char line[128];
+        while (fgets(line, sizeof(line), file))
+        {
+            Reading reading;
+            int near = -1;
+            int phoneRssi;
+            if (phone != nullptr && sscanf(line, "%lu,,phone:%d", &reading.millis, &phoneRssi) == 2)
+            {
+                phone->push_back({reading.millis, static_cast<float>(phoneRssi), -1});
+                continue;
+            }
+
+            int fields = sscanf(line, "%lu,%f,%d", &reading.millis, &reading.rssi, &near);
+            if (fields < 2)
+                continue;
+            reading.near = fields == 3 ? near : -1;
+            trace.push_back(reading);
+        }
+        fclose(file);
+        return true;
+    }
+
+    namespace
+    {
+        struct Point
+        {
+            float seconds;
+            float rssi;
+        };
+
+        // Walks along the mean RSSI of `path` (linear in between), one reading
+        // per 500ms with noise and fades, labelled with the thresholds
+        std::vector<Reading> sample(const std::vector<Point> &path, unsigned seed, float triggerRssi, float releaseRssi, std::vector<Reading> *phone)
+        {
+            std::mt19937 random(seed);
+            std::mt19937 phoneRandom(seed ^ 0x5EED); // Leaves the controller readings as they were
+            std::normal_distribution<float> noise(0, 4);
+            std::uniform_real_distribution<float> chance(0, 1);
+
+            size_t segment = 0;
+            auto meanAt = [&](unsigned long millis) {
+                float seconds = millis / 1000.0f;
+                size_t at = segment;
+                while (at + 2 < path.size() && seconds > path[at + 1].seconds)
+                    at++;
+                float progress = (seconds - path[at].seconds) / (path[at + 1].seconds - path[at].seconds);
+                return path[at].rssi + std::min(1.0f, progress) * (path[at + 1].rssi - path[at].rssi);
+            };
+
+            std::vector<Reading> trace;
+            for (unsigned long millis = 0; millis <= path.back().seconds * 1000; millis += 500)
+            {
+                // Readings only move forward, the phone's are at most 250ms ahead
+                while (segment + 2 < path.size() && millis / 1000.0f > path[segment + 1].seconds)
+                    segment++;
+
+                float mean = meanAt(millis);
+                float rssi = mean + noise(random);
+                if (chance(random) < 0.05f)
+                    rssi -= 15; // Body or door in between
+                trace.push_back({millis, roundf(rssi), mean > triggerRssi ? 1 : (mean < releaseRssi ? 0 : -2)});
+
+                if (phone != nullptr)
+                {
+                    float phoneRssi = meanAt(millis + 250) - 4 + noise(phoneRandom);
+                    if (chance(phoneRandom) < 0.05f)
+                        phoneRssi -= 15;
+                    phone->push_back({millis + 250, roundf(phoneRssi), -1});
+                }
+            }
+
+            // Between the thresholds the phone keeps its previous state
+            int near = 0;
+            for (Reading &reading : trace)
+            {
+                if (reading.near == -2)
+                    reading.near = near;
+                near = reading.near;
+            }
+            return trace;
+        }
+    }
+
+    std::vector<Reading> syntheticTrace(unsigned seed, float triggerRssi, float releaseRssi, std::vector<Reading> *phone)
+    {
+        const std::vector<Point> path = {{0, -88}, {40, -88}, {70, -50}, {130, -50}, {160, -85}, {200, -85}, {215, -55}, {260, -55},
+                                         {290, -88}, {310, -88}, {330, -64}, {340, -64}, {360, -88}, {380, -88}};
+        return sample(path, seed, triggerRssi, releaseRssi, phone);
+    }
+
+    std::vector<Reading> syntheticDay(unsigned seed, float triggerRssi, float releaseRssi, std::vector<Reading> *phone, std::vector<Tap> *taps)
+    {
+        std::mt19937 random(seed ^ 0xDA7);
+        std::uniform_real_distribution<float> chance(0, 1);
+        std::uniform_real_distribution<float> jitter(-300, 300);
+        std::uniform_real_distribution<float> stay(120, 1200);
+
+        const float visits[] = {7.5f, 12.25f, 13.0f, 17.5f, 19.0f, 21.75f}; // Hours
+        const float passes[] = {10.0f, 15.5f, 20.25f};
+        std::vector<Point> path = {{0, -88}};
+        std::vector<Tap> schedule;
+        size_t pass = 0;
+        for (float hour : visits)
+        {
+            float start = hour * 3600 + jitter(random);
+            while (pass < sizeof(passes) / sizeof(passes[0]) && passes[pass] * 3600 < start)
+            {
+                // Walks past without getting into range
+                float at = passes[pass++] * 3600;
+                path.insert(path.end(), {{at, -88}, {at + 20, -64}, {at + 30, -64}, {at + 50, -88}});
+            }
+
+            // Walks up in 30s, stays near (loading, driving), walks away in 30s
+            float leave = start + 30 + stay(random);
+            path.insert(path.end(), {{start, -88}, {start + 30, -50}, {leave, -50}, {leave + 30, -88}});
+
+            // Unlocks from the app on the way (before the proximity key does),
+            // sometimes twice
+            if (chance(random) < 0.4f)
+            {
+                schedule.push_back({static_cast<unsigned long>((start + 20) * 1000), true});
+                if (chance(random) < 0.3f)
+                    schedule.push_back({static_cast<unsigned long>((start + 20.8f) * 1000), true});
+            }
+            // Opens it for someone else right when leaving the range
+            if (chance(random) < 0.1f)
+                schedule.push_back({static_cast<unsigned long>((leave + 28) * 1000), true});
+            // Checks that it locked after walking off, sometimes twice
+            if (chance(random) < 0.5f)
+            {
+                float check = leave + 40 + 20 * chance(random);
+                schedule.push_back({static_cast<unsigned long>(check * 1000), false});
+                if (chance(random) < 0.3f)
+                    schedule.push_back({static_cast<unsigned long>((check + 0.8f) * 1000), false});
+            }
+        }
+        path.push_back({24 * 3600, -88});
+
+        if (taps != nullptr)
+            *taps = schedule;
+        return sample(path, seed, triggerRssi, releaseRssi, phone);
+    }
+
+    std::vector<Transition> reference(const std::vector<Reading> &trace, float triggerRssi, float releaseRssi)
+    {
+        std::vector<Transition> transitions;
+        if (!trace.empty() && trace[0].near >= 0)
+        {
+            bool near = false;
+            for (const Reading &reading : trace)
+            {
+                if ((reading.near != 0) != near)
+                {
+                    near = reading.near != 0;
+                    transitions.push_back({reading.millis, near});
+                }
+            }
+            return transitions;
+        }
+
+        proximity::ZoneTracker zones;
+        zones.configure({triggerRssi, releaseRssi, 0, 0, 0});
+        zones.reset(false);
+
+        const size_t half = 4;
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            std::vector<float> window;
+            for (size_t j = i > half ? i - half : 0; j <= i + half && j < trace.size(); j++)
+                window.push_back(trace[j].rssi);
+            std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+
+            proximity::Action action = zones.update(window[window.size() / 2], trace[i].millis);
+            if (action != proximity::Action::None)
+                transitions.push_back({trace[i].millis, action == proximity::Action::Unlock});
+        }
+        return transitions;
+    }
+
+    void compare(const std::vector<Transition> &expected, const std::vector<Transition> &actual, Result results[2])
+    {
+        size_t matched[2] = {0, 0};
+        for (size_t e = 0; e < expected.size(); e++)
+        {
+            unsigned long from = e > 0 ? expected[e - 1].millis : 0;
+            unsigned long until = e + 1 < expected.size() ? expected[e + 1].millis : ~0UL;
+            long best = 0;
+            bool found = false;
+            for (const Transition &transition : actual)
+            {
+                if (transition.near != expected[e].near || transition.millis <= from || transition.millis >= until)
+                    continue;
+                long lag = static_cast<long>(transition.millis) - static_cast<long>(expected[e].millis);
+                if (!found || labs(lag) < labs(best))
+                    best = lag;
+                found = true;
+            }
+
+            Result &result = results[expected[e].near ? 0 : 1];
+            if (!found)
+            {
+                result.missed++;
+                continue;
+            }
+
+            result.lagSum += best;
+            result.lagMax = std::max(result.lagMax, best);
+            result.matched++;
+            matched[expected[e].near ? 0 : 1]++;
+        }
+
+        size_t unlocks = std::count_if(actual.begin(), actual.end(), [](const Transition &t) { return t.near; });
+        results[0].falseTriggers += unlocks - matched[0];
+        results[1].falseTriggers += actual.size() - unlocks - matched[1];
+    }
+}
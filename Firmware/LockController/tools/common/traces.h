@@ -0,0 +1,77 @@
+#ifndef TOOLS_TRACES_H
+#define TOOLS_TRACES_H
+
+// RSSI traces for the host tools (tools/rssi_filters, tools/replay): reading
+// them, generating synthetic ones, and comparing the locks/unlocks decided on
+// them with a reference.
+#include <stddef.h>
+#include <vector>
+
+namespace traces
+{
+    struct Reading
+    {
+        unsigned long millis;
+        float rssi;
+        int near; // -1 when not labelled
+    };
+
+    /// @brief An unlock (near) or lock
+    struct Transition
+    {
+        unsigned long millis;
+        bool near;
+    };
+
+    /// @brief The user pressing unlock or lock in the app
+    struct Tap
+    {
+        unsigned long millis;
+        bool unlock;
+    };
+
+    /// @brief Comparison with the reference, per direction (unlock, lock)
+    struct Result
+    {
+        size_t matched = 0;
+        size_t missed = 0;
+        size_t falseTriggers = 0;
+        double lagSum = 0;
+        long lagMax = 0;
+
+        double meanLag() const { return matched ? lagSum / matched : 0.0; }
+    };
+
+    /// @brief Reads `millis,rssi[,near]` lines, and `millis,,phone:rssi` lines
+    /// (RSSI the phone measured) into phone if given, others are skipped (so the
+    /// CSV of tools/trace_decoder works as it is). False if it can't be opened
+    bool readTrace(const char *path, std::vector<Reading> &trace, std::vector<Reading> *phone = nullptr);
+
+    /// @brief Walks up to the car, waits and leaves twice, then walks past it
+    /// without getting into range. One reading per 500ms with log-normal noise
+    /// and occasional deep fades, labelled with the thresholds. If phone is
+    /// given, it gets what the phone measures on the same walk: 4 dB lower,
+    /// shifted by 250ms, with its own noise and fades
+    std::vector<Reading> syntheticTrace(unsigned seed, float triggerRssi, float releaseRssi, std::vector<Reading> *phone = nullptr);
+
+    /// @brief 24 hours like syntheticTrace: six visits to the car (walk up,
+    /// stay 2-20 minutes, walk away) and three walks past it. If taps is given,
+    /// it gets what the user does in the app meanwhile: sometimes unlocks on
+    /// the way, checks that it locked after walking off, taps twice or unlocks
+    /// again right when leaving
+    std::vector<Reading> syntheticDay(unsigned seed, float triggerRssi, float releaseRssi, std::vector<Reading> *phone = nullptr,
+                                      std::vector<Tap> *taps = nullptr);
+
+    /// @brief The labels of the trace, or without them a centered (so not
+    /// causal) median of 9 readings run through the thresholds
+    std::vector<Transition> reference(const std::vector<Reading> &trace, float triggerRssi, float releaseRssi);
+
+    /// @brief Every reference transition is matched with the closest actual
+    /// transition to the same state between the previous and the next reference
+    /// transition (it may come early, then the lag is negative). All other
+    /// actual transitions are false triggers. Adds to results[0] (unlocks) and
+    /// results[1] (locks)
+    void compare(const std::vector<Transition> &expected, const std::vector<Transition> &actual, Result results[2]);
+}
+
+#endif
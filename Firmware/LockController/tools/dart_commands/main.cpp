@@ -0,0 +1,118 @@
+// Generates the app's command and response enums from the protocol schema
+// (src/bluetooth/schema.h, env:dart_commands), so both sides use the same IDs.
+//
+//   dart_commands > ../../MobileApp/lib/types/ble_commands.dart
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace
+{
+    struct Entry
+    {
+        const char *name;
+        unsigned id;
+        const char *response; // Commands only, "NONE" if not answered
+        const char *doc;
+    };
+
+    const Entry COMMAND_ENTRIES[] = {
+#define COMMAND(name, id, min, max, step, feature, response, handler, doc) {#name, id, #response, doc},
+#include "bluetooth/schema.h"
+#undef COMMAND
+    };
+
+    const Entry RESPONSE_ENTRIES[] = {
+#define RESPONSE(name, id, doc) {#name, id, nullptr, doc},
+#include "bluetooth/schema.h"
+#undef RESPONSE
+    };
+
+    const size_t LINE_LENGTH = 80;
+
+    // `  /// ` lines of at most LINE_LENGTH, paragraphs (\n in the schema)
+    // separated by an empty doc line
+    void printDoc(const char *doc)
+    {
+        const std::string prefix = "  /// ";
+        std::string line;
+        for (const char *position = doc;; position++)
+        {
+            if (*position == '\n' || *position == '\0')
+            {
+                printf("%s%s\n", prefix.c_str(), line.c_str());
+                line.clear();
+                if (*position == '\0')
+                    return;
+                printf("  ///\n");
+                continue;
+            }
+
+            line += *position;
+            if (prefix.length() + line.length() > LINE_LENGTH)
+            {
+                size_t space = line.rfind(' ');
+                if (space == std::string::npos)
+                    continue;
+                printf("%s%s\n", prefix.c_str(), line.substr(0, space).c_str());
+                line = line.substr(space + 1);
+            }
+        }
+    }
+
+    void printFromValue(const char *type, const char *variable)
+    {
+        printf("  /// Convert from integer value to enum\n");
+        printf("  static %s? fromValue(int value) {\n", type);
+        printf("    for (%s %s in %s.values) {\n", type, variable, type);
+        printf("      if (%s.value == value) {\n", variable);
+        printf("        return %s;\n", variable);
+        printf("      }\n");
+        printf("    }\n");
+        printf("    return null;\n");
+        printf("  }\n");
+    }
+}
+
+int main()
+{
+    printf("// Generated by Firmware/LockController/tools/dart_commands from\n");
+    printf("// Firmware/LockController/src/bluetooth/schema.h, don't edit by hand.\n");
+    printf("// ignore_for_file: constant_identifier_names\n\n");
+
+    const size_t commands = sizeof(COMMAND_ENTRIES) / sizeof(COMMAND_ENTRIES[0]);
+    printf("/// Commands sent by the client/app to the ESP32\n");
+    printf("enum ClientCommand {\n");
+    for (size_t i = 0; i < commands; i++)
+    {
+        const Entry &entry = COMMAND_ENTRIES[i];
+        printDoc(entry.doc);
+        if (strcmp(entry.response, "NONE") == 0)
+            printf("  %s(0x%02X, null)", entry.name, entry.id);
+        else
+            printf("  %s(0x%02X, Esp32Response.%s)", entry.name, entry.id, entry.response);
+        printf(i + 1 < commands ? ",\n\n" : ";\n\n");
+    }
+    printf("  const ClientCommand(this.value, this.response);\n");
+    printf("  final int value;\n\n");
+    printf("  /// What the ESP32 answers with, null if nothing\n");
+    printf("  final Esp32Response? response;\n\n");
+    printFromValue("ClientCommand", "command");
+    printf("}\n\n");
+
+    const size_t responses = sizeof(RESPONSE_ENTRIES) / sizeof(RESPONSE_ENTRIES[0]);
+    printf("/// ESP32-to-Client Commands\n");
+    printf("enum Esp32Response {\n");
+    for (size_t i = 0; i < responses; i++)
+    {
+        const Entry &entry = RESPONSE_ENTRIES[i];
+        printDoc(entry.doc);
+        printf("  %s(0x%02X)", entry.name, entry.id);
+        printf(i + 1 < responses ? ",\n\n" : ";\n\n");
+    }
+    printf("  const Esp32Response(this.value);\n");
+    printf("  final int value;\n\n");
+    printFromValue("Esp32Response", "response");
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Turns a binary log dump of the controller back into text (env:log_decoder).
+//
+//   log_decoder [dump.txt]             serial capture containing the `lg` output
+//   log_decoder --binary [dump.bin]    raw 20 byte records
+//
+// Without a file it reads stdin. Lines of the capture that are not part of a
+// dump are ignored, so a whole serial session can be piped through it.
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "log/format.h"
+
+namespace
+{
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    bool parseRecord(const char *hex, logging::Record &record)
+    {
+        uint8_t *bytes = reinterpret_cast<uint8_t *>(&record);
+        for (size_t i = 0; i < sizeof(record); i++)
+        {
+            int high = hexValue(hex[2 * i]);
+            int low = high < 0 ? -1 : hexValue(hex[2 * i + 1]);
+            if (low < 0)
+                return false;
+            bytes[i] = static_cast<uint8_t>(high << 4 | low);
+        }
+        return true;
+    }
+
+    void printRecord(const logging::Record &record)
+    {
+        char line[256];
+        logging::formatRecord(record, line, sizeof(line));
+        puts(line);
+    }
+
+    int decodeText(FILE *input)
+    {
+        char line[512];
+        while (fgets(line, sizeof(line), input))
+        {
+            const char *dump = strstr(line, "#LOG ");
+            if (dump == nullptr)
+                continue;
+            dump += 5;
+
+            if (dump[0] == 'v')
+            {
+                unsigned version = strtoul(dump + 1, nullptr, 10);
+                if (version != LOG_FORMAT_VERSION)
+                    fprintf(stderr, "Warning: dump has log format v%u, decoder is v%u\n", version, LOG_FORMAT_VERSION);
+                continue;
+            }
+
+            logging::Record record;
+            if (!parseRecord(dump, record))
+            {
+                fprintf(stderr, "Skipping malformed record: %s", dump);
+                continue;
+            }
+            printRecord(record);
+        }
+        return 0;
+    }
+
+    int decodeBinary(FILE *input)
+    {
+        logging::Record record;
+        while (fread(&record, sizeof(record), 1, input) == 1)
+            printRecord(record);
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool binary = false;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--binary") == 0)
+            binary = true;
+        else
+            path = argv[i];
+    }
+
+    FILE *input = stdin;
+    if (path != nullptr)
+    {
+        input = fopen(path, binary ? "rb" : "r");
+        if (input == nullptr)
+        {
+            fprintf(stderr, "Can't open %s\n", path);
+            return 1;
+        }
+    }
+
+    int result = binary ? decodeBinary(input) : decodeText(input);
+
+    if (input != stdin)
+        fclose(input);
+    return result;
+}
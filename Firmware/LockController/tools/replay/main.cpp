@@ -0,0 +1,586 @@
+// Replays RSSI traces through the controller core under a virtual clock
+// (env:replay, Linux only).
+//
+//   replay [options] trace.csv...
+//   replay [options] --synthetic [seed]...
+//   replay [options] --day [seed]...
+//
+// Unlike tools/rssi_filters this runs the real firmware (src/bluetooth with the
+// shims of env:native): the settings are sent as authenticated commands like
+// the app does, bluetoothLoop() runs every 10 virtual ms and whenever it asks
+// for an RSSI reading it gets the newest reading of the trace. So adaptive
+// polling, filters, dwell times and the cooldown all act as on the board.
+//
+// With --connect the phone is only connected while it is in range: the
+// connection is up `ms` after the RSSI went above `dBm` (advertising, connect,
+// service discovery and the commands the app sends) and drops after it was
+// 6 dB below that for 4s. Before the trace it was connected once with the
+// proximity key on. With --presence 1 it advertises its presence token every
+// 100ms while not connected (needs PRESENCE_SCAN, on in env:replay), so
+// `--presence 0,1` compares the unlock latency after re-entering range with
+// and without presence detection.
+//
+// With --fusion 1 the app sends the RSSI the phone measured (the `phone:`
+// lines of the trace, synthetic traces have them) with PHONE_RSSI once a second
+// while connected, so `--fusion 0,1` shows what fusing both directions does to
+// false actuations and latency.
+//
+// --day replays a synthetic day (traces::syntheticDay): six visits to the car
+// and the lock/unlock taps of the user in the app meanwhile, sent while
+// connected, so the relay cycles and notifications show what a day costs.
+//
+// Every option below takes a list (`-65,-60`) or a range (`-70:-55:5`), the
+// replay runs for every combination, spread over all cores (one process per
+// combination, forked after setupBluetooth(), so each starts from a clean
+// controller). Per combination it prints how long after the reference the
+// vehicle unlocked/locked, how many reference transitions it missed, false
+// actuations per hour, relay cycles, notifications (the phone subscribes to the
+// state characteristic like the app) and RSSI reads per minute.
+//
+// Options:
+//   --trigger <dBm>            Trigger RSSI (default -60)
+//   --dead-zone <m>            Dead zone, whole meters (default 4)
+//   --cooldown <min>           Proximity cooldown (default 0.5)
+//   --filter <type>:<a>[:<b>]  RSSI_FILTER (sma, ema, median, kalman), repeatable (default sma:5)
+//   --presence <0|1>           phone advertises its presence token while not connected (default 0)
+//   --fusion <0|1>             phone sends its RSSI samples while connected (default 0)
+//   --connect <dBm>:<ms>       only connected while in range, see above (default: always connected)
+//   --reference <dBm>:<dBm>    thresholds of the reference for traces without labels
+//                              and of the synthetic labels (default -60 and 5m below)
+//   --jobs <n>                 parallel replays (default: number of cores)
+//   --csv                      print CSV instead of a table
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "host.h"
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/commands.h"
+#include "bluetooth/presence.h"
+#include "bluetooth/tlv.h"
+#include "proximity/filter.h"
+#include "proximity/fusion.h"
+#include "../common/traces.h"
+
+using namespace traces;
+using proximity::FilterConfig;
+using proximity::FilterType;
+
+namespace
+{
+    struct Settings
+    {
+        float trigger;
+        float deadZone;
+        float cooldown;
+        bool presence;
+        bool fusion;
+        FilterConfig filter;
+    };
+
+    // Written by the replay process into a pipe, so plain data only
+    struct Outcome
+    {
+        Result results[2];
+        double hours;
+        uint32_t relayCycles;
+        uint32_t notifications;
+        uint32_t rssiReads;
+        bool valid;
+    };
+
+    const unsigned long LOOP_INTERVAL = 10;
+    const unsigned long ADVERTISING_INTERVAL = 100;
+    const unsigned long PHONE_RSSI_INTERVAL = 1000;
+    // Below the connect RSSI by this much for this long drops the connection
+    const float DISCONNECT_MARGIN = 6;
+    const unsigned long SUPERVISION_TIMEOUT = 4000;
+    const char *const TYPE_NAMES[] = {"sma", "ema", "median", "kalman"};
+    const char *const STATE_UUID = "0000ffe2-0000-1000-8000-00805f9b34fb";
+
+    float referenceTrigger = -60;
+    float referenceRelease = NAN;
+    bool connectModel = false;
+    float connectRssi = -80;
+    unsigned long connectDelay = 2000;
+
+    std::vector<Transition> *actuations = nullptr;
+    uint32_t relayCycles = 0;
+    uint32_t counter = 1;
+
+    // Only the proximity key's actuations are compared with the reference
+    void actuated(bool near, bool proximity)
+    {
+        relayCycles++;
+        if (actuations && proximity)
+            actuations->push_back({millis(), near});
+    }
+
+    void send(ClientCommand command, const uint8_t *data = nullptr, uint8_t length = 0)
+    {
+        host::write(host::buildFrame(counter++, static_cast<uint8_t>(command), data, length));
+    }
+
+    // All settings in one SETTINGS frame, like the app does on connect
+    void configure(const Settings &settings)
+    {
+        uint8_t data[27];
+        tlv::Writer writer(data, sizeof(data));
+        writer.putF32(tlv::Setting::Cooldown, settings.cooldown);
+        writer.putF32(tlv::Setting::TriggerRssi, settings.trigger);
+        writer.putU8(tlv::Setting::DeadZone, static_cast<uint8_t>(settings.deadZone));
+
+        uint8_t filter[proximity::FILTER_CONFIG_LENGTH];
+        size_t length = proximity::encodeFilterConfig(settings.filter, filter);
+        writer.putBytes(tlv::Setting::RssiFilter, filter, length);
+        send(ClientCommand::SETTINGS, data, writer.length());
+
+        send(ClientCommand::PROXIMITY_KEY_ON);
+    }
+
+    void connectPhone(const Settings &settings)
+    {
+        host::connect();
+        host::subscribe(STATE_UUID, true);
+        configure(settings);
+    }
+
+    // Sends the phone samples after `sent` up to now, returns the newest one sent
+    size_t sendPhoneRssi(const std::vector<Reading> &phone, size_t sent)
+    {
+        proximity::PhoneSample samples[proximity::MAX_PHONE_SAMPLES];
+        size_t count = 0;
+        while (sent < phone.size() && phone[sent].millis <= millis() && count < proximity::MAX_PHONE_SAMPLES)
+        {
+            samples[count++] = {static_cast<int8_t>(lroundf(phone[sent].rssi)), static_cast<uint32_t>(phone[sent].millis)};
+            sent++;
+        }
+
+        if (count > 0)
+        {
+            uint8_t data[proximity::MAX_PHONE_SAMPLES * 2];
+            size_t length = proximity::encodePhoneSamples(samples, count, millis(), data);
+            send(ClientCommand::PHONE_RSSI, data, length);
+        }
+        return sent;
+    }
+
+    // Runs in its own process: the controller state is global
+    Outcome replay(const Settings &settings, const std::vector<std::vector<Reading>> &traces, const std::vector<std::vector<Reading>> &phoneTraces,
+                   const std::vector<std::vector<Tap>> &tapTraces)
+    {
+        host::setSerialOutput(nullptr);
+        onLocked = [](bool proximity) { actuated(false, proximity); };
+        onUnlocked = [](bool proximity) { actuated(true, proximity); };
+
+        Outcome outcome = {};
+        for (size_t t = 0; t < traces.size(); t++)
+        {
+            const std::vector<Reading> &trace = traces[t];
+            const std::vector<Reading> &phone = phoneTraces[t];
+            const std::vector<Tap> &taps = tapTraces[t];
+            if (trace.empty())
+                continue;
+
+            unsigned long start = trace.front().millis;
+            unsigned long end = trace.back().millis;
+            host::setMillis(start);
+            connectPhone(settings);
+            bluetoothLoop();
+            if (connectModel)
+            {
+                // Left with the proximity key on before the trace
+                host::disconnect();
+                bluetoothLoop(); // Waits 500ms before advertising again
+            }
+            host::clearNotifications();
+
+            std::vector<Transition> actual;
+            actuations = &actual;
+            uint32_t readsBefore = host::rssiRequests();
+            bool connected = !connectModel;
+            bool changing = false; // RSSI on the other side of the connect RSSI ...
+            unsigned long changingSince = 0; // ... since then
+            size_t current = 0;
+            size_t phoneSent = 0;
+            size_t tapped = 0;
+            while (phoneSent < phone.size() && phone[phoneSent].millis < start)
+                phoneSent++;
+            while (millis() <= end)
+            {
+                unsigned long now = millis();
+                while (current + 1 < trace.size() && trace[current + 1].millis <= now)
+                    current++;
+                int8_t rssi = static_cast<int8_t>(lroundf(trace[current].rssi));
+
+                if (connectModel)
+                {
+                    bool other = connected ? rssi < connectRssi - DISCONNECT_MARGIN : rssi >= connectRssi;
+                    if (other && !changing)
+                        changingSince = now;
+                    changing = other;
+
+                    if (changing && now - changingSince >= (connected ? SUPERVISION_TIMEOUT : connectDelay))
+                    {
+                        connected = !connected;
+                        changing = false;
+                        if (connected)
+                        {
+                            connectPhone(settings);
+                        }
+                        else
+                        {
+                            host::disconnect();
+                        }
+                    }
+                    else if (!connected && settings.presence && now % ADVERTISING_INTERVAL == 0)
+                    {
+                        std::vector<uint8_t> data(presence::PRESENCE_DATA_LENGTH);
+                        presence::buildPresenceData(counter, data.data());
+                        host::advertise(data, rssi);
+                    }
+                }
+
+                if (!connected)
+                {
+                    // The phone measures nothing without the connection
+                    while (phoneSent < phone.size() && phone[phoneSent].millis <= now)
+                        phoneSent++;
+                }
+                else if (settings.fusion && (now - start) % PHONE_RSSI_INTERVAL == 0)
+                {
+                    phoneSent = sendPhoneRssi(phone, phoneSent);
+                }
+
+                // Taps while disconnected go nowhere
+                for (; tapped < taps.size() && taps[tapped].millis <= now; tapped++)
+                {
+                    if (connected)
+                        send(taps[tapped].unlock ? ClientCommand::UNLOCK_DOORS : ClientCommand::LOCK_DOORS);
+                }
+
+                bluetoothLoop();
+                if (host::rssiRequested())
+                    host::deliverRssi(rssi);
+                outcome.notifications += host::notifications().size();
+                host::clearNotifications();
+                host::advanceMillis(LOOP_INTERVAL);
+            }
+            outcome.rssiReads += host::rssiRequests() - readsBefore;
+
+            // The lock on disconnect is not part of the trace
+            actuations = nullptr;
+            uint32_t cycles = relayCycles;
+            if (connected)
+            {
+                host::disconnect();
+                bluetoothLoop();
+            }
+            relayCycles = cycles;
+
+            compare(reference(trace, referenceTrigger, referenceRelease), actual, outcome.results);
+            outcome.hours += (end - start) / 3600000.0;
+        }
+        outcome.relayCycles = relayCycles;
+        outcome.valid = true;
+        return outcome;
+    }
+
+    // Replays every combination with up to `jobs` processes at once
+    std::vector<Outcome> replayAll(const std::vector<Settings> &grid, const std::vector<std::vector<Reading>> &traces,
+                                   const std::vector<std::vector<Reading>> &phoneTraces, const std::vector<std::vector<Tap>> &tapTraces,
+                                   unsigned jobs)
+    {
+        std::vector<Outcome> outcomes(grid.size());
+        std::map<pid_t, std::pair<size_t, int>> running; // Process: combination, pipe
+        size_t next = 0;
+
+        fflush(stdout);
+        fflush(stderr);
+        while (next < grid.size() || !running.empty())
+        {
+            while (next < grid.size() && running.size() < jobs)
+            {
+                int fds[2];
+                if (pipe(fds) != 0)
+                {
+                    perror("pipe");
+                    break;
+                }
+
+                pid_t pid = fork();
+                if (pid == 0)
+                {
+                    close(fds[0]);
+                    Outcome outcome = replay(grid[next], traces, phoneTraces, tapTraces);
+                    ssize_t written = write(fds[1], &outcome, sizeof(outcome));
+                    _exit(written == sizeof(outcome) ? 0 : 1);
+                }
+                close(fds[1]);
+                if (pid < 0)
+                {
+                    perror("fork");
+                    close(fds[0]);
+                    break;
+                }
+                running[pid] = {next++, fds[0]};
+            }
+            if (running.empty())
+                break;
+
+            int status;
+            pid_t pid = wait(&status);
+            auto job = running.find(pid);
+            if (job == running.end())
+                continue;
+
+            Outcome &outcome = outcomes[job->second.first];
+            if (read(job->second.second, &outcome, sizeof(outcome)) != sizeof(outcome))
+                outcome.valid = false;
+            close(job->second.second);
+            running.erase(job);
+        }
+        return outcomes;
+    }
+
+    // `a,b,c` or `from:to:step`
+    bool parseValues(const char *text, std::vector<float> &values)
+    {
+        values.clear();
+        float from, to, step;
+        if (sscanf(text, "%f:%f:%f", &from, &to, &step) == 3)
+        {
+            if (step == 0 || (to - from) / step < 0)
+                return false;
+            for (float value = from; step > 0 ? value <= to + step / 2 : value >= to + step / 2; value += step)
+                values.push_back(value);
+            return true;
+        }
+
+        const char *position = text;
+        while (*position)
+        {
+            char *end;
+            values.push_back(strtof(position, &end));
+            if (end == position || (*end != ',' && *end != '\0'))
+                return false;
+            position = *end == ',' ? end + 1 : end;
+        }
+        return !values.empty();
+    }
+
+    bool parseFilter(const char *text, FilterConfig &config)
+    {
+        char name[16] = {};
+        float first = 0;
+        float second = 0;
+        if (sscanf(text, "%15[^:]:%f:%f", name, &first, &second) < 2)
+            return false;
+        for (uint8_t type = 0; type < 4; type++)
+        {
+            if (strcmp(name, TYPE_NAMES[type]) == 0)
+            {
+                config = {static_cast<FilterType>(type), first, second};
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string filterName(const FilterConfig &config)
+    {
+        char name[48];
+        if (config.type == FilterType::Kalman)
+            snprintf(name, sizeof(name), "kalman:%g:%g", config.first, config.second);
+        else
+            snprintf(name, sizeof(name), "%s:%g", TYPE_NAMES[static_cast<uint8_t>(config.type)], config.first);
+        return name;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<float> triggers = {-60};
+    std::vector<float> deadZones = {4};
+    std::vector<float> cooldowns = {0.5f};
+    std::vector<float> presences = {0};
+    std::vector<float> fusions = {0};
+    std::vector<FilterConfig> filters;
+    std::vector<unsigned> seeds;
+    std::vector<unsigned> days;
+    std::vector<const char *> paths;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::vector<float> *values = nullptr;
+        if (strcmp(argv[i], "--trigger") == 0)
+            values = &triggers;
+        else if (strcmp(argv[i], "--dead-zone") == 0)
+            values = &deadZones;
+        else if (strcmp(argv[i], "--cooldown") == 0)
+            values = &cooldowns;
+        else if (strcmp(argv[i], "--presence") == 0)
+            values = &presences;
+        else if (strcmp(argv[i], "--fusion") == 0)
+            values = &fusions;
+
+        if (values != nullptr)
+        {
+            if (i + 1 >= argc || !parseValues(argv[++i], *values))
+            {
+                fprintf(stderr, "Invalid values for %s\n", argv[i - 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            FilterConfig config;
+            if (!parseFilter(argv[++i], config))
+            {
+                fprintf(stderr, "Invalid filter: %s\n", argv[i]);
+                return 1;
+            }
+            filters.push_back(config);
+        }
+        else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%f:%f", &referenceTrigger, &referenceRelease) != 2)
+            {
+                fprintf(stderr, "Invalid reference: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%f:%lu", &connectRssi, &connectDelay) != 2)
+            {
+                fprintf(stderr, "Invalid connect range: %s\n", argv[i]);
+                return 1;
+            }
+            connectModel = true;
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else if (strcmp(argv[i], "--synthetic") == 0)
+            seeds.push_back(i + 1 < argc && argv[i + 1][0] != '-' ? atoi(argv[++i]) : 1);
+        else if (strcmp(argv[i], "--day") == 0)
+            days.push_back(i + 1 < argc && argv[i + 1][0] != '-' ? atoi(argv[++i]) : 1);
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (isnan(referenceRelease))
+        referenceRelease = referenceTrigger - 30 * log10f(6);
+    if (filters.empty())
+        filters.push_back({FilterType::MovingAverage, 5, 0});
+    if (jobs < 1)
+        jobs = 1;
+
+    std::vector<std::vector<Reading>> traces;
+    std::vector<std::vector<Reading>> phoneTraces;
+    std::vector<std::vector<Tap>> tapTraces;
+    for (unsigned seed : seeds)
+    {
+        phoneTraces.emplace_back();
+        tapTraces.emplace_back();
+        traces.push_back(syntheticTrace(seed, referenceTrigger, referenceRelease, &phoneTraces.back()));
+    }
+    for (unsigned seed : days)
+    {
+        phoneTraces.emplace_back();
+        tapTraces.emplace_back();
+        traces.push_back(syntheticDay(seed, referenceTrigger, referenceRelease, &phoneTraces.back(), &tapTraces.back()));
+    }
+    for (const char *path : paths)
+    {
+        traces.emplace_back();
+        phoneTraces.emplace_back();
+        tapTraces.emplace_back();
+        if (!readTrace(path, traces.back(), &phoneTraces.back()))
+        {
+            fprintf(stderr, "Can't open %s\n", path);
+            return 1;
+        }
+    }
+    if (traces.empty())
+    {
+        fprintf(stderr, "Usage: replay [--trigger dBm] [--dead-zone m] [--cooldown min] [--filter type:a[:b]]... [--presence 0,1] "
+                        "[--fusion 0,1] [--connect dBm:ms] [--reference dBm:dBm] [--jobs n] [--csv] (trace.csv... | --synthetic [seed]... | --day [seed]...)\n");
+        return 1;
+    }
+
+    std::vector<Settings> grid;
+    for (const FilterConfig &filter : filters)
+    {
+        for (float trigger : triggers)
+        {
+            for (float deadZone : deadZones)
+            {
+                for (float cooldown : cooldowns)
+                {
+                    for (float presence : presences)
+                    {
+                        for (float fusion : fusions)
+                            grid.push_back({trigger, deadZone, cooldown, presence != 0, fusion != 0, filter});
+                    }
+                }
+            }
+        }
+    }
+
+    host::setSerialOutput(nullptr);
+    setupBluetooth();
+    std::vector<Outcome> outcomes = replayAll(grid, traces, phoneTraces, tapTraces, static_cast<unsigned>(jobs));
+
+    if (csv)
+        printf("trigger,dead_zone,cooldown,presence,fusion,filter,unlock_lag_mean,unlock_lag_max,lock_lag_mean,lock_lag_max,missed,false_per_hour,relay_cycles,notifications,reads_per_minute\n");
+    else
+    {
+        printf("reference %.1f/%.1f dBm, %zu trace(s), %zu combination(s)\n", referenceTrigger, referenceRelease, traces.size(), grid.size());
+        printf("%7s %5s %8s %8s %6s %-16s %14s %14s %6s %8s %6s %7s %9s\n", "trigger", "zone", "cooldown", "presence", "fusion", "filter", "unlock lag ms", "lock lag ms", "missed", "false/h", "relays", "notifs", "reads/min");
+        printf("%7s %5s %8s %8s %6s %-16s %14s %14s\n", "", "", "", "", "", "", "(mean/max)", "(mean/max)");
+    }
+
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        const Settings &settings = grid[i];
+        const Outcome &outcome = outcomes[i];
+        std::string filter = filterName(settings.filter);
+        if (!outcome.valid)
+        {
+            fprintf(stderr, "Replay failed for %.1f/%g/%g/%s\n", settings.trigger, settings.deadZone, settings.cooldown, filter.c_str());
+            continue;
+        }
+
+        const Result &unlocks = outcome.results[0];
+        const Result &locks = outcome.results[1];
+        double falsePerHour = outcome.hours > 0 ? (unlocks.falseTriggers + locks.falseTriggers) / outcome.hours : 0;
+        double readsPerMinute = outcome.hours > 0 ? outcome.rssiReads / (outcome.hours * 60) : 0;
+
+        if (csv)
+        {
+            printf("%.1f,%g,%g,%d,%d,%s,%.0f,%ld,%.0f,%ld,%zu,%.2f,%u,%u,%.1f\n", settings.trigger, settings.deadZone, settings.cooldown, settings.presence, settings.fusion, filter.c_str(),
+                   unlocks.meanLag(), unlocks.lagMax, locks.meanLag(), locks.lagMax, unlocks.missed + locks.missed,
+                   falsePerHour, outcome.relayCycles, outcome.notifications, readsPerMinute);
+            continue;
+        }
+
+        char unlockLag[24];
+        char lockLag[24];
+        snprintf(unlockLag, sizeof(unlockLag), "%.0f/%ld", unlocks.meanLag(), unlocks.lagMax);
+        snprintf(lockLag, sizeof(lockLag), "%.0f/%ld", locks.meanLag(), locks.lagMax);
+        printf("%7.1f %5g %8g %8d %6d %-16s %14s %14s %6zu %8.2f %6u %7u %9.1f\n", settings.trigger, settings.deadZone, settings.cooldown, settings.presence, settings.fusion, filter.c_str(),
+               unlockLag, lockLag, unlocks.missed + locks.missed, falsePerHour, outcome.relayCycles, outcome.notifications, readsPerMinute);
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+// Compares the RSSI filters of src/proximity on traces (env:rssi_filters).
+//
+//   rssi_filters [options] trace.csv...
+//   rssi_filters [options] --synthetic [seed]
+//
+// A trace has one reading per line: `millis,rssi[,near]`. `near` (0/1) marks
+// whether the phone really was in unlock range. Without it, a centered (so
+// not causal) median of 9 readings run through the same thresholds is used as
+// reference. Lines that don't start with a number are skipped.
+//
+// For every filter it prints how long after the reference the unlocks and
+// locks followed (lag) and how many of them had no counterpart in the
+// reference (false triggers caused by noise).
+//
+// Options:
+//   --trigger <dBm>             unlock threshold (default -60)
+//   --release <dBm>             lock threshold (default: like RSSI_TRIGGER on the controller)
+//   --dwell <unlock ms>:<lock ms>  dwell times of the zone state machine (default 0:0,
+//                               so only the filter is compared)
+//   --filter <type>:<a>[:<b>]   filter to compare (sma, ema, median, kalman), repeatable
+//   --predict <ms>              also run every filter with PROXIMITY_PREDICT_AHEAD set to this
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "proximity/filter.h"
+#include "proximity/trend.h"
+#include "proximity/zones.h"
+#include "../common/traces.h"
+
+using namespace proximity;
+using namespace traces;
+
+namespace
+{
+    const char *const TYPE_NAMES[] = {"sma", "ema", "median", "kalman"};
+
+    float triggerRssi = -60;
+    float releaseRssi = NAN;
+    uint32_t unlockDwell = 0;
+    uint32_t lockDwell = 0;
+
+    // Runs the values through the trend estimator and zone state machine like
+    // gapCallback
+    std::vector<Transition> decide(const std::vector<Reading> &trace, const std::vector<float> &values,
+                                   uint32_t unlockDwell, uint32_t lockDwell, uint32_t predictAhead)
+    {
+        ZoneTracker zones;
+        zones.configure({triggerRssi, releaseRssi, unlockDwell, lockDwell, 0});
+        zones.reset(false);
+        TrendEstimator trend;
+
+        std::vector<Transition> transitions;
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            trend.add(values[i], trace[i].millis);
+            float rssi = anticipatedRssi(trend, values[i], zones.zone(), predictAhead);
+            Action action = zones.update(rssi, trace[i].millis);
+            if (action != Action::None)
+                transitions.push_back({trace[i].millis, action == Action::Unlock});
+        }
+        return transitions;
+    }
+
+    bool parseFilter(const char *text, FilterConfig &config)
+    {
+        char name[16] = {};
+        float first = 0;
+        float second = 0;
+        if (sscanf(text, "%15[^:]:%f:%f", name, &first, &second) < 2)
+            return false;
+        for (uint8_t type = 0; type < 4; type++)
+        {
+            if (strcmp(name, TYPE_NAMES[type]) == 0)
+            {
+                config = {static_cast<FilterType>(type), first, second};
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string filterName(const FilterConfig &config)
+    {
+        char name[48];
+        if (config.type == FilterType::Kalman)
+            snprintf(name, sizeof(name), "kalman:%g:%g", config.first, config.second);
+        else
+            snprintf(name, sizeof(name), "%s:%g", TYPE_NAMES[static_cast<uint8_t>(config.type)], config.first);
+        return name;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<FilterConfig> filters;
+    std::vector<std::vector<Reading>> traces;
+    bool synthetic = false;
+    unsigned seed = 1;
+    std::vector<const char *> paths;
+
+    uint32_t predictAhead = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--trigger") == 0 && i + 1 < argc)
+            triggerRssi = atof(argv[++i]);
+        else if (strcmp(argv[i], "--release") == 0 && i + 1 < argc)
+            releaseRssi = atof(argv[++i]);
+        else if (strcmp(argv[i], "--predict") == 0 && i + 1 < argc)
+            predictAhead = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dwell") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%u:%u", &unlockDwell, &lockDwell) != 2)
+            {
+                fprintf(stderr, "Invalid dwell times: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            FilterConfig config;
+            if (!parseFilter(argv[++i], config))
+            {
+                fprintf(stderr, "Invalid filter: %s\n", argv[i]);
+                return 1;
+            }
+            filters.push_back(config);
+        }
+        else if (strcmp(argv[i], "--synthetic") == 0)
+        {
+            synthetic = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                seed = atoi(argv[++i]);
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+
+    // Release zone of RSSI_TRIGGER (path loss exponent 3, 5m)
+    if (isnan(releaseRssi))
+        releaseRssi = triggerRssi - 30 * log10f(6);
+
+    if (filters.empty())
+    {
+        filters = {
+            {FilterType::MovingAverage, 5, 0},
+            {FilterType::MovingAverage, 10, 0},
+            {FilterType::Exponential, 0.2f, 0},
+            {FilterType::Exponential, 0.4f, 0},
+            {FilterType::Median, 5, 0},
+            {FilterType::Median, 9, 0},
+            {FilterType::Kalman, 0.5f, 16},
+            {FilterType::Kalman, 2, 16},
+        };
+    }
+
+    if (synthetic)
+        traces.push_back(syntheticTrace(seed, triggerRssi, releaseRssi));
+    for (const char *path : paths)
+    {
+        traces.emplace_back();
+        if (!readTrace(path, traces.back()))
+        {
+            fprintf(stderr, "Can't open %s\n", path);
+            return 1;
+        }
+    }
+    if (traces.empty())
+    {
+        fprintf(stderr, "Usage: rssi_filters [--trigger dBm] [--release dBm] [--dwell ms:ms] [--predict ms] [--filter type:a[:b]]... (trace.csv... | --synthetic [seed])\n");
+        return 1;
+    }
+
+    printf("trigger %.1f dBm, release %.1f dBm, dwell %u/%u ms, %zu trace(s)\n", triggerRssi, releaseRssi, unlockDwell, lockDwell, traces.size());
+    printf("%-24s %14s %14s %7s %13s %11s\n", "filter", "unlock lag ms", "lock lag ms", "missed", "false unlocks", "false locks");
+    printf("%-24s %14s %14s\n", "", "(mean/max)", "(mean/max)");
+
+    for (const FilterConfig &config : filters)
+    {
+        if (!configureFilter(config))
+        {
+            fprintf(stderr, "Invalid parameters for %s\n", filterName(config).c_str());
+            continue;
+        }
+
+        for (uint32_t ahead : {0u, predictAhead})
+        {
+            Result results[2];
+            for (const std::vector<Reading> &trace : traces)
+            {
+                RssiFilter &filter = activeFilter();
+                filter.reset();
+                std::vector<float> values;
+                for (const Reading &reading : trace)
+                    values.push_back(filter.update(reading.rssi));
+                compare(reference(trace, triggerRssi, releaseRssi), decide(trace, values, unlockDwell, lockDwell, ahead), results);
+            }
+
+            std::string name = filterName(config);
+            if (ahead != 0)
+                name += " +" + std::to_string(ahead) + "ms";
+
+            char unlockLag[24];
+            char lockLag[24];
+            snprintf(unlockLag, sizeof(unlockLag), "%.0f/%ld", results[0].meanLag(), results[0].lagMax);
+            snprintf(lockLag, sizeof(lockLag), "%.0f/%ld", results[1].meanLag(), results[1].lagMax);
+            printf("%-24s %14s %14s %7zu %13zu %11zu\n",
+                   name.c_str(),
+                   unlockLag,
+                   lockLag,
+                   results[0].missed + results[1].missed,
+                   results[0].falseTriggers,
+                   results[1].falseTriggers);
+
+            if (predictAhead == 0)
+                break;
+        }
+    }
+    return 0;
+}
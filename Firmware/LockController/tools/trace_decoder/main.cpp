@@ -0,0 +1,195 @@
+// Turns an RSSI trace of the controller into CSV (env:trace_decoder).
+//
+//   trace_decoder [dump.txt]                serial capture containing the `tr` output
+//   trace_decoder --responses [dump.txt]    one TRACE response as hex per line
+//                                           (the last word of the line, e.g. from the app)
+//
+// Without a file it reads stdin. Lines that are not part of a trace are
+// ignored. The CSV has `millis,rssi,event` columns: readings fill `rssi`,
+// everything else only `event`, so tools/rssi_filters can read it as it is.
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "telemetry/trace.h"
+#include "bluetooth/commands.h"
+
+using telemetry::TraceEvent;
+using telemetry::TraceRecord;
+
+namespace
+{
+    struct State
+    {
+        uint32_t millis = 0;
+        int rssi = 0;
+        size_t expected = 0; // Entries announced by the header
+        size_t decoded = 0;
+    };
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    size_t parseHex(const char *hex, uint8_t *out, size_t maxLength)
+    {
+        size_t length = 0;
+        while (length < maxLength)
+        {
+            int high = hexValue(hex[2 * length]);
+            int low = high < 0 ? -1 : hexValue(hex[2 * length + 1]);
+            if (low < 0)
+                break;
+            out[length++] = static_cast<uint8_t>(high << 4 | low);
+        }
+        return length;
+    }
+
+    uint32_t getUint32(const uint8_t *in)
+    {
+        return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+    }
+
+    const char *eventName(TraceEvent event)
+    {
+        switch (event)
+        {
+        case TraceEvent::Connected:    return "connected";
+        case TraceEvent::Disconnected: return "disconnected";
+        case TraceEvent::Zone:         return "zone";
+        case TraceEvent::Unlock:       return "unlock";
+        case TraceEvent::Lock:         return "lock";
+        default:                       return nullptr;
+        }
+    }
+
+    void decodeRecord(const uint8_t *record, size_t length, State &state)
+    {
+        if (length == 0)
+            return;
+
+        if (record[0] == static_cast<uint8_t>(TraceRecord::Header))
+        {
+            if (length < 12)
+            {
+                fprintf(stderr, "Skipping short trace header\n");
+                return;
+            }
+            if (state.decoded != state.expected)
+                fprintf(stderr, "Warning: previous trace ended after %zu of %zu entries\n", state.decoded, state.expected);
+            state.millis = getUint32(record + 1);
+            state.rssi = static_cast<int8_t>(record[5]);
+            state.expected = record[6] | record[7] << 8;
+            state.decoded = 0;
+            return;
+        }
+        if (record[0] != static_cast<uint8_t>(TraceRecord::Entries))
+            return;
+
+        for (size_t i = 1; i + 4 <= length; i += 4)
+        {
+            state.millis += record[i] | record[i + 1] << 8;
+            TraceEvent event = static_cast<TraceEvent>(record[i + 2]);
+            int value = static_cast<int8_t>(record[i + 3]);
+            state.decoded++;
+
+            if (event == TraceEvent::Rssi)
+            {
+                state.rssi += value;
+                printf("%u,%d,\n", state.millis, state.rssi);
+            }
+            else if (event == TraceEvent::Zone)
+            {
+                printf("%u,,zone:%d\n", state.millis, value);
+            }
+            else if (event == TraceEvent::Presence)
+            {
+                printf("%u,,presence:%d\n", state.millis, value);
+            }
+            else if (event == TraceEvent::PhoneRssi)
+            {
+                printf("%u,,phone:%d\n", state.millis, value);
+            }
+            else if (eventName(event) != nullptr)
+            {
+                printf("%u,,%s\n", state.millis, eventName(event));
+            }
+        }
+    }
+
+    int decode(FILE *input, bool responses)
+    {
+        State state;
+        char line[512];
+        uint8_t record[256];
+
+        printf("millis,rssi,event\n");
+        while (fgets(line, sizeof(line), input))
+        {
+            size_t length;
+            if (responses)
+            {
+                // Last word: TRACE response code, length, record
+                size_t end = strlen(line);
+                while (end > 0 && isspace(static_cast<unsigned char>(line[end - 1])))
+                    line[--end] = '\0';
+                const char *word = strrchr(line, ' ');
+                word = word == nullptr ? line : word + 1;
+
+                length = parseHex(word, record, sizeof(record));
+                if (length < 2 || record[0] != static_cast<uint8_t>(Esp32Response::TRACE) || record[1] != length - 2)
+                    continue;
+                decodeRecord(record + 2, length - 2, state);
+                continue;
+            }
+
+            const char *dump = strstr(line, "#TRACE ");
+            if (dump == nullptr)
+                continue;
+            length = parseHex(dump + 7, record, sizeof(record));
+            decodeRecord(record, length, state);
+        }
+
+        if (state.decoded != state.expected)
+            fprintf(stderr, "Warning: trace ended after %zu of %zu entries\n", state.decoded, state.expected);
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool responses = false;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--responses") == 0)
+            responses = true;
+        else
+            path = argv[i];
+    }
+
+    FILE *input = stdin;
+    if (path != nullptr)
+    {
+        input = fopen(path, "r");
+        if (input == nullptr)
+        {
+            fprintf(stderr, "Can't open %s\n", path);
+            return 1;
+        }
+    }
+
+    int result = decode(input, responses);
+
+    if (input != stdin)
+        fclose(input);
+    return result;
+}
@@ -1,4 +1,5 @@
 import 'dart:async';
+import 'dart:typed_data';
 
 import 'package:flutter/material.dart';
 import 'package:flutter_foreground_task/flutter_foreground_task.dart';
@@ -28,18 +29,23 @@ class _RangeCalibrationPageState extends ConsumerState<RangeCalibrationPage> {
 
   double triggerStrength = -200;
 
-  void readSignalStrength() async {
-    if (selectedVehicle == null) return;
-    BleBackgroundService.sendCommand(
-        selectedVehicle!.device, ClientCommand.GET_RSSI);
+  /// Subscribes to the RSSI every 500ms for 2 minutes, or ends the subscription
+  void subscribeSignalStrength(Vehicle? vehicle, {bool end = false}) async {
+    if (vehicle == null) return;
+    final data = ByteData(4)
+      ..setUint16(0, end ? 0 : 500, Endian.little)
+      ..setUint16(2, 120, Endian.little);
+    BleBackgroundService.sendCommand(vehicle.device, ClientCommand.RSSI_STREAM,
+        additionalData: data.buffer.asUint8List());
   }
 
   @override
   void initState() {
     super.initState();
 
-    timer = Timer.periodic(const Duration(seconds: 1), (timer) {
-      readSignalStrength();
+    // Renews the subscription before it runs out
+    timer = Timer.periodic(const Duration(seconds: 60), (timer) {
+      subscribeSignalStrength(selectedVehicle);
     });
 
     _taskDataCallback = (event) {
@@ -55,9 +61,13 @@ class _RangeCalibrationPageState extends ConsumerState<RangeCalibrationPage> {
       Esp32ResponseDate data = Esp32ResponseDate(
           macAddress: event['macAddress'], command: command, parser: parser);
 
-      if (data.command == Esp32Response.RSSI) {
+      final samples = data.parser.rawData;
+      if (data.command == Esp32Response.RSSI_SAMPLES &&
+          samples != null &&
+          samples.length > 6) {
         setState(() {
-          triggerStrength = data.parser.getFloat() ?? -200;
+          // Newest sample
+          triggerStrength = samples.last.toSigned(8).toDouble();
         });
       }
     };
@@ -67,6 +77,7 @@ class _RangeCalibrationPageState extends ConsumerState<RangeCalibrationPage> {
   @override
   void dispose() {
     timer.cancel();
+    subscribeSignalStrength(selectedVehicle, end: true);
     FlutterForegroundTask.removeTaskDataCallback(_taskDataCallback);
     super.dispose();
   }
@@ -91,6 +102,10 @@ class _RangeCalibrationPageState extends ConsumerState<RangeCalibrationPage> {
               value: selectedVehicle,
               hint: const Text('Select a device'),
               onChanged: (Vehicle? newValue) {
+                if (newValue != selectedVehicle) {
+                  subscribeSignalStrength(selectedVehicle, end: true);
+                  subscribeSignalStrength(newValue);
+                }
                 setState(() {
                   selectedVehicle = newValue;
                 });
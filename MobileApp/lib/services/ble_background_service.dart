@@ -64,6 +64,13 @@ class BleBackgroundService {
   static final ValueNotifier<Esp32ResponseDate?> _onMessageReceived =
       ValueNotifier<Esp32ResponseDate?>(null);
   static final Map<String, StreamSubscription> _subscriptions = {};
+  // Notifications of the state and stream characteristics (state deltas,
+  // reports, RSSI streams) of firmware with the split GATT layout
+  static final Map<String, List<StreamSubscription>> _splitSubscriptions = {};
+  // Last state each vehicle reported (STATE, STATE_DELTA), kept across
+  // reconnects so only what changed since is asked for (STATE_SINCE)
+  static final Map<String, ({int bits, int has, int version})> _vehicleStates =
+      {};
 
   // Top-level listeners registered in [onStart]. Tracked so repeated onStart
   // invocations (service restarts) tear down the previous registration instead
@@ -432,15 +439,39 @@ class BleBackgroundService {
     // Cache the write characteristic so sendCommand skips MTU + service discovery.
     vehicle.characteristic = characteristic;
 
+    // Newer firmware splits the state (readable once a command was
+    // authenticated, so no GET_DATA is needed) and reports/RSSI streams off
+    // the command characteristic. Older firmware only has the one above.
+    final stateCharacteristic = service.characteristics.firstWhereOrNull(
+      (characteristic) =>
+          characteristic.uuid == Guid('0000ffe2-0000-1000-8000-00805f9b34fb'),
+    );
+    final streamCharacteristic = service.characteristics.firstWhereOrNull(
+      (characteristic) =>
+          characteristic.uuid == Guid('0000ffe3-0000-1000-8000-00805f9b34fb'),
+    );
+
     // Set true as soon as *any* notification is delivered on this connection.
     // Proves the GATT notification pipe actually works; used below to detect the
     // first-connect case where setNotifyValue silently fails to deliver.
     bool gotResponse = false;
 
-    await characteristic.setNotifyValue(true);
-    final notificationSubscription = characteristic.onValueReceived.listen((
-      value,
+    void emit(
+      List<({Esp32Response command, Esp32ResponseParser parser})> responses,
     ) {
+      for (final response in responses) {
+        _onMessageReceived.value = Esp32ResponseDate(
+          macAddress: event
+              .device
+              .remoteId
+              .str, // Assuming 'event' is available in this scope
+          command: response.command,
+          parser: response.parser,
+        );
+      }
+    }
+
+    void onValue(List<int> value) {
       // A packet arrived → notifications are flowing. Clear the one-shot
       // auto-reconnect guard so a later genuine first-connect can self-heal too.
       gotResponse = true;
@@ -452,6 +483,7 @@ class BleBackgroundService {
       }
 
       final parser = Esp32ResponseParser(value);
+      BleService.handleResponse(event.device.remoteId.str, parser);
       final Esp32Response? command = Esp32Response.fromValue(parser.command);
 
       if (command == null) {
@@ -459,20 +491,80 @@ class BleBackgroundService {
         return;
       }
 
-      _onMessageReceived.value = Esp32ResponseDate(
-        macAddress: event
-            .device
-            .remoteId
-            .str, // Assuming 'event' is available in this scope
-        command: command,
-        parser: parser,
-      );
-    });
+      // State bits are handled like the answers of GET_DATA
+      if (command == Esp32Response.STATE ||
+          command == Esp32Response.STATE_DELTA) {
+        final state = _takeState(mac, command, parser);
+        if (state != null) emit(_stateResponses(state.bits, state.changed));
+        return;
+      }
 
-    _subscriptions[event.device.remoteId.str] = notificationSubscription;
+      emit([(command: command, parser: parser)]);
+    }
 
-    await BleService.sendCommand(vehicle.device, ClientCommand.GET_VERSION);
-    await Future.delayed(Duration(milliseconds: 200));
+    await characteristic.setNotifyValue(true);
+    _subscriptions[mac] = characteristic.onValueReceived.listen(onValue);
+
+    // Reads and state deltas of the state characteristic also arrive here
+    for (final splitCharacteristic in [
+      stateCharacteristic,
+      streamCharacteristic,
+    ].nonNulls) {
+      await splitCharacteristic.setNotifyValue(true);
+      _splitSubscriptions
+          .putIfAbsent(mac, () => [])
+          .add(splitCharacteristic.onValueReceived.listen(onValue));
+    }
+
+    // Asks only for what changed since the last connection if the vehicle
+    // reported a state version before, reads the state otherwise, or asks for
+    // it if it isn't readable (older firmware, or no command was
+    // authenticated yet)
+    Future<void> requestState() async {
+      final known = _vehicleStates[mac];
+      if (stateCharacteristic != null && known != null) {
+        final version = ByteData(4)
+          ..setUint32(0, known.version, Endian.little);
+        final delta = await BleService.request(
+          vehicle.device,
+          ClientCommand.STATE_SINCE,
+          additionalData: version.buffer.asUint8List(),
+        );
+        final state = _vehicleStates[mac];
+        if (delta?.command == Esp32Response.STATE_DELTA.value &&
+            state != null) {
+          // The delta only has what changed, but the vehicle object starts
+          // from the defaults again on reconnect
+          emit(_stateResponses(state.bits, state.has));
+          return;
+        }
+      }
+      if (stateCharacteristic != null) {
+        try {
+          final value = await stateCharacteristic.read();
+          if (value.isNotEmpty) return;
+        } catch (e) {
+          debugPrint('Reading the state of $mac failed: $e');
+        }
+      }
+      await BleService.request(vehicle.device, ClientCommand.GET_DATA);
+    }
+
+    // Firmware that knows request IDs answers GET_LIMITS, then the commands
+    // below go out together (as many as it has credits for) and each is done
+    // once its answer is in. Older firmware doesn't, so they are spaced out.
+    final limits = await BleService.request(
+      vehicle.device,
+      ClientCommand.GET_LIMITS,
+    );
+    final bool pipelined = limits != null;
+
+    if (pipelined) {
+      await BleService.request(vehicle.device, ClientCommand.GET_VERSION);
+    } else {
+      await BleService.sendCommand(vehicle.device, ClientCommand.GET_VERSION);
+      await Future.delayed(Duration(milliseconds: 200));
+    }
 
     if (_proximityKeyEnabled && !ignoreProximityKey) {
       _updateNotification(
@@ -486,33 +578,40 @@ class BleBackgroundService {
       );
     }
 
-    await BleService.sendCommand(vehicle.device, ClientCommand.GET_FEATURES);
-    await Future.delayed(Duration(milliseconds: 200));
-
-    await BleService.sendCommand(vehicle.device, ClientCommand.GET_DATA);
-
-    if (_proximityKeyEnabled && !ignoreProximityKey) {
+    final bool sendSettings = _proximityKeyEnabled && !ignoreProximityKey;
+    if (pipelined) {
+      await Future.wait([
+        BleService.request(vehicle.device, ClientCommand.GET_FEATURES),
+        requestState(),
+        if (sendSettings)
+          BleService.request(
+            vehicle.device,
+            ClientCommand.SETTINGS,
+            additionalData: BleService.settingsData(
+              triggerRssi: _proximityStrength,
+              deadZone: _deadZone,
+              cooldown: _proximityCooldown,
+              proximityKey: true,
+            ),
+          ),
+      ]);
+    } else {
+      await BleService.sendCommand(vehicle.device, ClientCommand.GET_FEATURES);
       await Future.delayed(Duration(milliseconds: 200));
 
-      await BleService.sendCommandWithFloats(
-        vehicle.device,
-        ClientCommand.RSSI_TRIGGER,
-        [_proximityStrength, _deadZone],
-      );
-
-      await Future.delayed(Duration(milliseconds: 200));
+      await BleService.sendCommand(vehicle.device, ClientCommand.GET_DATA);
 
-      await BleService.sendCommandWithFloat(
-        vehicle.device,
-        ClientCommand.PROXIMITY_COOLDOWN,
-        _proximityCooldown,
-      );
-      await Future.delayed(Duration(milliseconds: 200));
+      if (sendSettings) {
+        await Future.delayed(Duration(milliseconds: 200));
 
-      await BleService.sendCommand(
-        vehicle.device,
-        ClientCommand.PROXIMITY_KEY_ON,
-      );
+        await BleService.sendSettings(
+          vehicle.device,
+          triggerRssi: _proximityStrength,
+          deadZone: _deadZone,
+          cooldown: _proximityCooldown,
+          proximityKey: true,
+        );
+      }
     }
 
     // Nudge Android toward a low-power connection interval. The firmware also
@@ -552,6 +651,58 @@ class BleBackgroundService {
     unawaited(_ensureNotificationsWorking(event, vehicle, () => gotResponse));
   }
 
+  /// Takes a [Esp32Response.STATE] (`uint8` state bits, `uint8` bits the
+  /// vehicle has, `uint32` version) or [Esp32Response.STATE_DELTA] (`uint8`
+  /// changed bits, `uint8` state bits, `uint32` version) of [mac] into
+  /// [_vehicleStates]. Returns the state bits and the bits to report (all the
+  /// vehicle has for a STATE), null if it is too short.
+  static ({int bits, int changed})? _takeState(
+    String mac,
+    Esp32Response command,
+    Esp32ResponseParser parser,
+  ) {
+    final data = parser.rawData;
+    if (data == null || data.length < 6) return null;
+
+    final version = ByteData.sublistView(
+      Uint8List.fromList(data),
+      2,
+      6,
+    ).getUint32(0, Endian.little);
+    if (command == Esp32Response.STATE) {
+      _vehicleStates[mac] = (bits: data[0], has: data[1], version: version);
+      return (bits: data[0], changed: data[1]);
+    }
+
+    final known = _vehicleStates[mac];
+    if (known != null) {
+      _vehicleStates[mac] = (bits: data[1], has: known.has, version: version);
+    }
+    return (bits: data[1], changed: data[0]);
+  }
+
+  /// The LOCKED/UNLOCKED, ENGINE_* and WINDOWS_* answers GET_DATA would give
+  /// for the state [bits], only for the bits in [mask]
+  static List<({Esp32Response command, Esp32ResponseParser parser})>
+  _stateResponses(int bits, int mask) {
+    final commands = [
+      if (mask & 0x01 != 0)
+        bits & 0x01 != 0 ? Esp32Response.LOCKED : Esp32Response.UNLOCKED,
+      if (mask & 0x02 != 0)
+        bits & 0x02 != 0
+            ? Esp32Response.ENGINE_STARTED
+            : Esp32Response.ENGINE_STOPPED,
+      if (mask & 0x04 != 0)
+        bits & 0x04 != 0
+            ? Esp32Response.WINDOWS_OPENED
+            : Esp32Response.WINDOWS_CLOSED,
+    ];
+    return [
+      for (final command in commands)
+        (command: command, parser: Esp32ResponseParser([command.value])),
+    ];
+  }
+
   /// Verifies that BLE notifications are actually being delivered for a
   /// freshly-connected [vehicle]; retries and, as a last resort, forces a single
   /// disconnect+reconnect. [gotResponse] reports whether any packet has arrived.
@@ -629,9 +780,13 @@ class BleBackgroundService {
       subscription.cancel();
       _subscriptions.remove(mac);
     }
+    for (final splitSubscription in _splitSubscriptions.remove(mac) ?? []) {
+      splitSubscription.cancel();
+    }
 
     // Invalidate the cached characteristic; it belongs to the dead connection.
     vehicle.characteristic = null;
+    BleService.resetRequests(mac);
 
     // Only treat this as a real disconnect if the device had actually
     // connected. autoConnect can emit a `disconnected` event for a device that
@@ -910,25 +1065,19 @@ class BleBackgroundService {
         bool enabled = data['enabled'];
         _proximityKeyEnabled = enabled;
 
-        ClientCommand command = enabled
-            ? ClientCommand.PROXIMITY_KEY_ON
-            : ClientCommand.PROXIMITY_KEY_OFF;
         for (final vehicle in vehicles) {
           if (!vehicle.device.isConnected) continue;
-          await BleService.sendCommand(vehicle.device, command);
           if (enabled) {
-            await Future.delayed(Duration(milliseconds: 200));
-            await BleService.sendCommandWithFloats(
-              vehicle.device,
-              ClientCommand.RSSI_TRIGGER,
-              [_proximityStrength, _deadZone],
-            );
-            await Future.delayed(Duration(milliseconds: 200));
-            await BleService.sendCommandWithFloat(
+            await BleService.sendSettings(
               vehicle.device,
-              ClientCommand.PROXIMITY_COOLDOWN,
-              _proximityCooldown,
+              triggerRssi: _proximityStrength,
+              deadZone: _deadZone,
+              cooldown: _proximityCooldown,
+              proximityKey: true,
             );
+          } else {
+            await BleService.sendCommand(
+                vehicle.device, ClientCommand.PROXIMITY_KEY_OFF);
           }
         }
         break;
@@ -953,12 +1102,10 @@ class BleBackgroundService {
       case 'send_data':
         for (final vehicle in vehicles) {
           if (!vehicle.device.isConnected) continue;
-          await BleService.sendCommand(vehicle.device, ClientCommand.GET_DATA);
-          await Future.delayed(Duration(milliseconds: 200));
-          await BleService.sendCommand(
-            vehicle.device,
-            ClientCommand.GET_VERSION,
-          );
+          await BleService.sendBatch(vehicle.device, [
+            (command: ClientCommand.GET_DATA, data: null),
+            (command: ClientCommand.GET_VERSION, data: null),
+          ]);
         }
         break;
 
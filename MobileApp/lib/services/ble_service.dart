@@ -13,6 +13,7 @@ import 'package:shared_preferences/shared_preferences.dart';
 import '../types/ble_commands.dart';
 import 'ble_background_service.dart';
 import '../utils/esp32_response_parser.dart';
+import '../utils/tlv.dart';
 
 class BleService {
   static SharedPreferences? _prefs;
@@ -31,6 +32,18 @@ class BleService {
   /// the firmware out of order, and the lower counter is rejected.
   static final Map<String, Future<void>> _sendQueues = {};
 
+  /// Commands sent with [request] that wait for their answer, per device by
+  /// request ID. The firmware echoes the ID as the last byte of the answer.
+  static final Map<String, Map<int, Completer<Esp32ResponseParser>>> _pending =
+      {};
+  static final Map<String, int> _requestIds = {};
+
+  /// How many [request]s may wait for their answer at once per device, 1 until
+  /// [Esp32Response.LIMITS] says otherwise (see [handleResponse])
+  static final Map<String, int> _credits = {};
+  static final Map<String, int> _inFlight = {};
+  static final Map<String, List<Completer<void>>> _creditWaiters = {};
+
   static Future<void> requestBluetoothPermissions() async {
     if (await Permission.bluetoothScan.request().isGranted &&
         await Permission.bluetoothConnect.request().isGranted &&
@@ -133,17 +146,46 @@ class BleService {
     return _prefs!;
   }
 
-  /// Generate HMAC-SHA256 for a counter and 1-byte command
+  /// Commands whose HMAC also covers the additional data, as the data decides
+  /// what runs, for how long or when the proximity key unlocks
+  /// (signsPayload() in the firmware)
+  static const _signedCommands = {
+    ClientCommand.SETTINGS,
+    ClientCommand.BATCH,
+    ClientCommand.UNLOCK_FOR,
+    ClientCommand.START_ENGINE_FOR,
+    ClientCommand.SCHEDULE,
+  };
+
+  /// Generate HMAC-SHA256 for a counter and 1-byte command, followed by the
+  /// additional data for the commands in [_signedCommands]
   static Uint8List generateHmac(
-      int counter, ClientCommand command, Uint8List sharedSecret) {
+      int counter, ClientCommand command, Uint8List sharedSecret,
+      {List<int>? additionalData}) {
     final counterBytes = Uint8List(4)
       ..buffer.asByteData().setUint32(0, counter, Endian.little);
     final commandBytes = Uint8List(1)..[0] = command.value;
-    final data = Uint8List.fromList([...counterBytes, ...commandBytes]);
+    final data = Uint8List.fromList([
+      ...counterBytes,
+      ...commandBytes,
+      if (_signedCommands.contains(command)) ...?additionalData
+    ]);
     final hmac = Hmac(sha256, sharedSecret);
     return Uint8List.fromList(hmac.convert(data).bytes);
   }
 
+  /// Manufacturer data announcing the phone to a controller scanning for it
+  /// (PRESENCE_SCAN): company ID 0xFFFF, 0x50, and the first 12 bytes of the
+  /// HMAC-SHA256 of "OCKP" and the counter of the next command
+  static Uint8List generatePresenceData(int counter, Uint8List sharedSecret) {
+    final counterBytes = Uint8List(4)
+      ..buffer.asByteData().setUint32(0, counter, Endian.little);
+    final data = Uint8List.fromList([...ascii.encode('OCKP'), ...counterBytes]);
+    final hmac = Hmac(sha256, sharedSecret);
+    final token = hmac.convert(data).bytes.sublist(0, 12);
+    return Uint8List.fromList([0xFF, 0xFF, 0x50, ...token]);
+  }
+
   static Uint8List generateSharedSecret(String password) {
     String cleanedPassword = password.replaceAll('\u0000', '');
     final inputBytes = utf8.encode(cleanedPassword);
@@ -159,23 +201,26 @@ class BleService {
   /// Send a command to a device.
   /// - [device] The device to send the command to.
   /// - [command] The command to send.
-  /// - [additionalData] Additional data to send with the command (MAX 12 Bytes!).
+  /// - [additionalData] Additional data to send with the command (at most 27
+  ///   bytes, 26 with a [requestId]).
+  /// - [requestId] Echoed by the firmware in the answer, use [request] instead
+  ///   of setting it directly.
   static Future<BluetoothCharacteristic?> sendCommand(
       BluetoothDevice device, ClientCommand command,
-      {Uint8List? additionalData}) {
+      {Uint8List? additionalData, int? requestId}) {
     // Queue behind whatever is already being sent to this device so the
     // rolling codes reach the firmware in the order they were allocated.
     final macAddress = device.remoteId.str;
     final previous = _sendQueues[macAddress] ?? Future.value();
-    final result = previous.then(
-        (_) => _sendCommand(device, command, additionalData: additionalData));
+    final result = previous.then((_) => _sendCommand(device, command,
+        additionalData: additionalData, requestId: requestId));
     _sendQueues[macAddress] = result.then((_) {}, onError: (_) {});
     return result;
   }
 
   static Future<BluetoothCharacteristic?> _sendCommand(
       BluetoothDevice device, ClientCommand command,
-      {Uint8List? additionalData}) async {
+      {Uint8List? additionalData, int? requestId}) async {
     try {
       if (!device.isConnected) {
         print('Device is not connected');
@@ -208,24 +253,29 @@ class BleService {
         return null;
       }
 
+      // What fits into one write with the 64 byte MTU (ATT header, HMAC,
+      // command and length byte, request ID)
+      final maxLength = requestId != null ? 26 : 27;
+      if (additionalData != null && additionalData.length > maxLength) {
+        print('Additional data is too long, truncating to $maxLength bytes.');
+        additionalData = additionalData.sublist(0, maxLength);
+      }
+
       final counter = await _nextCounter(prefs, device.remoteId.str);
-      final hmac = generateHmac(counter, command, sharedSecret);
+      final hmac = generateHmac(counter, command, sharedSecret,
+          additionalData: additionalData);
       payloadBytes.addAll(hmac);
 
       payloadBytes.add(command.value);
 
-      if (additionalData != null) {
-        int dataLength = additionalData.length;
-
-        if (dataLength > 12) {
-          print('Additional data is too long, truncating to 12 bytes.');
-          dataLength = 12;
-        }
-
-        payloadBytes.add(dataLength);
-        payloadBytes.addAll(additionalData.sublist(0, dataLength));
+      if (additionalData != null || requestId != null) {
+        payloadBytes.add(additionalData?.length ?? 0);
+        payloadBytes.addAll(additionalData ?? const []);
       }
 
+      // Not covered by the HMAC, it only matches the answer to this command
+      if (requestId != null) payloadBytes.add(requestId);
+
       print(
           "Sending command: 0x${command.value.toRadixString(16)} counter at $counter with payload: $payloadBytes");
       print(
@@ -250,6 +300,94 @@ class BleService {
     }
   }
 
+  /// Send a command with a request ID and wait for its answer: the first
+  /// response that carries the ID, [Esp32Response.COMMAND_DONE] for commands
+  /// that aren't answered otherwise. Null if it couldn't be sent or nothing
+  /// came back within [timeout] (e.g. firmware without request IDs). Every
+  /// response still reaches the general listener as well.
+  ///
+  /// At most the device's credits ([Esp32Response.LIMITS]) wait at once, the
+  /// rest waits here for a free one.
+  static Future<Esp32ResponseParser?> request(
+      BluetoothDevice device, ClientCommand command,
+      {Uint8List? additionalData,
+      Duration timeout = const Duration(seconds: 1)}) async {
+    final macAddress = device.remoteId.str;
+    await _takeCredit(macAddress);
+
+    final pending = _pending.putIfAbsent(macAddress, () => {});
+    final requestId = _nextRequestId(macAddress);
+    final completer = Completer<Esp32ResponseParser>();
+    pending[requestId] = completer;
+    try {
+      final characteristic = await sendCommand(device, command,
+          additionalData: additionalData, requestId: requestId);
+      if (characteristic == null) return null;
+      return await completer.future.timeout(timeout);
+    } on TimeoutException {
+      print('No answer to ${command.name} (request $requestId)');
+      return null;
+    } finally {
+      if (identical(pending[requestId], completer)) pending.remove(requestId);
+      _returnCredit(macAddress);
+    }
+  }
+
+  /// Completes the [request] a response from [macAddress] answers and takes
+  /// over the credits of [Esp32Response.LIMITS]. Called for every response.
+  static void handleResponse(String macAddress, Esp32ResponseParser parser) {
+    if (parser.command == Esp32Response.LIMITS.value) {
+      final data = parser.rawData;
+      if (data != null && data.isNotEmpty && data[0] > 0) {
+        _credits[macAddress] = data[0];
+        _wakeCreditWaiters(macAddress);
+      }
+    }
+
+    final requestId = parser.requestId;
+    if (requestId == null) return;
+    final completer = _pending[macAddress]?.remove(requestId);
+    if (completer != null && !completer.isCompleted) completer.complete(parser);
+  }
+
+  /// Forgets the credits of [macAddress], a reconnect may reach other firmware
+  static void resetRequests(String macAddress) {
+    _credits.remove(macAddress);
+    _wakeCreditWaiters(macAddress);
+  }
+
+  /// Next request ID (0-255) that isn't waiting for an answer
+  static int _nextRequestId(String macAddress) {
+    final pending = _pending[macAddress] ?? const {};
+    int requestId = _requestIds[macAddress] ?? 0;
+    while (pending.containsKey(requestId)) {
+      requestId = (requestId + 1) & 0xFF;
+    }
+    _requestIds[macAddress] = (requestId + 1) & 0xFF;
+    return requestId;
+  }
+
+  static Future<void> _takeCredit(String macAddress) async {
+    while ((_inFlight[macAddress] ?? 0) >= (_credits[macAddress] ?? 1)) {
+      final waiter = Completer<void>();
+      _creditWaiters.putIfAbsent(macAddress, () => []).add(waiter);
+      await waiter.future;
+    }
+    _inFlight[macAddress] = (_inFlight[macAddress] ?? 0) + 1;
+  }
+
+  static void _returnCredit(String macAddress) {
+    _inFlight[macAddress] = max((_inFlight[macAddress] ?? 1) - 1, 0);
+    _wakeCreditWaiters(macAddress);
+  }
+
+  /// Lets every waiting [request] check for a free credit again
+  static void _wakeCreditWaiters(String macAddress) {
+    for (final waiter in _creditWaiters.remove(macAddress) ?? []) {
+      waiter.complete();
+    }
+  }
+
   /// Send command with a float value
   static Future<BluetoothCharacteristic?> sendCommandWithFloat(
       BluetoothDevice device, ClientCommand command, double value) {
@@ -285,6 +423,69 @@ class BleService {
         additionalData: Uint8List.fromList(stringBytes));
   }
 
+  /// Send RSSI samples the phone measured (at most 13, oldest first) with
+  /// [ClientCommand.PHONE_RSSI]
+  static Future<BluetoothCharacteristic?> sendPhoneRssi(BluetoothDevice device,
+      List<({int rssi, DateTime time})> samples) {
+    final now = DateTime.now();
+    final data = Uint8List(min(samples.length, 13) * 2);
+    for (int i = 0; i < data.length ~/ 2; i++) {
+      final age = now.difference(samples[i].time).inMilliseconds ~/ 20;
+      data[i * 2] = samples[i].rssi & 0xFF;
+      data[i * 2 + 1] = age.clamp(0, 255);
+    }
+    return sendCommand(device, ClientCommand.PHONE_RSSI, additionalData: data);
+  }
+
+  /// Send several settings in one [ClientCommand.SETTINGS] frame (at most 27
+  /// bytes), answered with [Esp32Response.SETTINGS]
+  static Future<BluetoothCharacteristic?> sendSettings(
+      BluetoothDevice device,
+      {double? triggerRssi,
+      double? deadZone,
+      double? cooldown,
+      bool? proximityKey}) {
+    return sendCommand(device, ClientCommand.SETTINGS,
+        additionalData: settingsData(
+            triggerRssi: triggerRssi,
+            deadZone: deadZone,
+            cooldown: cooldown,
+            proximityKey: proximityKey));
+  }
+
+  /// TLV additional data of [ClientCommand.SETTINGS]
+  static Uint8List settingsData(
+      {double? triggerRssi,
+      double? deadZone,
+      double? cooldown,
+      bool? proximityKey}) {
+    final writer = TlvWriter();
+    if (triggerRssi != null) {
+      writer.putFloat(SettingTag.triggerRssi, triggerRssi);
+    }
+    if (deadZone != null) {
+      writer.putUint8(SettingTag.deadZone, deadZone.round());
+    }
+    if (cooldown != null) writer.putFloat(SettingTag.cooldown, cooldown);
+    if (proximityKey != null) {
+      writer.putUint8(SettingTag.proximityKey, proximityKey ? 1 : 0);
+    }
+    return writer.toBytes();
+  }
+
+  /// Run several commands in order with one [ClientCommand.BATCH] (at most 27
+  /// bytes of TLV), all of them or none. Their answers arrive as usual,
+  /// followed by [Esp32Response.BATCH_RESULT]
+  static Future<BluetoothCharacteristic?> sendBatch(BluetoothDevice device,
+      List<({ClientCommand command, Uint8List? data})> commands) {
+    final writer = TlvWriter();
+    for (final entry in commands) {
+      writer.putRaw(entry.command.value, entry.data ?? Uint8List(0));
+    }
+    return sendCommand(device, ClientCommand.BATCH,
+        additionalData: writer.toBytes());
+  }
+
   /// Send command with multiple values packed together
   /// Example: two floats (lat, lng) = 8 bytes total
   static Future<BluetoothCharacteristic?> sendCommandWithFloats(
@@ -1,59 +1,168 @@
+// Generated by Firmware/LockController/tools/dart_commands from
+// Firmware/LockController/src/bluetooth/schema.h, don't edit by hand.
 // ignore_for_file: constant_identifier_names
 
 /// Commands sent by the client/app to the ESP32
 enum ClientCommand {
   /// Gets the protocol version of the ESP32
-  GET_VERSION(0x00),
+  GET_VERSION(0x00, Esp32Response.VERSION),
 
-  /// Triggers a doors locked or unlocked event depending on the state
-  GET_DATA(0x01),
+  /// Triggers a doors locked or unlocked event depending on the state (and
+  /// engine and windows events if the vehicle supports them)
+  GET_DATA(0x01, Esp32Response.LOCKED),
 
   /// Locks the doors
-  LOCK_DOORS(0x02),
+  LOCK_DOORS(0x02, Esp32Response.LOCKED),
 
   /// Unlocks the doors
-  UNLOCK_DOORS(0x03),
+  UNLOCK_DOORS(0x03, Esp32Response.UNLOCKED),
 
   /// Opens the trunk
-  OPEN_TRUNK(0x04),
+  OPEN_TRUNK(0x04, null),
 
   /// Starts the engine
-  START_ENGINE(0x05),
+  START_ENGINE(0x05, Esp32Response.ENGINE_STARTED),
 
   /// Stops the engine
-  STOP_ENGINE(0x06),
+  STOP_ENGINE(0x06, Esp32Response.ENGINE_STOPPED),
 
   /// Enables proximity key
-  PROXIMITY_KEY_ON(0x07),
+  PROXIMITY_KEY_ON(0x07, null),
 
   /// Disables proximity key
-  PROXIMITY_KEY_OFF(0x08),
+  PROXIMITY_KEY_OFF(0x08, null),
 
   /// Sets the proximity cooldown
   ///
-  /// Needs additional data: `float` proximity cooldown in minutes
-  PROXIMITY_COOLDOWN(0x09),
+  /// Additional data: `float` proximity cooldown in minutes
+  PROXIMITY_COOLDOWN(0x09, null),
 
   /// Sets the RSSI trigger values
   ///
-  /// Needs additional data: `float` RSSI trigger, `float` RSSI dead zone
-  RSSI_TRIGGER(0x0A),
+  /// Additional data: `float` RSSI trigger, `float` RSSI dead zone
+  RSSI_TRIGGER(0x0A, null),
 
   /// Gets the current RSSI
-  GET_RSSI(0x0B),
+  GET_RSSI(0x0B, Esp32Response.RSSI),
 
   /// Gets the features supported by the vehicle
-  GET_FEATURES(0x0C),
+  GET_FEATURES(0x0C, Esp32Response.FEATURES),
 
   /// Opens (rolls down) the windows
-  OPEN_WINDOWS(0x0D),
+  OPEN_WINDOWS(0x0D, Esp32Response.WINDOWS_OPENED),
 
   /// Closes (rolls up) the windows
-  CLOSE_WINDOWS(0x0E);
+  CLOSE_WINDOWS(0x0E, Esp32Response.WINDOWS_CLOSED),
 
-  const ClientCommand(this.value);
+  /// Gets the command latency statistics of the controller
+  ///
+  /// Answered with several [Esp32Response.STATS] messages
+  GET_STATS(0x0F, Esp32Response.STATS),
+
+  /// Gets the heap and stack samples of the controller
+  ///
+  /// Answered with one [Esp32Response.MEMORY] message per sample
+  GET_MEMORY(0x10, Esp32Response.MEMORY),
+
+  /// Selects and tunes the RSSI filter of the proximity key
+  ///
+  /// Additional data: filter type byte (0 moving average, 1 exponential, 2
+  /// median, 3 Kalman), 2 parameter floats. Without data the active filter is
+  /// only reported. Answered with [Esp32Response.RSSI_FILTER]
+  RSSI_FILTER(0x11, Esp32Response.RSSI_FILTER),
+
+  /// Collects RSSI readings for the given time while the phone is held where
+  /// the vehicle should unlock and derives trigger and release RSSI from them
+  ///
+  /// Additional data: `float` duration in s (max. 120, 0 clears the
+  /// calibration). Answered with [Esp32Response.CALIBRATION] when done
+  CALIBRATE(0x12, Esp32Response.CALIBRATION),
+
+  /// Requests the recorded RSSI trace (raw readings, connection events and
+  /// proximity decisions). Answered with several [Esp32Response.TRACE]
+  GET_TRACE(0x13, Esp32Response.TRACE),
+
+  /// Hands the controller the RSSI the phone measured of it, which it fuses
+  /// with its own readings for the proximity key
+  ///
+  /// Additional data: up to 13 pairs of `int8` RSSI and `uint8` age (in 20ms
+  /// units before sending), oldest first. Not answered
+  PHONE_RSSI(0x14, null),
+
+  /// Subscribes to the RSSI instead of sending [ClientCommand.GET_RSSI] for
+  /// every reading, ends on disconnect
+  ///
+  /// Additional data: `uint16` interval in ms (0 ends the subscription),
+  /// optionally `uint16` duration in s (max. and default 300). Answered with
+  /// [Esp32Response.RSSI_SAMPLES]
+  RSSI_STREAM(0x15, Esp32Response.RSSI_SAMPLES),
+
+  /// Changes several settings at once (proximity key, trigger RSSI, dead zone,
+  /// cooldown, RSSI filter)
+  ///
+  /// Additional data: TLV settings (see Docs/LockController.md), fields with
+  /// unknown tags are skipped, covered by the HMAC. Without data the settings
+  /// are only reported. Answered with [Esp32Response.SETTINGS]
+  SETTINGS(0x16, Esp32Response.SETTINGS),
+
+  /// Runs several commands in order under one rolling code, either all of them
+  /// or none (if one of them is unknown, unsupported or has invalid data)
+  ///
+  /// Additional data: TLV (see Docs/LockController.md) with the command as tag
+  /// and its additional data as value. The HMAC also covers the additional
+  /// data. Answered with [Esp32Response.BATCH_RESULT] after the answers of the
+  /// commands
+  BATCH(0x17, Esp32Response.BATCH_RESULT),
+
+  /// Gets how many commands may wait for their answer at once (credits) and the
+  /// longest additional data in both directions
+  ///
+  /// Answered with [Esp32Response.LIMITS]
+  GET_LIMITS(0x18, Esp32Response.LIMITS),
+
+  /// Gets what changed since a state version the client saw (after a reconnect)
+  ///
+  /// Additional data: `uint32` version of the last [Esp32Response.STATE] or
+  /// [Esp32Response.STATE_DELTA]. Answered with [Esp32Response.STATE_DELTA],
+  /// every bit counts as changed if the version is unknown
+  STATE_SINCE(0x19, Esp32Response.STATE_DELTA),
+
+  /// Unlocks the doors and locks them again after the given time, unless a door
+  /// was opened or the lock changed otherwise meanwhile
+  ///
+  /// Additional data: `uint16` seconds (0 only cancels a pending relock),
+  /// covered by the HMAC. Answered with [Esp32Response.UNLOCKED], or
+  /// [Esp32Response.COMMAND_REJECTED] without unlocking if no timer is free
+  UNLOCK_FOR(0x1A, Esp32Response.UNLOCKED),
+
+  /// Starts the engine and stops it after the given time at the latest, unless
+  /// it was stopped otherwise meanwhile
+  ///
+  /// Additional data: `uint16` seconds, at most the controller's maximum
+  /// runtime, covered by the HMAC. Answered with
+  /// [Esp32Response.ENGINE_STARTED], or [Esp32Response.COMMAND_REJECTED]
+  /// without starting if no timer is free
+  START_ENGINE_FOR(0x1B, Esp32Response.ENGINE_STARTED),
+
+  /// Runs a command later without the app (up to 6 timers; after a reboot the
+  /// ones that unlock, start the engine or open the windows are dropped, the
+  /// others run right away)
+  ///
+  /// Additional data: `uint8` command (LOCK_DOORS, UNLOCK_DOORS, START_ENGINE,
+  /// STOP_ENGINE, OPEN_WINDOWS or CLOSE_WINDOWS), `uint32` seconds from now
+  /// (max. 7 days, 0 cancels the scheduled ones of the command), covered by the
+  /// HMAC. Without data the timers are only reported. Answered with
+  /// [Esp32Response.SCHEDULE], or [Esp32Response.COMMAND_REJECTED] changing
+  /// nothing if the command isn't supported, the delay too long or no timer
+  /// free
+  SCHEDULE(0x1C, Esp32Response.SCHEDULE);
+
+  const ClientCommand(this.value, this.response);
   final int value;
 
+  /// What the ESP32 answers with, null if nothing
+  final Esp32Response? response;
+
   /// Convert from integer value to enum
   static ClientCommand? fromValue(int value) {
     for (ClientCommand command in ClientCommand.values) {
@@ -105,7 +214,98 @@ enum Esp32Response {
   WINDOWS_OPENED(0x0A),
 
   /// Windows were closed
-  WINDOWS_CLOSED(0x0B);
+  WINDOWS_CLOSED(0x0B),
+
+  /// One record of the controller statistics
+  ///
+  /// Additional data: summary or histogram record (see Docs/LockController.md)
+  STATS(0x0C),
+
+  /// One heap and stack sample of the controller
+  ///
+  /// Additional data: memory sample (see Docs/LockController.md)
+  MEMORY(0x0D),
+
+  /// Free heap or the largest free block of the controller is low
+  ///
+  /// Additional data: memory sample that triggered it
+  MEMORY_ALERT(0x0E),
+
+  /// Active RSSI filter (unchanged if the requested one was invalid)
+  ///
+  /// Additional data: filter type byte, 2 parameter floats
+  RSSI_FILTER(0x0F),
+
+  /// Result of [ClientCommand.CALIBRATE]
+  ///
+  /// Additional data: `float` trigger RSSI, `float` release RSSI, `float` 5%,
+  /// 25% and 50% quantile, `uint16` readings. None if it failed or was cleared
+  CALIBRATION(0x10),
+
+  /// One record of the RSSI trace, ~20ms apart
+  ///
+  /// Additional data: header (`0x00`, `uint32` base ms, `int8` base RSSI,
+  /// `uint16` entries, `uint32` ms now) first, then `0x01` + up to 14 entries
+  TRACE(0x11),
+
+  /// A batch of the [ClientCommand.RSSI_STREAM] subscription, about once a
+  /// second
+  ///
+  /// Additional data: `uint32` ms of the first sample, `uint16` ms between
+  /// samples, `int8` RSSI per sample. None once the subscription ended
+  RSSI_SAMPLES(0x12),
+
+  /// Settings of the controller after [ClientCommand.SETTINGS]
+  ///
+  /// Additional data: TLV settings, including the release RSSI
+  SETTINGS(0x13),
+
+  /// Result of [ClientCommand.BATCH]
+  ///
+  /// Additional data: status byte (0 all ran, 1 malformed, 2 unknown or
+  /// unsupported command, 3 invalid data, 4 nested batch), `uint8` index of the
+  /// command it failed at (number of commands if all ran)
+  BATCH_RESULT(0x14),
+
+  /// A command with a request ID that isn't answered otherwise was handled
+  ///
+  /// Additional data: status byte (0 ran, 1 unknown or unsupported, 2 invalid
+  /// data)
+  COMMAND_DONE(0x15),
+
+  /// Result of [ClientCommand.GET_LIMITS]
+  ///
+  /// Additional data: `uint8` credits, `uint8` longest additional data of a
+  /// command, `uint8` longest additional data of an answer (both one less with
+  /// a request ID)
+  LIMITS(0x16),
+
+  /// Vehicle state, the value of the state characteristic (read after an
+  /// authenticated command)
+  ///
+  /// Additional data: `uint8` state bits (1 locked, 2 engine on, 4 windows
+  /// open, 8 relock pending, 16 engine shutoff pending, 32 commands scheduled),
+  /// `uint8` bits the vehicle has, `uint32` state version
+  STATE(0x17),
+
+  /// State bits that changed, notified on the state characteristic on every
+  /// change and the answer to [ClientCommand.STATE_SINCE]
+  ///
+  /// Additional data: `uint8` changed bits, `uint8` state bits, `uint32` state
+  /// version
+  STATE_DELTA(0x18),
+
+  /// Timers of the controller after [ClientCommand.SCHEDULE]
+  ///
+  /// Additional data: per timer `uint8` command, `uint8` kind (0 scheduled, 1
+  /// relock of UNLOCK_FOR, 2 shutoff of START_ENGINE_FOR), `uint32` seconds
+  /// left
+  SCHEDULE(0x19),
+
+  /// A timed command or schedule was refused without changing anything
+  ///
+  /// Additional data: `uint8` command
+  COMMAND_REJECTED(0x1A);
 
   const Esp32Response(this.value);
   final int value;
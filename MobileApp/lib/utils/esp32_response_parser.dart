@@ -15,6 +15,14 @@ class Esp32ResponseParser {
   /// Get the data length (second byte if it exists)
   int get dataLength => value.length > 1 ? value[1] : 0;
 
+  /// Request ID of the command this answers (the byte after the data), null
+  /// if the command had none or this wasn't sent by the command's handler
+  int? get requestId {
+    if (value.length < 2) return null;
+    final int idPosition = 2 + value[1];
+    return value.length > idPosition ? value[idPosition] : null;
+  }
+
   // Get raw data bytes (everything after command and length bytes)
   List<int>? get rawData {
     if (value.length < 2) return null;
@@ -0,0 +1,96 @@
+import 'dart:typed_data';
+
+/// Port of Firmware/LockController/src/bluetooth/tlv.h: a version byte, then
+/// per field a tag byte, a length byte and the value (little-endian). Fields
+/// with unknown tags are skipped, so new settings don't need a new protocol
+/// version.
+const int tlvVersion = 1;
+
+/// Tags of [ClientCommand.SETTINGS] and [Esp32Response.SETTINGS]
+enum SettingTag {
+  /// `float` dBm
+  triggerRssi(0x01),
+
+  /// `uint8` rough meters between trigger and release point
+  deadZone(0x02),
+
+  /// `float` minutes
+  cooldown(0x03),
+
+  /// `uint8` 0 off, 1 on
+  proximityKey(0x04),
+
+  /// Filter type byte, 2 floats (like [ClientCommand.RSSI_FILTER])
+  rssiFilter(0x05),
+
+  /// `float` dBm, only reported
+  releaseRssi(0x06);
+
+  const SettingTag(this.value);
+  final int value;
+
+  static SettingTag? fromValue(int value) {
+    for (SettingTag tag in SettingTag.values) {
+      if (tag.value == value) {
+        return tag;
+      }
+    }
+    return null;
+  }
+}
+
+class TlvWriter {
+  final BytesBuilder _bytes = BytesBuilder()..addByte(tlvVersion);
+
+  void putBytes(SettingTag tag, List<int> value) => putRaw(tag.value, value);
+
+  /// A field with any tag (e.g. a command in [ClientCommand.BATCH])
+  void putRaw(int tag, List<int> value) {
+    _bytes
+      ..addByte(tag)
+      ..addByte(value.length)
+      ..add(value);
+  }
+
+  void putUint8(SettingTag tag, int value) => putBytes(tag, [value & 0xFF]);
+
+  void putFloat(SettingTag tag, double value) {
+    final data = ByteData(4)..setFloat32(0, value, Endian.little);
+    putBytes(tag, data.buffer.asUint8List());
+  }
+
+  Uint8List toBytes() => _bytes.toBytes();
+}
+
+class TlvField {
+  final int tag;
+  final Uint8List value;
+
+  TlvField(this.tag, this.value);
+
+  /// The known tag, null for fields of a newer firmware
+  SettingTag? get setting => SettingTag.fromValue(tag);
+
+  int? get uint8 => value.length == 1 ? value[0] : null;
+
+  double? get float => value.length == 4
+      ? ByteData.sublistView(value).getFloat32(0, Endian.little)
+      : null;
+}
+
+/// Fields of a TLV payload, empty if its version is unknown; a field that was
+/// cut off ends it
+List<TlvField> readTlv(List<int> data) {
+  final fields = <TlvField>[];
+  if (data.isEmpty || data[0] != tlvVersion) return fields;
+
+  int position = 1;
+  while (position + 2 <= data.length) {
+    final length = data[position + 1];
+    if (position + 2 + length > data.length) break;
+    fields.add(TlvField(data[position],
+        Uint8List.fromList(data.sublist(position + 2, position + 2 + length))));
+    position += 2 + length;
+  }
+  return fields;
+}